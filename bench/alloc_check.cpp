@@ -0,0 +1,273 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <gerr/gerr.hpp>
+#include <gerr/validate.hpp>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include "alloc_count.hpp"
+
+// 固定每个 New / Wrap / E 重载和每个查询函数的分配次数，任何一项和预期不符时
+// 打印出错位置并以非 0 值退出：
+//   cmake --build . --target gerr_alloc_check && bench/gerr_alloc_check
+// 格式化的错误信息都超过了 std::string 的短字符串长度，因此带格式化的创建
+// 是两次分配：错误节点本身和错误信息。
+
+namespace {
+
+struct CallContext {
+  int uin;
+  char const* client;
+};
+
+constexpr int kCode = 1001;
+constexpr int kBottomCode = 2001;
+constexpr int kUin = 123456789;
+constexpr int kShard = 7;
+constexpr char const* kName = "some-client";
+
+// DEFINE_* 生成的是普通的类，可以先前置声明再定义
+class ErrPlain;
+DEFINE_ERROR(ErrPlain, "plain error");
+DEFINE_CODE_ERROR(ErrTimeout, kCode, "call timeout");
+DEFINE_CONTEXT_ERROR(ErrContext, CallContext, "fail to call: uin={}, client={}",
+                     context.uin, context.client);
+DEFINE_CODE_CONTEXT_ERROR(ErrCallFailed, kCode, CallContext,
+                          "fail to call: uin={}, client={}", context.uin,
+                          context.client);
+DEFINE_CODE_MEMO_CONTEXT_ERROR(ErrShardDown, kCode, int, "shard {} is down",
+                               context);
+DEFINE_CODE_ERROR(ErrBottom, kBottomCode, "bottom error");
+DEFINE_ERROR(ErrNeverRaised, "never raised");
+
+// 错误码也可以是运行时才确定的值，例如从配置中读取
+int gConfiguredCode = 0;
+DEFINE_CODE_ERROR(ErrConfigured, gConfiguredCode, "configured error");
+DEFINE_CODE_CONTEXT_ERROR(ErrConfiguredCall, gConfiguredCode, int,
+                          "shard {} failed", context);
+
+/** 写入固定缓冲区的 streambuf，用于在不分配内存的流上检查 operator<< */
+class FixedBuf : public std::streambuf {
+ public:
+  FixedBuf() { Reset(); }
+  void Reset() { setp(buffer_, buffer_ + sizeof(buffer_)); }
+
+ private:
+  char buffer_[16384];
+};
+
+gerr::Error MakeChain(int depth) {
+  auto err = ErrBottom::E(nullptr);
+  for (int i = 1; i < depth; ++i) {
+    err = gerr::Wrap(err, "layer {}", i);
+  }
+  return err;
+}
+
+void CheckNew() {
+  static std::string const formatStr = "fail: uin={}, client={}";
+
+  // 不带格式化参数的 New 第一次调用时创建常驻节点，之后的调用直接返回它。
+  // 第一次的分配次数取决于编译器是否省略了泄漏引用的那次分配，因此不做检查
+  (void)gerr::New("first new");
+  GERR_EXPECT_ALLOCS(0, gerr::New("first new"));
+  (void)gerr::New(kCode, "first new with code");
+  GERR_EXPECT_ALLOCS(0, gerr::New(kCode, "first new with code"));
+
+  // 只有字符串常量进入常驻节点表：字符指针每次新建一个只保存指针的节点，
+  // 可写的缓冲区复制一份错误信息（短于短字符串长度，只有节点一次分配）
+  char const* const message = "pointer new";
+  char buffer[] = "buffer new";
+  GERR_EXPECT_ALLOCS(1, gerr::New(message));
+  GERR_EXPECT_ALLOCS(1, gerr::New(message));
+  GERR_EXPECT_ALLOCS(1, gerr::New(kCode, message));
+  GERR_EXPECT_ALLOCS(1, gerr::New(buffer));
+  GERR_EXPECT_ALLOCS(1, gerr::New(kCode, buffer));
+
+  GERR_EXPECT_ALLOCS(2, gerr::New("fail: uin={}, client={}", kUin, kName));
+  GERR_EXPECT_ALLOCS(2, gerr::New(formatStr, kUin, kName));
+  GERR_EXPECT_ALLOCS(
+      2, gerr::New(FMT_STRING("fail: uin={}, client={}"), kUin, kName));
+  GERR_EXPECT_ALLOCS(
+      2, gerr::New(GERR_FMT("fail: uin={}, client={}"), kUin, kName));
+  GERR_EXPECT_ALLOCS(
+      2, gerr::New(kCode, "fail: uin={}, client={}", kUin, kName));
+  GERR_EXPECT_ALLOCS(2, gerr::New(kCode, formatStr, kUin, kName));
+  GERR_EXPECT_ALLOCS(
+      2, gerr::New(kCode, FMT_STRING("fail: uin={}, client={}"), kUin, kName));
+}
+
+void CheckWrap() {
+  static std::string const formatStr = "fail: uin={}, client={}";
+  auto const cause = ErrBottom::E(nullptr);
+
+  GERR_EXPECT_ALLOCS(1, gerr::Wrap(cause, "fail"));
+  GERR_EXPECT_ALLOCS(
+      2, gerr::Wrap(cause, "fail: uin={}, client={}", kUin, kName));
+  GERR_EXPECT_ALLOCS(2, gerr::Wrap(cause, formatStr, kUin, kName));
+  GERR_EXPECT_ALLOCS(
+      2, gerr::Wrap(cause, FMT_STRING("fail: uin={}, client={}"), kUin, kName));
+  GERR_EXPECT_ALLOCS(1, gerr::Wrap(cause, kCode));
+  GERR_EXPECT_ALLOCS(1, gerr::Wrap(cause, kCode, "fail"));
+  GERR_EXPECT_ALLOCS(
+      2, gerr::Wrap(cause, kCode, "fail: uin={}, client={}", kUin, kName));
+  GERR_EXPECT_ALLOCS(2, gerr::Wrap(cause, kCode, formatStr, kUin, kName));
+  GERR_EXPECT_ALLOCS(2, gerr::Wrap(cause, kCode,
+                                   FMT_STRING("fail: uin={}, client={}"), kUin,
+                                   kName));
+}
+
+void CheckDefine() {
+  auto const cause = ErrBottom::E(nullptr);
+
+  // 静态的 E() 第一次调用时创建常驻节点，之后不再分配
+  (void)ErrPlain::E();
+  GERR_EXPECT_ALLOCS(0, ErrPlain::E());
+  (void)ErrTimeout::E();
+  GERR_EXPECT_ALLOCS(0, ErrTimeout::E());
+
+  GERR_EXPECT_ALLOCS(1, ErrPlain::E(cause));
+  GERR_EXPECT_ALLOCS(1, ErrTimeout::E(cause));
+  GERR_EXPECT_ALLOCS(2, ErrContext::E({kUin, kName}));
+  GERR_EXPECT_ALLOCS(2, ErrContext::E(cause, {kUin, kName}));
+  GERR_EXPECT_ALLOCS(2, ErrCallFailed::E({kUin, kName}));
+  GERR_EXPECT_ALLOCS(2, ErrCallFailed::E(cause, {kUin, kName}));
+
+  // 带缓存的 E(context) 对同一个环境信息只在第一次调用时创建节点
+  (void)ErrShardDown::E(kShard);
+  GERR_EXPECT_ALLOCS(0, ErrShardDown::E(kShard));
+  // 这里的错误信息在短字符串长度以内，只有节点本身一次分配
+  GERR_EXPECT_ALLOCS(1, ErrShardDown::E(cause, kShard));
+
+  gConfiguredCode = kBottomCode + kShard;
+  (void)ErrConfigured::E();
+  GERR_EXPECT_ALLOCS(0, ErrConfigured::E());
+  GERR_EXPECT_ALLOCS(0, gerr::Code(ErrConfigured::E()));
+  if (gerr::Code(ErrConfigured::E()) != gConfiguredCode ||
+      gerr::Code(ErrConfiguredCall::E(kShard)) != gConfiguredCode) {
+    std::fprintf(stderr, "runtime error code not applied\n");
+    std::abort();
+  }
+  GERR_EXPECT_ALLOCS(1, ErrConfiguredCall::E(kShard));
+}
+
+// 带缓存的错误类型的节点被共享，环境信息只能读取
+static_assert(
+    std::is_const<std::remove_reference<decltype(
+        std::declval<ErrShardDown&>().Context())>::type>::value,
+    "memo context errors must not expose a mutable Context()");
+
+void CheckInterop() {
+  // errno 的常驻节点在程序启动时创建，第一次使用也不会分配；
+  // 常驻节点有真正的所有者，AsError 不会抛出 std::bad_weak_ptr
+  GERR_EXPECT_ALLOCS(0, gerr::FromErrno(ENOENT));
+  GERR_EXPECT_ALLOCS(0, gerr::FromErrno(ENOENT)->AsError());
+  GERR_EXPECT_ALLOCS(0, gerr::FromErrorCode(
+                            std::make_error_code(std::errc::timed_out)));
+  GERR_EXPECT_ALLOCS(
+      1, gerr::FromErrorCode(std::make_error_code(std::io_errc::stream)));
+  GERR_EXPECT_ALLOCS(0, gerr::ToErrorCode(gerr::FromErrno(ENOENT)));
+
+  GERR_EXPECT_ALLOCS(0, gerr::LocalError(kCode, "fail"));
+  GERR_EXPECT_ALLOCS(0,
+                     gerr::LocalError(kCode, "fail: uin={}, client={}", kUin,
+                                      kName));
+  GERR_EXPECT_ALLOCS(
+      2, gerr::LocalError(kCode, "fail: uin={}, client={}", kUin, kName)
+             .Escape());
+}
+
+/** 校验 n 个字段，前 failed 个失败 */
+gerr::Error Validate(int n, int failed) {
+  gerr::Validator v;
+  for (int i = 0; i < n; ++i) {
+    v.Check(i >= failed, "field", kCode, "must be positive, got {}", -i);
+  }
+  return v.Finish("invalid request");
+}
+
+void CheckValidate() {
+  // 没有字段出错时不分配；出错时分配 arena、索引、路径表各一次，
+  // 加上错误节点本身，和出错的字段数无关（arena 和索引的扩容除外）
+  GERR_EXPECT_ALLOCS(0, Validate(16, 0));
+  GERR_EXPECT_ALLOCS(4, Validate(16, 1));
+  // 查找字段错误不分配
+  auto const err = Validate(16, 3);
+  GERR_EXPECT_ALLOCS(0, gerr::IsFieldCode(kCode, err));
+  GERR_EXPECT_ALLOCS(0, gerr::AsField<ErrPlain>(err));
+}
+
+void CheckQueries(int depth) {
+  auto const err = MakeChain(depth);
+  gerr::ErrorView const view = err;
+
+  GERR_EXPECT_ALLOCS(0, gerr::Is<ErrBottom>(err));
+  GERR_EXPECT_ALLOCS(0, gerr::Is<ErrNeverRaised>(err));
+  GERR_EXPECT_ALLOCS(0, gerr::As<ErrBottom>(err));
+  GERR_EXPECT_ALLOCS(0, gerr::AsCode(kBottomCode, err));
+  GERR_EXPECT_ALLOCS(0, gerr::IsCode(kBottomCode, err));
+  GERR_EXPECT_ALLOCS(0, gerr::IsCode(kCode, err));
+  GERR_EXPECT_ALLOCS(0, gerr::Code(err));
+
+  GERR_EXPECT_ALLOCS(0, gerr::Is<ErrBottom>(view));
+  GERR_EXPECT_ALLOCS(0, gerr::As<ErrBottom>(view));
+  GERR_EXPECT_ALLOCS(0, gerr::IsCode(kBottomCode, view));
+  GERR_EXPECT_ALLOCS(0, gerr::Code(view));
+
+  GERR_EXPECT_ALLOCS(0, gerr::Error{err});
+
+  FixedBuf buf;
+  std::ostream os{&buf};
+  GERR_EXPECT_ALLOCS(0, os << *err);
+}
+
+}  // namespace
+
+int main() {
+  CheckNew();
+  CheckWrap();
+  CheckDefine();
+  CheckInterop();
+  CheckValidate();
+  for (auto depth : {1, 4, 16, 64}) {
+    CheckQueries(depth);
+  }
+  // gerr::String 返回新的字符串，分配次数取决于标准库，只检查短链条的情况：
+  // ostringstream 的缓冲区和返回的字符串各一次
+  auto const err = MakeChain(1);
+  GERR_EXPECT_ALLOCS(2, gerr::String(err));
+
+  if (AllocFailures() != 0) {
+    std::fprintf(stderr, "%d allocation check(s) failed\n", AllocFailures());
+    return 1;
+  }
+  std::printf("all allocation checks passed\n");
+  return 0;
+}
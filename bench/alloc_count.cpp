@@ -0,0 +1,73 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include "alloc_count.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace {
+
+thread_local std::size_t gAllocs = 0;
+thread_local std::size_t gAllocBytes = 0;
+thread_local std::size_t gUsableBytes = 0;
+std::atomic<int> gFailures{0};
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  ++gAllocs;
+  gAllocBytes += size;
+  if (auto p = std::malloc(size == 0 ? 1 : size)) {
+#if defined(__GLIBC__)
+    gUsableBytes += malloc_usable_size(p);
+#else
+    gUsableBytes += size;
+#endif
+    return p;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+std::size_t AllocCount() { return gAllocs; }
+
+std::size_t AllocBytes() { return gAllocBytes; }
+
+std::size_t AllocUsableBytes() { return gUsableBytes; }
+
+int AllocFailures() { return gFailures.load(); }
+
+void ReportAllocMismatch(char const* file, int line, char const* expr,
+                         std::size_t expected, std::size_t actual) {
+  ++gFailures;
+  std::fprintf(stderr, "%s:%d: %s: expected %zu allocs, got %zu\n", file,
+               line, expr, expected, actual);
+}
@@ -0,0 +1,70 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#pragma once
+
+#include <cstddef>
+
+// 分配计数工具，供 bench 下的目标共用：alloc_count.cpp 替换了全局 operator new，
+// 每个线程各自累计分配次数和字节数。一个可执行文件只能链接一份 alloc_count.cpp，
+// 因此它不能和同样替换了 operator new 的 fail_alloc.cpp 一起使用。
+
+/** 当前线程累计的 operator new 调用次数 */
+std::size_t AllocCount();
+
+/** 当前线程累计向 operator new 申请的字节数 */
+std::size_t AllocBytes();
+
+/**
+ * 当前线程累计从 malloc 实际得到的可用字节数（malloc_usable_size），
+ * 和 AllocBytes 的差值即分配器的取整开销；不支持的平台上等于 AllocBytes。
+ */
+std::size_t AllocUsableBytes();
+
+/** 目前为止 GERR_EXPECT_ALLOCS 失败的次数，可以作为 main 的返回值 */
+int AllocFailures();
+
+/** 记录一次 GERR_EXPECT_ALLOCS 失败，并把表达式和实际分配次数打印到 stderr */
+void ReportAllocMismatch(char const* file, int line, char const* expr,
+                         std::size_t expected, std::size_t actual);
+
+template <class Fn>
+bool CheckAllocs(char const* file, int line, char const* expr,
+                 std::size_t expected, Fn fn) {
+  auto const before = AllocCount();
+  fn();
+  auto const actual = AllocCount() - before;
+  if (actual != expected) {
+    ReportAllocMismatch(file, line, expr, expected, actual);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * 断言执行 expr（包括析构它产生的临时对象）恰好调用了 n 次 operator new。
+ * Example:
+ *   GERR_EXPECT_ALLOCS(0, gerr::IsCode(kCode, err));
+ *   GERR_EXPECT_ALLOCS(1, gerr::Wrap(err, "fail"));
+ */
+#define GERR_EXPECT_ALLOCS(n, expr) \
+  CheckAllocs(__FILE__, __LINE__, #expr, (n), [&] { (void)(expr); })
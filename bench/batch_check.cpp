@@ -0,0 +1,195 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cstddef>
+#include <cstdio>
+#include <gerr/batch.hpp>
+#include <gerr/gerr.hpp>
+#include <gerr/result.hpp>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// gerr::ErrorBatch 的行为检查：在成功和失败混合的一批数据上，逐行查询、
+// 错误码直方图、按行号遍历和 ToError / ToResult 的结果都要和逐行保存
+// gerr::Error 的朴素实现一致，结果不符时以非 0 值退出
+
+namespace {
+
+constexpr int kBadRow = 1001;
+constexpr int kTooLong = 1002;
+constexpr int kMissing = 1003;
+
+int failures = 0;
+
+void Check(bool ok, char const* what) {
+  if (!ok) {
+    std::fprintf(stderr, "FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+/** 逐行保存错误的朴素实现，作为对照 */
+using Reference = std::vector<gerr::Error>;
+
+/** 对照 reference 检查 batch 的所有查询结果 */
+void Compare(gerr::ErrorBatch const& batch, Reference const& reference) {
+  Check(batch.Size() == reference.size(), "size");
+  std::size_t failed = 0;
+  std::map<int, std::size_t> histogram;
+  std::vector<std::size_t> rows;
+  for (std::size_t row = 0; row < reference.size(); ++row) {
+    auto const& want = reference[row];
+    auto const got = batch.Error(row);
+    Check(batch.Failed(row) == (want != nullptr), "Failed matches");
+    Check(batch.Code(row) == (want == nullptr ? 0 : gerr::Code(want)),
+          "Code matches");
+    Check((got == nullptr) == (want == nullptr) &&
+              gerr::Code(got) == gerr::Code(want),
+          "Error matches");
+    if (want != nullptr) {
+      ++failed;
+      ++histogram[gerr::Code(want)];
+      rows.push_back(row);
+    }
+  }
+  Check(batch.CountFailed() == failed, "CountFailed");
+  auto const got = batch.CodeHistogram();
+  Check(got == std::vector<std::pair<int, std::size_t>>(histogram.begin(),
+                                                         histogram.end()),
+        "CodeHistogram is sorted and counts every failed row");
+
+  std::vector<std::size_t> visited;
+  batch.ForEachFailure([&](std::size_t row, gerr::Error const& err) {
+    visited.push_back(row);
+    Check(err != nullptr && gerr::Code(err) == gerr::Code(reference[row]),
+          "ForEachFailure passes the row's error");
+  });
+  Check(visited == rows, "ForEachFailure visits failed rows in order");
+
+  auto const err = batch.ToError();
+  if (rows.empty()) {
+    Check(err == nullptr, "ToError is nullptr without failures");
+    return;
+  }
+  Check(gerr::Code(err) == gerr::Code(reference[rows.front()]),
+        "ToError carries the first failure's code");
+  Check(gerr::String(err).find(std::to_string(failed) + " of " +
+                               std::to_string(reference.size()) +
+                               " rows failed, first at row " +
+                               std::to_string(rows.front())) !=
+            std::string::npos,
+        "ToError message counts the failures");
+}
+
+void CheckMixed() {
+  std::size_t const rows = 1000;
+  gerr::ErrorBatch batch{rows};
+  Reference reference(rows);
+  Compare(batch, reference);
+
+  // 字边界上的行，以及乱序写入的完整错误
+  for (auto row : {999, 0, 63, 64, 127, 128, 500, 65}) {
+    auto const r = static_cast<std::size_t>(row);
+    if (row % 2 == 0) {
+      reference[r] = gerr::New(kBadRow, "bad row {}", row);
+      batch.Fail(r, reference[r]);
+    } else {
+      reference[r] = gerr::New(kTooLong, "row too long");
+      batch.FailCode(r, kTooLong);
+    }
+  }
+  batch.Fail(10, nullptr);
+  Compare(batch, reference);
+  Check(batch.Error(0) == reference[0], "Fail keeps the full error");
+
+  // 同一行再次失败时替换之前的错误
+  reference[500] = gerr::New(kMissing, "missing field");
+  batch.Fail(500, reference[500]);
+  Compare(batch, reference);
+  Check(batch.Error(500) == reference[500], "Fail replaces the error");
+
+  // 随机的失败模式
+  std::mt19937 rng{42};
+  for (std::size_t row = 0; row < rows; ++row) {
+    if (reference[row] == nullptr && rng() % 10 == 0) {
+      auto const code = rng() % 2 == 0 ? kMissing : kTooLong;
+      reference[row] = gerr::New(code, "random failure");
+      batch.FailCode(row, code);
+    }
+  }
+  Compare(batch, reference);
+
+  // 只带错误码的行共享本批数据的节点，不占用全局的常驻节点表
+  auto const tooLong = batch.Error(63);
+  Check(tooLong == batch.Error(65) && tooLong.use_count() > 1,
+        "FailCode rows share a batch-local node");
+
+  std::vector<int> values(rows, 1);
+  auto const result = batch.ToResult(std::move(values));
+  Check(!result && gerr::Code(result.Error()) == kBadRow,
+        "ToResult on a mixed batch fails with the first error");
+}
+
+void CheckReset() {
+  gerr::ErrorBatch batch{100};
+  batch.FailCode(5, kBadRow);
+  batch.Fail(70, gerr::New(kTooLong, "too long"));
+
+  // 复用为更小的一批，之前的失败全部清空
+  batch.Reset(70);
+  Reference reference(70);
+  Compare(batch, reference);
+  auto result = batch.ToResult(std::vector<int>{1, 2, 3});
+  Check(result && result.Value().size() == 3 && result.Value()[2] == 3,
+        "ToResult on an all-success batch returns the values");
+
+  // 复用为更大的一批
+  batch.Reset(200);
+  reference.assign(200, nullptr);
+  reference[199] = gerr::New(kMissing, "missing");
+  batch.FailCode(199, kMissing);
+  Compare(batch, reference);
+  result = batch.ToResult(std::vector<int>{1});
+  Check(!result && gerr::Code(result.Error()) == kMissing,
+        "ToResult after growing");
+
+  gerr::ErrorBatch empty;
+  Compare(empty, Reference{});
+  Check(empty.ToResult(std::vector<int>{}).IsSuccess(), "empty batch");
+}
+
+}  // namespace
+
+int main() {
+  CheckMixed();
+  CheckReset();
+
+  if (failures != 0) {
+    std::fprintf(stderr, "%d batch check(s) failed\n", failures);
+    return 1;
+  }
+  std::printf("all batch checks passed\n");
+  return 0;
+}
@@ -0,0 +1,201 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <chrono>
+#include <cstdio>
+#include <gerr/breaker.hpp>
+#include <gerr/exception.hpp>
+#include <gerr/gerr.hpp>
+#include <gerr/result.hpp>
+#include <stdexcept>
+#include <thread>
+
+// gerr::CircuitBreaker 的状态转换检查：关闭 -> 打开 -> 半开 -> 关闭，
+// 半开时探测失败重新打开、打开时不调用 fn、按键分组计数、忽略的错误不计入，
+// 以及 fn 抛出异常时按转换后的错误计为失败，结果不符时以非 0 值退出
+
+namespace {
+
+constexpr int kCodeA = 1001;
+constexpr int kCodeB = 1002;
+constexpr auto kOpenFor = std::chrono::milliseconds{50};
+
+DEFINE_CODE_ERROR(ErrNotFound, 4004, "not found");
+
+int failures = 0;
+
+void Check(bool ok, char const* what) {
+  if (!ok) {
+    std::fprintf(stderr, "FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+gerr::CircuitBreaker::Options SmallOptions() {
+  gerr::CircuitBreaker::Options options;
+  options.failureRatio = 0.5;
+  options.minCalls = 10;
+  options.window = std::chrono::seconds{60};
+  options.openFor = kOpenFor;
+  return options;
+}
+
+void Report(gerr::CircuitBreaker& breaker, int succeeded, int failed,
+            int code) {
+  for (auto i = 0; i < succeeded; ++i) {
+    breaker.Record(nullptr);
+  }
+  for (auto i = 0; i < failed; ++i) {
+    breaker.Record(gerr::New(code, "downstream failed"));
+  }
+}
+
+void WaitOpenFor() { std::this_thread::sleep_for(kOpenFor * 3 / 2); }
+
+bool IsOpen(gerr::CircuitBreaker const& breaker) {
+  return breaker.State() == gerr::CircuitState::kOpen;
+}
+
+void CheckTransitions() {
+  gerr::CircuitBreaker breaker{gerr::CircuitKey::kCode, SmallOptions()};
+  Check(breaker.State() == gerr::CircuitState::kClosed, "starts closed");
+  Check(breaker.Allow() == nullptr, "closed allows calls");
+
+  Report(breaker, 0, 9, kCodeA);
+  Check(!IsOpen(breaker), "stays closed below minCalls");
+  Report(breaker, 11, 0, kCodeA);
+  Check(!IsOpen(breaker), "stays closed below the ratio");
+  // 20 次调用中 kCodeA 失败 9 次，再失败 2 次后比例超过 0.5
+  Report(breaker, 0, 2, kCodeA);
+  Check(IsOpen(breaker), "opens at the ratio");
+  Check(gerr::Is<gerr::ErrCircuitOpen>(breaker.Allow()), "open rejects");
+
+  auto called = false;
+  auto err = breaker.Call([&] {
+    called = true;
+    return gerr::Error{};
+  });
+  Check(!called && gerr::Is<gerr::ErrCircuitOpen>(err),
+        "open Call does not run fn");
+  auto const value = breaker.Call([&]() -> gerr::Result<int> {
+    called = true;
+    return 1;
+  });
+  Check(!called && !value && gerr::Is<gerr::ErrCircuitOpen>(value.Error()),
+        "open Call returns a failed Result");
+
+  // 探测失败时重新打开
+  WaitOpenFor();
+  auto probe = false;
+  Check(breaker.Allow(&probe) == nullptr && probe, "first caller probes");
+  Check(breaker.State() == gerr::CircuitState::kHalfOpen, "half-open");
+  auto other = false;
+  Check(breaker.Allow(&other) != nullptr && !other,
+        "half-open rejects other callers");
+  breaker.Record(gerr::New(kCodeA, "still failing"), probe);
+  Check(IsOpen(breaker), "failed probe reopens");
+  Check(breaker.Allow() != nullptr, "reopened rejects");
+
+  // 探测成功时关闭并清空窗口
+  WaitOpenFor();
+  err = breaker.Call([] { return gerr::Error{}; });
+  Check(err == nullptr, "probe call runs");
+  Check(breaker.State() == gerr::CircuitState::kClosed, "good probe closes");
+  Report(breaker, 0, 9, kCodeA);
+  Check(!IsOpen(breaker), "window is cleared after closing");
+}
+
+void CheckKeys() {
+  gerr::CircuitBreaker breaker{gerr::CircuitKey::kCode, SmallOptions()};
+  // 两种错误码交替失败，各占 40%，合计超过比例但单独都没有达到
+  for (auto i = 0; i < 4; ++i) {
+    Report(breaker, 1, 2, kCodeA);
+    Report(breaker, 0, 2, kCodeB);
+  }
+  Check(!IsOpen(breaker), "failures are counted per key");
+  Report(breaker, 0, 6, kCodeB);
+  Check(IsOpen(breaker), "one key over the ratio opens");
+}
+
+void CheckIgnore() {
+  auto options = SmallOptions();
+  options.ignore = [](gerr::ErrorView err) {
+    return gerr::Is<ErrNotFound>(err);
+  };
+  gerr::CircuitBreaker breaker{gerr::CircuitKey::kCode, options};
+  for (auto i = 0; i < 20; ++i) {
+    breaker.Record(ErrNotFound::E());
+  }
+  Check(!IsOpen(breaker), "ignored errors are not failures");
+}
+
+void CheckException() {
+  auto options = SmallOptions();
+  auto exceptions = 0;
+  auto rejections = 0;
+  options.ignore = [&](gerr::ErrorView err) {
+    exceptions += gerr::As<gerr::details::ExceptionError>(err) != nullptr;
+    rejections += gerr::Is<gerr::ErrCircuitOpen>(err);
+    return false;
+  };
+  gerr::CircuitBreaker breaker{gerr::CircuitKey::kType, options};
+  auto const Throw = [&] {
+    try {
+      breaker.Call([]() -> gerr::Error {
+        throw std::runtime_error{"boom"};
+      });
+    } catch (std::runtime_error const&) {
+      return true;
+    }
+    return false;
+  };
+
+  auto rethrown = true;
+  for (auto i = 0; i < 10; ++i) {
+    rethrown = Throw() && rethrown;
+  }
+  Check(rethrown, "exception is rethrown");
+  Check(exceptions == 10 && rejections == 0,
+        "exception is recorded as an exception error");
+  Check(IsOpen(breaker), "exceptions count as failures");
+
+  // 半开状态的探测抛出异常时同样有结果，熔断器重新打开而不是一直半开
+  WaitOpenFor();
+  Check(Throw(), "probe exception is rethrown");
+  Check(IsOpen(breaker), "throwing probe reopens");
+}
+
+}  // namespace
+
+int main() {
+  CheckTransitions();
+  CheckKeys();
+  CheckIgnore();
+  CheckException();
+
+  if (failures != 0) {
+    std::fprintf(stderr, "%d circuit breaker check(s) failed\n", failures);
+    return 1;
+  }
+  std::printf("all circuit breaker checks passed\n");
+  return 0;
+}
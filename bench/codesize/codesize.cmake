@@ -0,0 +1,135 @@
+# 生成 COUNT 个错误类型，分别用 DEFINE_* 宏和旧版的 LEGACY_DEFINE_* 宏编译，
+# 对比目标文件体积和编译耗时。
+# 旧版宏里包装父错误的带环境信息的 E 重载无法通过编译，因此这里两边都只调用
+# 不带父错误的 E(context)。
+#
+# 用法（通常通过 gerr_codesize 目标调用）：
+#   cmake -DCXX=<compiler> -DINCLUDES="a;b" -DWORK_DIR=<dir> [-DCOUNT=1000]
+#         [-DSITES=2] [-DRUNS=5] [-DFLAGS="-O2"] -P codesize.cmake
+# SITES 是每个错误类型的调用点个数。
+# 编译耗时受机器负载影响较大，两种写法交替编译 RUNS 次，报告最短和中位数耗时。
+
+if(NOT COUNT)
+  set(COUNT 1000)
+endif()
+if(NOT SITES)
+  set(SITES 2)
+endif()
+if(NOT RUNS)
+  set(RUNS 5)
+endif()
+if(NOT FLAGS)
+  set(FLAGS -O2)
+endif()
+separate_arguments(FLAGS)
+
+set(include_flags)
+foreach(dir IN LISTS INCLUDES)
+  list(APPEND include_flags "-I${dir}")
+endforeach()
+
+find_program(SIZE_PROGRAM NAMES size llvm-size)
+
+function(generate_source style out)
+  if(style STREQUAL "legacy")
+    set(prefix "LEGACY_")
+    set(header "#include \"${CMAKE_CURRENT_LIST_DIR}/legacy_define.hpp\"")
+  else()
+    set(prefix "")
+    set(header "#include <gerr/gerr.hpp>")
+  endif()
+  set(src "${header}\n\nnamespace gen {\n\nstruct Ctx { int a; int b; };\n\n")
+  math(EXPR last "${COUNT} - 1")
+  foreach(i RANGE ${last})
+    math(EXPR kind "${i} % 4")
+    math(EXPR code "100000 + ${i}")
+    if(kind EQUAL 0)
+      string(APPEND src
+        "${prefix}DEFINE_ERROR(Err${i}, \"error message ${i}\");\n")
+      set(use "return c == nullptr ? Err${i}::E() : Err${i}::E(c);")
+    elseif(kind EQUAL 1)
+      string(APPEND src
+        "${prefix}DEFINE_CODE_ERROR(Err${i}, ${code}, \"error message ${i}\");\n")
+      set(use "return c == nullptr ? Err${i}::E() : Err${i}::E(c);")
+    elseif(kind EQUAL 2)
+      string(APPEND src
+        "${prefix}DEFINE_CONTEXT_ERROR(Err${i}, Ctx, \"error ${i}: {} {}\", "
+        "context.a, context.b);\n")
+      set(use "return Err${i}::E(Ctx{a, b});")
+    else()
+      string(APPEND src
+        "${prefix}DEFINE_CODE_CONTEXT_ERROR(Err${i}, ${code}, Ctx, "
+        "\"error ${i}: {} {}\", context.a, context.b);\n")
+      set(use "return Err${i}::E(Ctx{a, b});")
+    endif()
+    # 每个错误类型有 SITES 处调用点，模拟业务代码里同一个错误在多处返回的情况
+    math(EXPR last_site "${SITES} - 1")
+    foreach(site RANGE ${last_site})
+      string(APPEND src "gerr::Error Use${i}_${site}(gerr::Error const& c, "
+                        "int a, int b) {\n  ${use}\n}\n")
+    endforeach()
+  endforeach()
+  string(APPEND src "\n}  // namespace gen\n")
+  file(WRITE "${out}" "${src}")
+endfunction()
+
+# 编译一次 style 对应的源文件，耗时（毫秒）追加到 <style>_times 中
+function(compile_once style)
+  set(source "${WORK_DIR}/codesize_${style}.cpp")
+  set(object "${WORK_DIR}/codesize_${style}.o")
+  string(TIMESTAMP start "%s%f" UTC)
+  execute_process(
+    COMMAND ${CXX} -std=c++11 ${FLAGS} ${include_flags} -c ${source}
+            -o ${object}
+    RESULT_VARIABLE result)
+  string(TIMESTAMP stop "%s%f" UTC)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "failed to compile ${source}")
+  endif()
+  math(EXPR elapsed_ms "(${stop} - ${start}) / 1000")
+  set(times ${${style}_times})
+  list(APPEND times ${elapsed_ms})
+  set(${style}_times ${times} PARENT_SCOPE)
+endfunction()
+
+function(report style)
+  set(object "${WORK_DIR}/codesize_${style}.o")
+  # list(SORT) 按字符串排序，补齐到相同宽度后再排
+  set(padded)
+  foreach(ms IN LISTS ${style}_times)
+    string(LENGTH "${ms}" len)
+    math(EXPR pad "10 - ${len}")
+    string(REPEAT "0" ${pad} zeros)
+    list(APPEND padded "${zeros}${ms}")
+  endforeach()
+  list(SORT padded)
+  list(GET padded 0 min_ms)
+  math(EXPR mid "${RUNS} / 2")
+  list(GET padded ${mid} median_ms)
+  math(EXPR min_ms "${min_ms}")
+  math(EXPR median_ms "${median_ms}")
+
+  file(SIZE "${object}" object_bytes)
+  set(text_bytes "n/a")
+  if(SIZE_PROGRAM)
+    execute_process(COMMAND ${SIZE_PROGRAM} ${object} OUTPUT_VARIABLE out)
+    string(REGEX MATCH "\n[ \t]*([0-9]+)" _ "${out}")
+    set(text_bytes "${CMAKE_MATCH_1}")
+  endif()
+  message(STATUS "${style}: ${COUNT} error types x ${SITES} sites, "
+                 "compile min ${min_ms} ms / median ${median_ms} ms "
+                 "(${RUNS} runs), "
+                 "object ${object_bytes} bytes, text ${text_bytes} bytes")
+endfunction()
+
+file(MAKE_DIRECTORY "${WORK_DIR}")
+generate_source(legacy "${WORK_DIR}/codesize_legacy.cpp")
+generate_source(current "${WORK_DIR}/codesize_current.cpp")
+set(legacy_times)
+set(current_times)
+foreach(run RANGE 1 ${RUNS})
+  compile_once(legacy)
+  compile_once(current)
+endforeach()
+report(legacy)
+report(current)
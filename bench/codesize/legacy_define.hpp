@@ -0,0 +1,311 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#pragma once
+
+// 基准测试用：DEFINE_* 宏改为基于公共基类实现之前的原始实现，
+// 仅用于对比生成代码的体积和编译时间，不要在业务代码中使用。
+
+#include <gerr/gerr.hpp>
+
+#define LEGACY_DEFINE_ERROR(__ErrTypE__, __ErrMessagE__)                       \
+  class __ErrTypE__ : public ::gerr::details::IError {                         \
+   protected:                                                                  \
+    struct __PrivateStruct__ {};                                               \
+                                                                               \
+   public:                                                                     \
+    __ErrTypE__(__PrivateStruct__ const&) {}                                   \
+    __ErrTypE__(::gerr::Error __c__, __PrivateStruct__ const&)                 \
+        : __causE__{::std::move(__c__)} {}                                     \
+                                                                               \
+    static ::gerr::Error E() {                                                 \
+      static auto __valuE__ = ::gerr::Make<__ErrTypE__>(__PrivateStruct__{});  \
+      return __valuE__;                                                        \
+    }                                                                          \
+                                                                               \
+    template <class ErrType,                                                   \
+              class = typename ::std::enable_if<                               \
+                  ::std::is_base_of<IError, ErrType>::value>::type>            \
+    static ::gerr::Error E(::std::shared_ptr<ErrType>&& __p__) {               \
+      return ::gerr::Make<__ErrTypE__>(::std::move(__p__),                     \
+                                       __PrivateStruct__{});                   \
+    }                                                                          \
+                                                                               \
+    template <class ErrType,                                                   \
+              class = typename ::std::enable_if<                               \
+                  ::std::is_base_of<IError, ErrType>::value>::type>            \
+    static ::gerr::Error E(::std::shared_ptr<ErrType> const& __p__) {          \
+      return ::gerr::Make<__ErrTypE__>(__p__, __PrivateStruct__{});            \
+    }                                                                          \
+                                                                               \
+    char const* Message() const override { return __ErrMessagE__; }            \
+    ::gerr::Error const& Cause() const override { return __causE__; }          \
+                                                                               \
+   private:                                                                    \
+    ::gerr::Error __causE__{};                                                 \
+  }
+
+#define LEGACY_DEFINE_CODE_ERROR(__ErrTypE__, __ErrCodE__, __ErrMessagE__)     \
+  class __ErrTypE__ : public ::gerr::details::IError {                         \
+   protected:                                                                  \
+    struct __PrivateStruct__ {};                                               \
+                                                                               \
+   public:                                                                     \
+    __ErrTypE__(__PrivateStruct__ const&) {}                                   \
+    __ErrTypE__(::gerr::Error&& __c__, __PrivateStruct__ const&)               \
+        : __causE__{::std::move(__c__)} {}                                     \
+    __ErrTypE__(::gerr::Error const& __c__, __PrivateStruct__ const&)          \
+        : __causE__{__c__} {}                                                  \
+                                                                               \
+    static ::gerr::Error E() {                                                 \
+      static auto __valuE__ = ::gerr::Make<__ErrTypE__>(__PrivateStruct__{});  \
+      return __valuE__;                                                        \
+    }                                                                          \
+                                                                               \
+    template <class ErrType,                                                   \
+              class = typename ::std::enable_if<                               \
+                  ::std::is_base_of<IError, ErrType>::value>::type>            \
+    static ::gerr::Error E(::std::shared_ptr<ErrType>&& __p__) {               \
+      return ::gerr::Make<__ErrTypE__>(std::move(__p__), __PrivateStruct__{}); \
+    }                                                                          \
+                                                                               \
+    template <class ErrType,                                                   \
+              class = typename ::std::enable_if<                               \
+                  ::std::is_base_of<IError, ErrType>::value>::type>            \
+    static ::gerr::Error E(::std::shared_ptr<ErrType> const& __p__) {          \
+      return ::gerr::Make<__ErrTypE__>(__p__, __PrivateStruct__{});            \
+    }                                                                          \
+                                                                               \
+    int Code() const override { return __ErrCodE__; }                          \
+    char const* Message() const override { return __ErrMessagE__; }            \
+    ::gerr::Error const& Cause() const override { return __causE__; }          \
+                                                                               \
+   private:                                                                    \
+    ::gerr::Error __causE__{};                                                 \
+  }
+
+#define LEGACY_DEFINE_CONTEXT_ERROR(__ErrTypE__, __ContextTypE__,              \
+                                    __ErrFormaT__, ...)                        \
+  class __ErrTypE__ : public ::gerr::details::IError {                         \
+   protected:                                                                  \
+    struct __PrivateStruct__ {};                                               \
+                                                                               \
+   public:                                                                     \
+    using ContextType = __ContextTypE__;                                       \
+                                                                               \
+    __ErrTypE__(ContextType const& __ctX__, std::string&& __msG__,             \
+                __PrivateStruct__ const&)                                      \
+        : __contexT__{__ctX__}, __messagE__{std::move(__msG__)} {}             \
+                                                                               \
+    __ErrTypE__(ContextType&& __ctX__, std::string&& __msG__,                  \
+                __PrivateStruct__ const&)                                      \
+        : __contexT__{std::move(__ctX__)}, __messagE__{std::move(__msG__)} {}  \
+                                                                               \
+    __ErrTypE__(::gerr::Error&& __c__, ContextType const& __ctX__,             \
+                std::string&& __msG__, __PrivateStruct__ const&)               \
+        : __causE__{::std::move(__c__)},                                       \
+          __contexT__{__ctX__},                                                \
+          __messagE__{std::move(__msG__)} {}                                   \
+                                                                               \
+    __ErrTypE__(::gerr::Error const& __c__, ContextType const& __ctX__,        \
+                std::string&& __msG__, __PrivateStruct__ const&)               \
+        : __causE__{__c__},                                                    \
+          __contexT__{__ctX__},                                                \
+          __messagE__{std::move(__msG__)} {}                                   \
+                                                                               \
+    __ErrTypE__(::gerr::Error&& __c__, ContextType&& __ctX__,                  \
+                std::string&& __msG__, __PrivateStruct__ const&)               \
+        : __causE__{::std::move(__c__)},                                       \
+          __contexT__{std::move(__ctX__)},                                     \
+          __messagE__{std::move(__msG__)} {}                                   \
+                                                                               \
+    __ErrTypE__(::gerr::Error const& __c__, ContextType&& __ctX__,             \
+                std::string&& __msG__, __PrivateStruct__ const&)               \
+        : __causE__{__c__},                                                    \
+          __contexT__{std::move(__ctX__)},                                     \
+          __messagE__{std::move(__msG__)} {}                                   \
+                                                                               \
+    static ::gerr::Error E(ContextType const& context) {                       \
+      return ::gerr::Make<__ErrTypE__>(                                        \
+          context, fmt::format(__ErrFormaT__, __VA_ARGS__),                    \
+          __PrivateStruct__{});                                                \
+    }                                                                          \
+                                                                               \
+    static ::gerr::Error E(ContextType&& context) {                            \
+      auto __tempMsG__ = fmt::format(__ErrFormaT__, __VA_ARGS__);              \
+      return ::gerr::Make<__ErrTypE__>(context, std::move(__tempMsG__),        \
+                                       __PrivateStruct__{});                   \
+    }                                                                          \
+                                                                               \
+    template <class ErrType,                                                   \
+              class = typename ::std::enable_if<                               \
+                  ::std::is_base_of<IError, ErrType>::value>::type>            \
+    static ::gerr::Error E(::std::shared_ptr<ErrType>&& __p__,                 \
+                           ContextType const& context) {                       \
+      return ::gerr::Make<__ErrTypE__>(                                        \
+          ::std::move(__p__), fmt::format(__ErrFormaT__, __VA_ARGS__),         \
+          __PrivateStruct__{});                                                \
+    }                                                                          \
+                                                                               \
+    template <class ErrType,                                                   \
+              class = typename ::std::enable_if<                               \
+                  ::std::is_base_of<IError, ErrType>::value>::type>            \
+    static ::gerr::Error E(::std::shared_ptr<ErrType> const& __p__,            \
+                           ContextType const& context) {                       \
+      return ::gerr::Make<__ErrTypE__>(                                        \
+          __p__, fmt::format(__ErrFormaT__, __VA_ARGS__),                      \
+          __PrivateStruct__{});                                                \
+    }                                                                          \
+                                                                               \
+    template <class ErrType,                                                   \
+              class = typename ::std::enable_if<                               \
+                  ::std::is_base_of<IError, ErrType>::value>::type>            \
+    static ::gerr::Error E(::std::shared_ptr<ErrType>&& __p__,                 \
+                           ContextType&& context) {                            \
+      auto __tempMsG__ = fmt::format(__ErrFormaT__, __VA_ARGS__);              \
+      return ::gerr::Make<__ErrTypE__>(                                        \
+          ::std::move(__p__), std::move(__tempMsG__), __PrivateStruct__{});    \
+    }                                                                          \
+                                                                               \
+    template <class ErrType,                                                   \
+              class = typename ::std::enable_if<                               \
+                  ::std::is_base_of<IError, ErrType>::value>::type>            \
+    static ::gerr::Error E(::std::shared_ptr<ErrType> const& __p__,            \
+                           ContextType&& context) {                            \
+      auto __tempMsG__ = fmt::format(__ErrFormaT__, __VA_ARGS__);              \
+      return ::gerr::Make<__ErrTypE__>(__p__, std::move(__tempMsG__),          \
+                                       __PrivateStruct__{});                   \
+    }                                                                          \
+                                                                               \
+    char const* Message() const override { return __messagE__.c_str(); }       \
+    ::gerr::Error const& Cause() const override { return __causE__; }          \
+    ContextType& Context() { return __contexT__; }                             \
+                                                                               \
+   private:                                                                    \
+    ::gerr::Error __causE__{};                                                 \
+    ContextType __contexT__{};                                                 \
+    ::std::string __messagE__{};                                               \
+  }
+
+#define LEGACY_DEFINE_CODE_CONTEXT_ERROR(                                      \
+    __ErrTypE__, __ErrCodE__, __ContextTypE__, __ErrFormaT__, ...)             \
+  class __ErrTypE__ : public ::gerr::details::IError {                         \
+   protected:                                                                  \
+    struct __PrivateStruct__ {};                                               \
+                                                                               \
+   public:                                                                     \
+    using ContextType = __ContextTypE__;                                       \
+                                                                               \
+    __ErrTypE__(ContextType const& __ctX__, std::string&& __msG__,             \
+                __PrivateStruct__ const&)                                      \
+        : __contexT__{__ctX__}, __messagE__{std::move(__msG__)} {}             \
+                                                                               \
+    __ErrTypE__(ContextType&& __ctX__, std::string&& __msG__,                  \
+                __PrivateStruct__ const&)                                      \
+        : __contexT__{std::move(__ctX__)}, __messagE__{std::move(__msG__)} {}  \
+                                                                               \
+    __ErrTypE__(::gerr::Error&& __c__, ContextType const& __ctX__,             \
+                std::string&& __msG__, __PrivateStruct__ const&)               \
+        : __causE__{::std::move(__c__)},                                       \
+          __contexT__{__ctX__},                                                \
+          __messagE__{std::move(__msG__)} {}                                   \
+                                                                               \
+    __ErrTypE__(::gerr::Error const& __c__, ContextType const& __ctX__,        \
+                std::string&& __msG__, __PrivateStruct__ const&)               \
+        : __causE__{__c__},                                                    \
+          __contexT__{__ctX__},                                                \
+          __messagE__{std::move(__msG__)} {}                                   \
+                                                                               \
+    __ErrTypE__(::gerr::Error&& __c__, ContextType&& __ctX__,                  \
+                std::string&& __msG__, __PrivateStruct__ const&)               \
+        : __causE__{::std::move(__c__)},                                       \
+          __contexT__{std::move(__ctX__)},                                     \
+          __messagE__{std::move(__msG__)} {}                                   \
+                                                                               \
+    __ErrTypE__(::gerr::Error const& __c__, ContextType&& __ctX__,             \
+                std::string&& __msG__, __PrivateStruct__ const&)               \
+        : __causE__{__c__},                                                    \
+          __contexT__{std::move(__ctX__)},                                     \
+          __messagE__{std::move(__msG__)} {}                                   \
+                                                                               \
+    static ::gerr::Error E(ContextType const& context) {                       \
+      return ::gerr::Make<__ErrTypE__>(                                        \
+          context, fmt::format(__ErrFormaT__, __VA_ARGS__),                    \
+          __PrivateStruct__{});                                                \
+    }                                                                          \
+                                                                               \
+    static ::gerr::Error E(ContextType&& context) {                            \
+      auto __tempMsG__ = fmt::format(__ErrFormaT__, __VA_ARGS__);              \
+      return ::gerr::Make<__ErrTypE__>(context, std::move(__tempMsG__),        \
+                                       __PrivateStruct__{});                   \
+    }                                                                          \
+                                                                               \
+    template <class ErrType,                                                   \
+              class = typename ::std::enable_if<::std::is_base_of<             \
+                  ::gerr::details::IError, ErrType>::value>::type>             \
+    static ::gerr::Error E(::std::shared_ptr<ErrType>&& __p__,                 \
+                           ContextType const& context) {                       \
+      return ::gerr::Make<__ErrTypE__>(                                        \
+          ::std::move(__p__), fmt::format(__ErrFormaT__, __VA_ARGS__),         \
+          __PrivateStruct__{});                                                \
+    }                                                                          \
+                                                                               \
+    template <class ErrType,                                                   \
+              class = typename ::std::enable_if<::std::is_base_of<             \
+                  ::gerr::details::IError, ErrType>::value>::type>             \
+    static ::gerr::Error E(::std::shared_ptr<ErrType> const& __p__,            \
+                           ContextType const& context) {                       \
+      return ::gerr::Make<__ErrTypE__>(                                        \
+          __p__, fmt::format(__ErrFormaT__, __VA_ARGS__),                      \
+          __PrivateStruct__{});                                                \
+    }                                                                          \
+                                                                               \
+    template <class ErrType,                                                   \
+              class = typename ::std::enable_if<::std::is_base_of<             \
+                  ::gerr::details::IError, ErrType>::value>::type>             \
+    static ::gerr::Error E(::std::shared_ptr<ErrType>&& __p__,                 \
+                           ContextType&& context) {                            \
+      auto __tempMsG__ = fmt::format(__ErrFormaT__, __VA_ARGS__);              \
+      return ::gerr::Make<__ErrTypE__>(                                        \
+          ::std::move(__p__), std::move(__tempMsG__), __PrivateStruct__{});    \
+    }                                                                          \
+                                                                               \
+    template <class ErrType,                                                   \
+              class = typename ::std::enable_if<::std::is_base_of<             \
+                  ::gerr::details::IError, ErrType>::value>::type>             \
+    static ::gerr::Error E(::std::shared_ptr<ErrType> const& __p__,            \
+                           ContextType&& context) {                            \
+      auto __tempMsG__ = fmt::format(__ErrFormaT__, __VA_ARGS__);              \
+      return ::gerr::Make<__ErrTypE__>(__p__, std::move(__tempMsG__),          \
+                                       __PrivateStruct__{});                   \
+    }                                                                          \
+                                                                               \
+    int Code() const override { return __ErrCodE__; }                          \
+    char const* Message() const override { return __messagE__.c_str(); }       \
+    ::gerr::Error const& Cause() const override { return __causE__; }          \
+    ContextType& Context() { return __contexT__; }                             \
+                                                                               \
+   private:                                                                    \
+    ::gerr::Error __causE__{};                                                 \
+    ContextType __contexT__{};                                                 \
+    ::std::string __messagE__{};                                               \
+  }
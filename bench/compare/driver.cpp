@@ -0,0 +1,140 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "workload.hpp"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// 用法：gerr_compare_<variant> [失败率百分比，默认 10] [调用次数，默认 200000]
+// 输出一行结果：每次调用耗时的分位数（纳秒，包含一次 steady_clock::now 的开销），
+// 以及平均每次调用执行的指令数（perf_event 不可用时为 n/a）。
+
+namespace {
+
+/** 统计 fn 执行的用户态指令数，不支持时返回 -1 */
+template <class Fn>
+long long CountInstructions(Fn fn) {
+#ifdef __linux__
+  perf_event_attr attr{};
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  auto const fd = static_cast<int>(
+      syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+  if (fd >= 0) {
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    fn();
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    long long count = -1;
+    if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+      count = -1;
+    }
+    close(fd);
+    return count;
+  }
+#endif
+  fn();
+  return -1;
+}
+
+/** 输入序列是固定种子的伪随机数，保证各个 variant 的失败位置完全相同 */
+std::vector<std::uint32_t> MakeInputs(std::size_t count) {
+  std::vector<std::uint32_t> inputs(count);
+  std::uint32_t x = 2463534242u;
+  for (auto& input : inputs) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    input = x;
+  }
+  return inputs;
+}
+
+double Percentile(std::vector<double> const& sorted, double p) {
+  auto const i = static_cast<std::size_t>(p * (sorted.size() - 1));
+  return sorted[i];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  auto const failPercent = argc > 1 ? std::atof(argv[1]) : 10.0;
+  auto const calls = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200000ul;
+  if (failPercent < 0 || failPercent > 100 || calls == 0) {
+    std::fprintf(stderr, "usage: %s [fail-percent 0-100] [calls]\n", argv[0]);
+    return 1;
+  }
+  auto const threshold = static_cast<std::uint32_t>(failPercent * 100 + 0.5);
+  auto const inputs = MakeInputs(calls);
+
+  // 预热，同时让各个 variant 的静态对象完成初始化
+  std::size_t failures = 0;
+  for (auto input : inputs) {
+    failures += compare::Run(input, threshold) ? 0 : 1;
+  }
+
+  auto const instructions = CountInstructions([&] {
+    for (auto input : inputs) {
+      compare::Run(input, threshold);
+    }
+  });
+
+  std::vector<double> latencies;
+  latencies.reserve(inputs.size());
+  for (auto input : inputs) {
+    auto const begin = std::chrono::steady_clock::now();
+    compare::Run(input, threshold);
+    auto const end = std::chrono::steady_clock::now();
+    latencies.push_back(
+        std::chrono::duration<double, std::nano>(end - begin).count());
+  }
+  std::sort(latencies.begin(), latencies.end());
+
+  std::printf("%-10s fail=%5.1f%% calls=%zu failed=%zu p50=%.0fns p90=%.0fns "
+              "p99=%.0fns p999=%.0fns max=%.0fns",
+              compare::kVariant, failPercent, inputs.size(), failures,
+              Percentile(latencies, 0.5), Percentile(latencies, 0.9),
+              Percentile(latencies, 0.99), Percentile(latencies, 0.999),
+              latencies.back());
+  if (instructions >= 0) {
+    std::printf(" instr/call=%.1f\n",
+                static_cast<double>(instructions) / inputs.size());
+  } else {
+    std::printf(" instr/call=n/a\n");
+  }
+  return 0;
+}
@@ -0,0 +1,87 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <system_error>
+
+#include "workload.hpp"
+
+// std::error_code 返回值 + 输出参数，错误中只有错误码
+
+namespace compare {
+
+char const* const kVariant = "error_code";
+
+namespace {
+
+COMPARE_NOINLINE std::error_code Layer5(std::uint32_t input,
+                                        std::uint32_t failThreshold,
+                                        int* out) {
+  if (!Parse(input, failThreshold, out)) {
+    return std::make_error_code(std::errc::invalid_argument);
+  }
+  return {};
+}
+
+COMPARE_NOINLINE std::error_code Layer4(std::uint32_t input,
+                                        std::uint32_t failThreshold,
+                                        int* out) {
+  int value = 0;
+  auto ec = Layer5(input, failThreshold, &value);
+  if (ec) {
+    return ec;
+  }
+  *out = value + 4;
+  return {};
+}
+
+COMPARE_NOINLINE std::error_code Layer3(std::uint32_t input,
+                                        std::uint32_t failThreshold,
+                                        int* out) {
+  int value = 0;
+  auto ec = Layer4(input, failThreshold, &value);
+  if (ec) {
+    return ec;
+  }
+  *out = value + 3;
+  return {};
+}
+
+COMPARE_NOINLINE std::error_code Layer2(std::uint32_t input,
+                                        std::uint32_t failThreshold,
+                                        int* out) {
+  int value = 0;
+  auto ec = Layer3(input, failThreshold, &value);
+  if (ec) {
+    return ec;
+  }
+  *out = value + 2;
+  return {};
+}
+
+}  // namespace
+
+bool Run(std::uint32_t input, std::uint32_t failThreshold) {
+  int value = 0;
+  return !Layer2(input, failThreshold, &value);
+}
+
+}  // namespace compare
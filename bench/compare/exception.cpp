@@ -0,0 +1,80 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <fmt/format.h>
+
+#include <stdexcept>
+#include <string>
+
+#include "workload.hpp"
+
+// 异常，中间各层不捕获，只在最外层捕获
+
+namespace compare {
+
+char const* const kVariant = "exception";
+
+namespace {
+
+class ParseError : public std::runtime_error {
+ public:
+  ParseError(int code, std::string const& message)
+      : std::runtime_error{message}, code_{code} {}
+
+  int Code() const { return code_; }
+
+ private:
+  int code_{};
+};
+
+COMPARE_NOINLINE int Layer5(std::uint32_t input, std::uint32_t failThreshold) {
+  int value = 0;
+  if (!Parse(input, failThreshold, &value)) {
+    throw ParseError{kParseErrorCode, fmt::format("bad input: {}", input)};
+  }
+  return value;
+}
+
+COMPARE_NOINLINE int Layer4(std::uint32_t input, std::uint32_t failThreshold) {
+  return Layer5(input, failThreshold) + 4;
+}
+
+COMPARE_NOINLINE int Layer3(std::uint32_t input, std::uint32_t failThreshold) {
+  return Layer4(input, failThreshold) + 3;
+}
+
+COMPARE_NOINLINE int Layer2(std::uint32_t input, std::uint32_t failThreshold) {
+  return Layer3(input, failThreshold) + 2;
+}
+
+}  // namespace
+
+bool Run(std::uint32_t input, std::uint32_t failThreshold) {
+  try {
+    Layer2(input, failThreshold);
+    return true;
+  } catch (ParseError const& e) {
+    return e.Code() == 0;
+  }
+}
+
+}  // namespace compare
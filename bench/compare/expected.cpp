@@ -0,0 +1,115 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <new>
+#include <system_error>
+#include <utility>
+
+#include "workload.hpp"
+
+// 类似 std::expected<T, std::error_code> 的最小实现，值和错误码共用存储
+
+namespace compare {
+
+char const* const kVariant = "expected";
+
+namespace {
+
+template <class T, class E>
+class Expected {
+ public:
+  Expected(T value) : hasValue_{true} { new (&value_) T(std::move(value)); }
+  Expected(E error) : hasValue_{false} { new (&error_) E(std::move(error)); }
+  Expected(Expected&& src) : hasValue_{src.hasValue_} {
+    if (hasValue_) {
+      new (&value_) T(std::move(src.value_));
+    } else {
+      new (&error_) E(std::move(src.error_));
+    }
+  }
+  Expected(Expected const&) = delete;
+  Expected& operator=(Expected const&) = delete;
+  ~Expected() {
+    if (hasValue_) {
+      value_.~T();
+    } else {
+      error_.~E();
+    }
+  }
+
+  bool HasValue() const { return hasValue_; }
+  T const& Value() const { return value_; }
+  E const& Error() const { return error_; }
+
+ private:
+  bool hasValue_;
+  union {
+    T value_;
+    E error_;
+  };
+};
+
+using ExpectedInt = Expected<int, std::error_code>;
+
+COMPARE_NOINLINE ExpectedInt Layer5(std::uint32_t input,
+                                    std::uint32_t failThreshold) {
+  int value = 0;
+  if (!Parse(input, failThreshold, &value)) {
+    return std::make_error_code(std::errc::invalid_argument);
+  }
+  return value;
+}
+
+COMPARE_NOINLINE ExpectedInt Layer4(std::uint32_t input,
+                                    std::uint32_t failThreshold) {
+  auto e = Layer5(input, failThreshold);
+  if (!e.HasValue()) {
+    return e.Error();
+  }
+  return e.Value() + 4;
+}
+
+COMPARE_NOINLINE ExpectedInt Layer3(std::uint32_t input,
+                                    std::uint32_t failThreshold) {
+  auto e = Layer4(input, failThreshold);
+  if (!e.HasValue()) {
+    return e.Error();
+  }
+  return e.Value() + 3;
+}
+
+COMPARE_NOINLINE ExpectedInt Layer2(std::uint32_t input,
+                                    std::uint32_t failThreshold) {
+  auto e = Layer3(input, failThreshold);
+  if (!e.HasValue()) {
+    return e.Error();
+  }
+  return e.Value() + 2;
+}
+
+}  // namespace
+
+bool Run(std::uint32_t input, std::uint32_t failThreshold) {
+  return Layer2(input, failThreshold).HasValue();
+}
+
+}  // namespace compare
@@ -0,0 +1,84 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <gerr/gerr.hpp>
+
+#include "workload.hpp"
+
+// gerr::Error 返回值 + 输出参数
+
+namespace compare {
+
+char const* const kVariant = "gerr";
+
+namespace {
+
+COMPARE_NOINLINE gerr::Error Layer5(std::uint32_t input,
+                                    std::uint32_t failThreshold, int* out) {
+  if (!Parse(input, failThreshold, out)) {
+    return gerr::New(kParseErrorCode, "bad input: {}", input);
+  }
+  return nullptr;
+}
+
+COMPARE_NOINLINE gerr::Error Layer4(std::uint32_t input,
+                                    std::uint32_t failThreshold, int* out) {
+  int value = 0;
+  auto err = Layer5(input, failThreshold, &value);
+  if (err != nullptr) {
+    return err;
+  }
+  *out = value + 4;
+  return nullptr;
+}
+
+COMPARE_NOINLINE gerr::Error Layer3(std::uint32_t input,
+                                    std::uint32_t failThreshold, int* out) {
+  int value = 0;
+  auto err = Layer4(input, failThreshold, &value);
+  if (err != nullptr) {
+    return err;
+  }
+  *out = value + 3;
+  return nullptr;
+}
+
+COMPARE_NOINLINE gerr::Error Layer2(std::uint32_t input,
+                                    std::uint32_t failThreshold, int* out) {
+  int value = 0;
+  auto err = Layer3(input, failThreshold, &value);
+  if (err != nullptr) {
+    return err;
+  }
+  *out = value + 2;
+  return nullptr;
+}
+
+}  // namespace
+
+bool Run(std::uint32_t input, std::uint32_t failThreshold) {
+  int value = 0;
+  auto err = Layer2(input, failThreshold, &value);
+  return gerr::Code(err) == 0;
+}
+
+}  // namespace compare
@@ -0,0 +1,77 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <gerr/result.hpp>
+
+#include "workload.hpp"
+
+// gerr::Result，值和 gerr::Error 二选一
+
+namespace compare {
+
+char const* const kVariant = "result";
+
+namespace {
+
+COMPARE_NOINLINE gerr::Result<int> Layer5(std::uint32_t input,
+                                          std::uint32_t failThreshold) {
+  int value = 0;
+  if (!Parse(input, failThreshold, &value)) {
+    return gerr::New(kParseErrorCode, "bad input: {}", input);
+  }
+  return value;
+}
+
+COMPARE_NOINLINE gerr::Result<int> Layer4(std::uint32_t input,
+                                          std::uint32_t failThreshold) {
+  auto r = Layer5(input, failThreshold);
+  if (!r) {
+    return r.Error();
+  }
+  return r.Value() + 4;
+}
+
+COMPARE_NOINLINE gerr::Result<int> Layer3(std::uint32_t input,
+                                          std::uint32_t failThreshold) {
+  auto r = Layer4(input, failThreshold);
+  if (!r) {
+    return r.Error();
+  }
+  return r.Value() + 3;
+}
+
+COMPARE_NOINLINE gerr::Result<int> Layer2(std::uint32_t input,
+                                          std::uint32_t failThreshold) {
+  auto r = Layer3(input, failThreshold);
+  if (!r) {
+    return r.Error();
+  }
+  return r.Value() + 2;
+}
+
+}  // namespace
+
+bool Run(std::uint32_t input, std::uint32_t failThreshold) {
+  return Layer2(input, failThreshold).IsSuccess();
+}
+
+}  // namespace compare
@@ -0,0 +1,62 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#pragma once
+
+#include <cstdint>
+
+// 错误处理方式对比基准的公共部分。每种错误处理方式（variant）各自编译成一个
+// 可执行文件，实现同一个 5 层调用栈的工作负载：最底层按给定的失败率返回错误，
+// 错误带着错误码和包含输入值的错误信息（std::error_code 只有错误码），
+// 中间各层只负责把错误原样向上传递。driver.cpp 负责计时和统计。
+
+#if defined(__GNUC__)
+#define COMPARE_NOINLINE __attribute__((noinline))
+#else
+#define COMPARE_NOINLINE
+#endif
+
+namespace compare {
+
+constexpr int kParseErrorCode = 1001;
+
+/** 当前可执行文件对应的错误处理方式名称 */
+extern char const* const kVariant;
+
+/**
+ * 执行一次完整的 5 层调用，返回是否成功。
+ * input % 10000 小于 failThreshold 时最底层返回错误，即失败率为
+ * failThreshold / 10000。
+ */
+bool Run(std::uint32_t input, std::uint32_t failThreshold);
+
+/** 最底层的计算，各个 variant 共用，保证成功路径上的工作量一致 */
+inline bool Parse(std::uint32_t input, std::uint32_t failThreshold,
+                  int* out) {
+  if (input % 10000 < failThreshold) {
+    return false;
+  }
+  *out = static_cast<int>(input % 97);
+  return true;
+}
+
+}  // namespace compare
@@ -0,0 +1,108 @@
+# 生成一个包含 COUNT 个翻译单元的合成工程，每个翻译单元都使用 gerr 定义错误、
+# 格式化和打印错误，分别以 header-only 和链接 gerr 库（GERR_COMPILED_LIB）
+# 两种方式构建，对比总的编译耗时和目标文件体积。
+# 链接库的一方会额外编译一次 src/gerr.cpp，计入总耗时。
+#
+# 用法（通常通过 gerr_compiletime 目标调用）：
+#   cmake -DCXX=<compiler> -DGENERATOR=<generator> -DSOURCE_DIR=<gerr 源码目录>
+#         -DINCLUDES="a;b" -DWORK_DIR=<dir> [-DCOUNT=500] [-DJOBS=<n>]
+#         [-DFLAGS="-O2"] -P compiletime.cmake
+
+if(NOT COUNT)
+  set(COUNT 500)
+endif()
+if(NOT JOBS)
+  cmake_host_system_information(RESULT JOBS QUERY NUMBER_OF_LOGICAL_CORES)
+endif()
+if(NOT FLAGS)
+  set(FLAGS -O2)
+endif()
+
+function(generate_project dir)
+  set(sources)
+  math(EXPR last "${COUNT} - 1")
+  foreach(i RANGE ${last})
+    math(EXPR code "100000 + ${i}")
+    file(WRITE "${dir}/tu_${i}.cpp"
+      "#include <gerr/gerr.hpp>\n\n"
+      "namespace synth {\n\n"
+      "struct Ctx${i} { int a; int b; };\n\n"
+      "DEFINE_CODE_ERROR(ErrStatic${i}, ${code}, \"static error ${i}\");\n"
+      "DEFINE_CODE_CONTEXT_ERROR(ErrContext${i}, ${code}, Ctx${i},\n"
+      "                          \"context error ${i}: {} {}\", context.a,\n"
+      "                          context.b);\n\n"
+      "gerr::Error Call${i}(int a, int b) {\n"
+      "  if (a < 0) {\n"
+      "    return gerr::New(${code}, \"negative a={} in tu ${i}\", a);\n"
+      "  }\n"
+      "  if (b < 0) {\n"
+      "    return ErrStatic${i}::E();\n"
+      "  }\n"
+      "  return gerr::Wrap(ErrContext${i}::E({a, b}), \"call ${i}: b={}\", b);\n"
+      "}\n\n"
+      "std::string Describe${i}(int a, int b) {\n"
+      "  auto const err = Call${i}(a, b);\n"
+      "  if (gerr::IsCode(${code}, err)) {\n"
+      "    return std::to_string(gerr::Code(err)) + gerr::String(err);\n"
+      "  }\n"
+      "  return gerr::String(err);\n"
+      "}\n\n"
+      "}  // namespace synth\n")
+    list(APPEND sources "tu_${i}.cpp")
+  endforeach()
+
+  string(REPLACE ";" "\n  " source_lines "${sources}")
+  file(WRITE "${dir}/CMakeLists.txt"
+    "cmake_minimum_required(VERSION 3.13)\n"
+    "project(gerr_synth CXX)\n"
+    "set(CMAKE_CXX_STANDARD 11)\n"
+    "set(sources\n  ${source_lines})\n"
+    "if(GERR_COMPILED)\n"
+    "  list(APPEND sources \"${SOURCE_DIR}/src/gerr.cpp\")\n"
+    "endif()\n"
+    "add_library(synth STATIC \${sources})\n"
+    "target_include_directories(synth PRIVATE ${INCLUDES})\n"
+    "if(GERR_COMPILED)\n"
+    "  target_compile_definitions(synth PRIVATE GERR_COMPILED_LIB)\n"
+    "endif()\n")
+endfunction()
+
+function(measure style compiled)
+  set(build_dir "${WORK_DIR}/build_${style}")
+  file(REMOVE_RECURSE "${build_dir}")
+  execute_process(
+    COMMAND ${CMAKE_COMMAND} -S ${WORK_DIR}/project -B ${build_dir}
+            -G ${GENERATOR} -DCMAKE_CXX_COMPILER=${CXX}
+            "-DCMAKE_CXX_FLAGS=${FLAGS}" -DGERR_COMPILED=${compiled}
+    OUTPUT_QUIET
+    RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "failed to configure ${style}")
+  endif()
+
+  string(TIMESTAMP start "%s%f" UTC)
+  execute_process(
+    COMMAND ${CMAKE_COMMAND} --build ${build_dir} --parallel ${JOBS}
+    OUTPUT_QUIET
+    RESULT_VARIABLE result)
+  string(TIMESTAMP stop "%s%f" UTC)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "failed to build ${style}")
+  endif()
+  math(EXPR elapsed_ms "(${stop} - ${start}) / 1000")
+
+  file(GLOB_RECURSE objects "${build_dir}/*.o" "${build_dir}/*.obj")
+  set(object_bytes 0)
+  foreach(object IN LISTS objects)
+    file(SIZE "${object}" size)
+    math(EXPR object_bytes "${object_bytes} + ${size}")
+  endforeach()
+  message(STATUS "${style}: ${COUNT} TUs, ${JOBS} jobs, build ${elapsed_ms} ms, "
+                 "objects ${object_bytes} bytes")
+endfunction()
+
+file(REMOVE_RECURSE "${WORK_DIR}/project")
+file(MAKE_DIRECTORY "${WORK_DIR}/project")
+generate_project("${WORK_DIR}/project")
+measure(header_only OFF)
+measure(compiled ON)
@@ -0,0 +1,134 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <benchmark/benchmark.h>
+
+#include <cerrno>
+#include <cstring>
+#include <gerr/gerr.hpp>
+
+// 错误创建开销，同一份代码分别以普通模式（gerr_create_bench）和
+// GERR_STRIP_MESSAGES 模式（gerr_create_bench_stripped）编译，用于对比剥离
+// 错误信息之后的收益。
+
+namespace {
+
+struct CallContext {
+  int uin;
+  char const* client;
+};
+
+DEFINE_CODE_ERROR(ErrTimeout, 1001, "call timeout");
+DEFINE_CODE_CONTEXT_ERROR(ErrCallFailed, 1002, CallContext,
+                          "fail to call: uin={}, client={}", context.uin,
+                          context.client);
+
+constexpr int kUin = 123456789;
+constexpr char const* kName = "some-client";
+
+void BM_DefineStatic(benchmark::State& state) {
+  for (auto _ : state) {
+    auto err = ErrTimeout::E();
+    benchmark::DoNotOptimize(err);
+  }
+}
+BENCHMARK(BM_DefineStatic);
+
+void BM_DefineWrap(benchmark::State& state) {
+  auto const cause = gerr::New("cause");
+  for (auto _ : state) {
+    auto err = ErrTimeout::E(cause);
+    benchmark::DoNotOptimize(err);
+  }
+}
+BENCHMARK(BM_DefineWrap);
+
+void BM_DefineContext(benchmark::State& state) {
+  for (auto _ : state) {
+    auto err = ErrCallFailed::E(CallContext{kUin, kName});
+    benchmark::DoNotOptimize(err);
+  }
+}
+BENCHMARK(BM_DefineContext);
+
+void BM_NewMessage(benchmark::State& state) {
+  for (auto _ : state) {
+    auto err = gerr::New(1, "fail to call");
+    benchmark::DoNotOptimize(err);
+  }
+}
+BENCHMARK(BM_NewMessage);
+
+void BM_NewMessageCopy(benchmark::State& state) {
+  auto const err = gerr::New(1, "fail to call");
+  for (auto _ : state) {
+    auto copy = err;
+    benchmark::DoNotOptimize(copy);
+  }
+}
+BENCHMARK(BM_NewMessageCopy)->ThreadRange(1, 4);
+
+void BM_NewFormat(benchmark::State& state) {
+  for (auto _ : state) {
+    auto err = gerr::New(1, "fail to call: uin={}, client={}", kUin, kName);
+    benchmark::DoNotOptimize(err);
+  }
+}
+BENCHMARK(BM_NewFormat);
+
+void BM_WrapFormat(benchmark::State& state) {
+  auto const cause = gerr::New("cause");
+  for (auto _ : state) {
+    auto err = gerr::Wrap(cause, 2, "retry {} of {}", 3, 5);
+    benchmark::DoNotOptimize(err);
+  }
+}
+BENCHMARK(BM_WrapFormat);
+
+void BM_ErrnoEager(benchmark::State& state) {
+  for (auto _ : state) {
+    auto err = gerr::New(ENOENT, "open: {}", std::strerror(ENOENT));
+    benchmark::DoNotOptimize(err);
+  }
+}
+BENCHMARK(BM_ErrnoEager);
+
+void BM_FromErrno(benchmark::State& state) {
+  for (auto _ : state) {
+    auto err = gerr::FromErrno(ENOENT);
+    benchmark::DoNotOptimize(err);
+  }
+}
+BENCHMARK(BM_FromErrno);
+
+void BM_FromErrorCode(benchmark::State& state) {
+  auto const ec = std::make_error_code(std::io_errc::stream);
+  for (auto _ : state) {
+    auto err = gerr::FromErrorCode(ec);
+    benchmark::DoNotOptimize(err);
+  }
+}
+BENCHMARK(BM_FromErrorCode);
+
+}  // namespace
+
+BENCHMARK_MAIN();
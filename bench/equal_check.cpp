@@ -0,0 +1,188 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <gerr/gerr.hpp>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// 错误链条结构相等和哈希的检查：在一组有意构造的错误上两两比较，
+// DeepEqual 成立时 DeepHash 必须相等，ShapeEqual 同理，DeepEqual 蕴含
+// ShapeEqual，比较满足自反和对称；再检查几组具体的预期结果，以及在其他线程
+// 计算的哈希值相同，结果不符时以非 0 值退出
+
+namespace {
+
+struct Key {
+  int uin;
+};
+
+DEFINE_ERROR(ErrPlain, "plain error");
+DEFINE_CODE_ERROR(ErrTimeout, 1001, "call timeout");
+DEFINE_CODE_ERROR(ErrOther, 1001, "call timeout");
+DEFINE_CODE_CONTEXT_ERROR(ErrCallFailed, 1002, Key, "fail to call: uin={}",
+                          context.uin);
+
+int failures = 0;
+
+void Check(bool ok, char const* what) {
+  if (!ok) {
+    std::fprintf(stderr, "FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+/** 各种节点类型、长度、共享父错误和内容重复的错误 */
+std::vector<gerr::Error> Corpus() {
+  auto const shared = gerr::Wrap(ErrTimeout::E(), "query {}", "users");
+  std::string const host = "db-1";
+  return {
+      nullptr,
+      gerr::New("static text"),
+      gerr::New("static text"),
+      gerr::New(std::string{"static text"}),
+      gerr::New("{}", "static text"),
+      gerr::New(1001, "static text"),
+      gerr::New("connect {} timeout", "a"),
+      gerr::New("connect {} timeout", "a"),
+      gerr::New("connect {} timeout", "b"),
+      gerr::New(1001, "connect {} timeout", "a"),
+      ErrPlain::E(),
+      ErrTimeout::E(),
+      ErrTimeout::E(nullptr),
+      ErrOther::E(),
+      ErrTimeout::E(ErrPlain::E()),
+      ErrTimeout::E(gerr::New("static text")),
+      ErrCallFailed::E(Key{1}),
+      ErrCallFailed::E(Key{1}),
+      ErrCallFailed::E(Key{2}),
+      ErrCallFailed::E(ErrTimeout::E(), Key{1}),
+      shared,
+      gerr::Wrap(shared, "handle"),
+      gerr::Wrap(shared, "handle"),
+      gerr::Wrap(gerr::Wrap(ErrTimeout::E(), "query {}", "users"), "handle"),
+      gerr::Wrap(shared, 2002),
+      gerr::Wrap(shared, 2002, "handle {}", host),
+      gerr::Wrap(gerr::Wrap(shared, "handle"), "serve"),
+      gerr::FromErrno(ENOENT)->AsError(),
+      gerr::Wrap(gerr::FromErrno(ENOENT)->AsError(), "open"),
+      gerr::Wrap(gerr::FromErrno(EACCES)->AsError(), "open"),
+  };
+}
+
+void CheckPairs(std::vector<gerr::Error> const& errors) {
+  for (auto const& a : errors) {
+    Check(gerr::DeepEqual(a, a) && gerr::ShapeEqual(a, a), "reflexive");
+    for (auto const& b : errors) {
+      auto const deep = gerr::DeepEqual(a, b);
+      auto const shape = gerr::ShapeEqual(a, b);
+      Check(deep == gerr::DeepEqual(b, a), "DeepEqual is symmetric");
+      Check(shape == gerr::ShapeEqual(b, a), "ShapeEqual is symmetric");
+      Check(!deep || shape, "DeepEqual implies ShapeEqual");
+      Check(!deep || gerr::DeepHash(a) == gerr::DeepHash(b),
+            "DeepEqual implies equal DeepHash");
+      Check(!shape || gerr::ShapeHash(a) == gerr::ShapeHash(b),
+            "ShapeEqual implies equal ShapeHash");
+    }
+  }
+}
+
+void CheckExpected() {
+  auto const a1 = gerr::New("connect {} timeout", "a");
+  auto const a2 = gerr::New("connect {} timeout", "a");
+  auto const b = gerr::New("connect {} timeout", "b");
+  Check(a1 != a2 && gerr::DeepEqual(a1, a2), "same content, other node");
+  Check(gerr::ShapeEqual(a1, b) && !gerr::DeepEqual(a1, b),
+        "message differs only in depth");
+  Check(!gerr::ShapeEqual(ErrTimeout::E(), ErrOther::E()),
+        "same code and message, other type");
+  Check(!gerr::ShapeEqual(gerr::New("x"), gerr::New(1001, "x")),
+        "code differs");
+  Check(!gerr::ShapeEqual(ErrTimeout::E(), gerr::Wrap(ErrTimeout::E(), "w")),
+        "length differs");
+  Check(!gerr::ShapeEqual(nullptr, ErrTimeout::E()), "nullptr differs");
+  Check(gerr::DeepEqual(nullptr, nullptr), "nullptr equals nullptr");
+  Check(gerr::DeepEqual(ErrCallFailed::E(Key{1}), ErrCallFailed::E(Key{1})),
+        "context errors compare by message");
+  Check(!gerr::DeepEqual(ErrCallFailed::E(Key{1}), ErrCallFailed::E(Key{2})),
+        "context errors with other context differ");
+  Check(gerr::DeepEqual(gerr::New("x"), gerr::New(std::string{"x"})) &&
+            gerr::DeepEqual(gerr::New("x"), gerr::New("{}", "x")),
+        "static and formatted message with same text");
+  Check(gerr::DeepEqual(gerr::Wrap(ErrPlain::E(), 1001, "w"),
+                        gerr::Wrap(ErrPlain::E(), 1001, "{}", "w")),
+        "wrapped static and formatted message with same text");
+  Check(!gerr::ShapeEqual(gerr::New("plain error"), ErrPlain::E()),
+        "New and a defined type differ");
+
+  std::unordered_map<gerr::Error, int, gerr::DeepHasher, gerr::DeepEqualTo>
+      deep;
+  std::unordered_map<gerr::Error, int, gerr::ShapeHasher, gerr::ShapeEqualTo>
+      shape;
+  for (auto const& err : {a1, a2, b}) {
+    ++deep[err];
+    ++shape[err];
+  }
+  Check(deep.size() == 2 && deep[a1] == 2, "DeepHasher groups equal chains");
+  Check(shape.size() == 1 && shape[b] == 3, "ShapeHasher groups shapes");
+
+  auto const i1 = gerr::Intern(gerr::Wrap(ErrTimeout::E(), "query {}", 1));
+  auto const i2 = gerr::Intern(gerr::Wrap(ErrTimeout::E(), "query {}", 1));
+  Check(i1 == i2, "Intern shares DeepEqual chains");
+}
+
+void CheckThreads(std::vector<gerr::Error> const& errors) {
+  // 类型的哈希值按线程缓存，其他线程算出的结果必须相同
+  std::vector<std::size_t> deep, shape;
+  std::thread other{[&] {
+    for (auto const& err : errors) {
+      deep.push_back(gerr::DeepHash(err));
+      shape.push_back(gerr::ShapeHash(err));
+    }
+  }};
+  other.join();
+  for (std::size_t i = 0; i < errors.size(); ++i) {
+    Check(deep[i] == gerr::DeepHash(errors[i]) &&
+              shape[i] == gerr::ShapeHash(errors[i]),
+          "hash is the same on another thread");
+  }
+}
+
+}  // namespace
+
+int main() {
+  auto const errors = Corpus();
+  CheckPairs(errors);
+  CheckExpected();
+  CheckThreads(errors);
+
+  if (failures != 0) {
+    std::fprintf(stderr, "%d equality check(s) failed\n", failures);
+    return 1;
+  }
+  std::printf("all equality checks passed\n");
+  return 0;
+}
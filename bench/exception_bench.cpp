@@ -0,0 +1,124 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <benchmark/benchmark.h>
+
+#include <gerr/exception.hpp>
+#include <stdexcept>
+
+// 异常和 gerr::Error 之间相互转换的开销：抛出、捕获并转换为 gerr::Error 的
+// 完整往返，以及 gerr::Exception::what() 的延迟格式化。
+
+namespace {
+
+void BM_ThrowCatchBaseline(benchmark::State& state) {
+  for (auto _ : state) {
+    try {
+      throw std::runtime_error("boom");
+    } catch (std::exception const& e) {
+      benchmark::DoNotOptimize(e.what());
+    }
+  }
+}
+BENCHMARK(BM_ThrowCatchBaseline);
+
+void BM_StdExceptionFormatted(benchmark::State& state) {
+  for (auto _ : state) {
+    gerr::Error err;
+    try {
+      throw std::runtime_error("boom");
+    } catch (std::exception const& e) {
+      err = gerr::New("exception: {}", e.what());
+    }
+    benchmark::DoNotOptimize(err);
+  }
+}
+BENCHMARK(BM_StdExceptionFormatted);
+
+void BM_StdExceptionFromException(benchmark::State& state) {
+  for (auto _ : state) {
+    gerr::Error err;
+    try {
+      throw std::runtime_error("boom");
+    } catch (std::exception const& e) {
+      err = gerr::FromException(e);
+    }
+    benchmark::DoNotOptimize(err);
+  }
+}
+BENCHMARK(BM_StdExceptionFromException);
+
+void BM_StdExceptionFromCurrent(benchmark::State& state) {
+  for (auto _ : state) {
+    gerr::Error err;
+    try {
+      throw std::runtime_error("boom");
+    } catch (...) {
+      err = gerr::FromCurrentException();
+    }
+    benchmark::DoNotOptimize(err);
+  }
+}
+BENCHMARK(BM_StdExceptionFromCurrent);
+
+void BM_GErrExceptionRoundTrip(benchmark::State& state) {
+  auto const cause = gerr::New(1, "cause");
+  for (auto _ : state) {
+    gerr::Error err;
+    try {
+      throw gerr::Exception{cause};
+    } catch (std::exception const& e) {
+      err = gerr::FromException(e);
+    }
+    benchmark::DoNotOptimize(err);
+  }
+}
+BENCHMARK(BM_GErrExceptionRoundTrip);
+
+void BM_Invoke(benchmark::State& state) {
+  for (auto _ : state) {
+    auto res = gerr::Invoke([] { return std::stoi("abc"); });
+    benchmark::DoNotOptimize(res);
+  }
+}
+BENCHMARK(BM_Invoke);
+
+void BM_InvokeNoThrow(benchmark::State& state) {
+  for (auto _ : state) {
+    auto res = gerr::Invoke([] { return std::stoi("123"); });
+    benchmark::DoNotOptimize(res);
+  }
+}
+BENCHMARK(BM_InvokeNoThrow);
+
+void BM_ExceptionWhat(benchmark::State& state) {
+  auto const err = gerr::Wrap(gerr::New(1, "cause"), "outer");
+  for (auto _ : state) {
+    gerr::Exception e{err};
+    benchmark::DoNotOptimize(e.what());
+  }
+}
+BENCHMARK(BM_ExceptionWhat);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,34 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#pragma once
+
+// 可以按需失败的分配器，供 gerr_oom_bench 和 gerr_live_report 使用：
+// fail_alloc.cpp 替换了全局 operator new，当前线程处于失败状态时抛出
+// std::bad_alloc。和 alloc_count.cpp 一样放在单独的编译单元中，
+// 一个可执行文件只能链接两者之一。
+
+/** 设置当前线程的分配是否失败 */
+void SetFailAlloc(bool fail);
+
+/** 当前线程接下来的 n 次分配成功，之后的分配失败，直到调用 SetFailAlloc(false) */
+void FailAllocAfter(int n);
@@ -0,0 +1,108 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <benchmark/benchmark.h>
+
+#include <gerr/gerr.hpp>
+
+// 对比运行期格式化字符串、FMT_STRING 和 FMT_COMPILE 三种方式的格式化开销，
+// 前三组只测格式化本身，后面几组测完整的 gerr::New / gerr::Wrap。
+
+namespace {
+
+constexpr int kUin = 123456789;
+constexpr char const* kName = "some-client";
+
+void BM_FormatRuntime(benchmark::State& state) {
+  for (auto _ : state) {
+    auto s = gerr::details::FormatRuntime("fail to call: uin={}, client={}",
+                                          kUin, kName);
+    benchmark::DoNotOptimize(s);
+  }
+}
+BENCHMARK(BM_FormatRuntime);
+
+void BM_FormatString(benchmark::State& state) {
+  for (auto _ : state) {
+    auto s = fmt::format(FMT_STRING("fail to call: uin={}, client={}"), kUin,
+                         kName);
+    benchmark::DoNotOptimize(s);
+  }
+}
+BENCHMARK(BM_FormatString);
+
+void BM_FormatCompile(benchmark::State& state) {
+  for (auto _ : state) {
+    auto s = fmt::format(FMT_COMPILE("fail to call: uin={}, client={}"), kUin,
+                         kName);
+    benchmark::DoNotOptimize(s);
+  }
+}
+BENCHMARK(BM_FormatCompile);
+
+void BM_NewRuntime(benchmark::State& state) {
+  for (auto _ : state) {
+    auto err = gerr::New(1, "fail to call: uin={}, client={}", kUin, kName);
+    benchmark::DoNotOptimize(err);
+  }
+}
+BENCHMARK(BM_NewRuntime);
+
+void BM_NewFmtString(benchmark::State& state) {
+  for (auto _ : state) {
+    auto err = gerr::New(1, FMT_STRING("fail to call: uin={}, client={}"),
+                         kUin, kName);
+    benchmark::DoNotOptimize(err);
+  }
+}
+BENCHMARK(BM_NewFmtString);
+
+void BM_NewFmtCompile(benchmark::State& state) {
+  for (auto _ : state) {
+    auto err = gerr::New(1, FMT_COMPILE("fail to call: uin={}, client={}"),
+                         kUin, kName);
+    benchmark::DoNotOptimize(err);
+  }
+}
+BENCHMARK(BM_NewFmtCompile);
+
+void BM_WrapRuntime(benchmark::State& state) {
+  auto const cause = gerr::New("cause");
+  for (auto _ : state) {
+    auto err = gerr::Wrap(cause, 2, "retry {} of {}", 3, 5);
+    benchmark::DoNotOptimize(err);
+  }
+}
+BENCHMARK(BM_WrapRuntime);
+
+void BM_WrapFmtCompile(benchmark::State& state) {
+  auto const cause = gerr::New("cause");
+  for (auto _ : state) {
+    auto err = gerr::Wrap(cause, 2, FMT_COMPILE("retry {} of {}"), 3, 5);
+    benchmark::DoNotOptimize(err);
+  }
+}
+BENCHMARK(BM_WrapFmtCompile);
+
+}  // namespace
+
+BENCHMARK_MAIN();
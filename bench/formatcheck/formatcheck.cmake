@@ -0,0 +1,77 @@
+# 检查格式化字符串的占位符和参数个数不一致时无法通过编译：
+# 分别以 C++11 / 14 / 17 只做语法检查，匹配的用法必须通过编译，
+# 不匹配的用法必须因为 gerr 的 static_assert 而失败，结果不符时报错。
+#
+# 用法（通常通过 gerr_format_check 目标调用）：
+#   cmake -DCXX=<compiler> -DINCLUDES="a;b" -DWORK_DIR=<dir> -P formatcheck.cmake
+
+set(include_flags)
+foreach(dir IN LISTS INCLUDES)
+  list(APPEND include_flags "-I${dir}")
+endforeach()
+
+set(expected_message "the number of format arguments does not match")
+set(failures 0)
+
+# 编译 body 所在的翻译单元，expect 为 pass、fail 或者 fail14（C++14 及以上才失败）
+function(check name std expect body)
+  set(source "${WORK_DIR}/${name}.cpp")
+  file(WRITE "${source}"
+       "#include <gerr/gerr.hpp>\n\nstruct Ctx { int a; int b; };\n\n${body}\n")
+  execute_process(
+    COMMAND ${CXX} -std=${std} -fsyntax-only ${include_flags} ${source}
+    RESULT_VARIABLE result
+    OUTPUT_VARIABLE out
+    ERROR_VARIABLE out)
+  if(expect STREQUAL "fail14")
+    if(std STREQUAL "c++11")
+      set(expect pass)
+    else()
+      set(expect fail)
+    endif()
+  endif()
+  if(expect STREQUAL "pass" AND NOT result EQUAL 0)
+    message(SEND_ERROR "${name} (${std}) should compile:\n${out}")
+    math(EXPR failures "${failures} + 1")
+  elseif(expect STREQUAL "fail" AND result EQUAL 0)
+    message(SEND_ERROR "${name} (${std}) should not compile")
+    math(EXPR failures "${failures} + 1")
+  elseif(expect STREQUAL "fail" AND NOT out MATCHES "${expected_message}")
+    message(SEND_ERROR "${name} (${std}) failed for another reason:\n${out}")
+    math(EXPR failures "${failures} + 1")
+  else()
+    message(STATUS "${name} (${std}): ${expect} as expected")
+  endif()
+  set(failures ${failures} PARENT_SCOPE)
+endfunction()
+
+file(MAKE_DIRECTORY "${WORK_DIR}")
+foreach(std c++11 c++14 c++17)
+  check(match ${std} pass [=[
+DEFINE_CONTEXT_ERROR(ErrPair, Ctx, "{{pair}} {} {:>{}}", context.a, context.b,
+                     4);
+gerr::Error Use(gerr::Error c) {
+  gerr::New(GERR_FMT("x {} {}"), 1, 2);
+  gerr::New(1, GERR_FMT("x {}"), 1);
+  gerr::Wrap(c, GERR_FMT("y {}"), "s");
+  gerr::Wrap(c, 2, FMT_STRING("z {}"), 3);
+  gerr::New(GERR_FMT("{0} {0}"), 1);
+  return ErrPair::E({1, 2});
+}]=])
+  check(new_extra ${std} fail [=[
+gerr::Error Use() { return gerr::New(GERR_FMT("conv exception:{}"), "a", "b"); }]=])
+  check(new_missing ${std} fail [=[
+gerr::Error Use() { return gerr::New(1, GERR_FMT("{} {}"), 1); }]=])
+  check(wrap_extra ${std} fail [=[
+gerr::Error Use(gerr::Error c) { return gerr::Wrap(c, GERR_FMT("{}"), 1, 2); }]=])
+  check(define_extra ${std} fail [=[
+DEFINE_CONTEXT_ERROR(ErrBad, Ctx, "a={}", context.a, context.b);]=])
+  check(define_missing ${std} fail [=[
+DEFINE_CODE_MEMO_CONTEXT_ERROR(ErrBad, 1, int, "{} {}", context);]=])
+  check(fmt_string_extra ${std} fail14 [=[
+gerr::Error Use() { return gerr::New(FMT_STRING("conv exception:{}"), "a", "b"); }]=])
+endforeach()
+
+if(failures GREATER 0)
+  message(FATAL_ERROR "${failures} format check(s) failed")
+endif()
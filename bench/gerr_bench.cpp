@@ -0,0 +1,634 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <limits>
+#include <gerr/batch.hpp>
+#include <gerr/breaker.hpp>
+#include <gerr/gerr.hpp>
+#include <gerr/inject.hpp>
+#include <gerr/rate.hpp>
+#include <gerr/result.hpp>
+#include <gerr/retry.hpp>
+#include <gerr/validate.hpp>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "alloc_count.hpp"
+
+// gerr 所有公开操作的基准：
+//   - New / Wrap 的每个重载，DEFINE_* 生成类型的每个 E()；
+//   - Is / As / IsCode / Code / String / operator<< 和析构，错误链条深度分别为
+//     1、4、16、64；
+//   - ShapeHash / DeepHash / DeepEqual，链条深度同上；
+//   - GERR_INJECT 注入点在关闭、未命中和命中时的开销；
+//   - RetryPolicy::Classify 和逐条规则调用 IsCode / Is 的对比；
+//   - CircuitBreaker 关闭状态下的 Allow 和 Record；
+//   - RateTracker 的 Record 和 60 秒窗口的 Snapshot；
+//   - 逐行失败的一批数据，ErrorBatch 和 std::vector<gerr::Result<T>> 的对比；
+//   - Validator 校验 16 个字段，以及逐个 gerr::New 再拼接的对比；
+// 每个用例都以单线程和 N 个线程各跑一次。全局 operator new 被替换为
+// 计数版本，allocs 计数即每次操作的平均分配次数。
+
+namespace {
+
+struct CallContext {
+  int uin;
+  char const* client;
+};
+
+constexpr int kCode = 1001;
+constexpr int kBottomCode = 2001;
+constexpr int kUin = 123456789;
+constexpr int kShard = 7;
+constexpr char const* kName = "some-client";
+
+DEFINE_ERROR(ErrPlain, "plain error");
+DEFINE_CODE_ERROR(ErrTimeout, kCode, "call timeout");
+DEFINE_CONTEXT_ERROR(ErrContext, CallContext, "fail to call: uin={}, client={}",
+                     context.uin, context.client);
+DEFINE_CODE_CONTEXT_ERROR(ErrCallFailed, kCode, CallContext,
+                          "fail to call: uin={}, client={}", context.uin,
+                          context.client);
+DEFINE_CODE_MEMO_CONTEXT_ERROR(ErrShardDown, kCode, int, "shard {} is down",
+                               context);
+DEFINE_CODE_ERROR(ErrBottom, kBottomCode, "bottom error");
+DEFINE_ERROR(ErrNeverRaised, "never raised");
+
+/** 用例结束时输出 allocs 计数，多线程时各线程的计数会被累加后再平均 */
+class AllocCounter {
+ public:
+  explicit AllocCounter(benchmark::State& state)
+      : state_(state), before_{AllocCount()} {}
+  ~AllocCounter() {
+    state_.counters["allocs"] =
+        benchmark::Counter(static_cast<double>(AllocCount() - before_),
+                           benchmark::Counter::kAvgIterations);
+  }
+
+ private:
+  benchmark::State& state_;
+  std::size_t before_;
+};
+
+/** 构造深度为 depth 的错误链条，最底层是 ErrBottom，上面每层都是不带错误码的 Wrap */
+gerr::Error MakeChain(int depth) {
+  auto err = ErrBottom::E(nullptr);
+  for (int i = 1; i < depth; ++i) {
+    err = gerr::Wrap(err, "layer {}", i);
+  }
+  return err;
+}
+
+void ChainDepths(benchmark::internal::Benchmark* b) {
+  for (auto depth : {1, 4, 16, 64}) {
+    b->Arg(depth);
+  }
+}
+
+/** 单线程，以及 N 个线程（N 为 CPU 数，至少为 2，保证总会跑到并发路径） */
+void ThreadCounts(benchmark::internal::Benchmark* b) {
+  auto const n = std::max(2u, std::thread::hardware_concurrency());
+  b->Threads(1)->Threads(static_cast<int>(n));
+}
+
+#define GERR_BENCH(fn) BENCHMARK(fn)->Apply(ThreadCounts)
+#define GERR_BENCH_CAPTURE(fn, name, ...) \
+  BENCHMARK_CAPTURE(fn, name, __VA_ARGS__)->Apply(ThreadCounts)
+#define GERR_BENCH_CHAIN(fn) GERR_BENCH(fn)->Apply(ChainDepths)
+
+// ---------------------------------------------------------------------------
+// 创建
+// ---------------------------------------------------------------------------
+
+template <class Fn>
+void BM_Create(benchmark::State& state, Fn fn) {
+  AllocCounter counter{state};
+  for (auto _ : state) {
+    auto err = fn();
+    benchmark::DoNotOptimize(err);
+  }
+}
+
+GERR_BENCH_CAPTURE(BM_Create, New/Message, [] { return gerr::New("fail"); });
+GERR_BENCH_CAPTURE(BM_Create, New/CodeMessage,
+                   [] { return gerr::New(kCode, "fail"); });
+GERR_BENCH_CAPTURE(BM_Create, New/Format, [] {
+  return gerr::New("fail: uin={}, client={}", kUin, kName);
+});
+GERR_BENCH_CAPTURE(BM_Create, New/StringFormat, [] {
+  static std::string const formatStr = "fail: uin={}, client={}";
+  return gerr::New(formatStr, kUin, kName);
+});
+GERR_BENCH_CAPTURE(BM_Create, New/FmtString, [] {
+  return gerr::New(FMT_STRING("fail: uin={}, client={}"), kUin, kName);
+});
+GERR_BENCH_CAPTURE(BM_Create, New/CodeFormat, [] {
+  return gerr::New(kCode, "fail: uin={}, client={}", kUin, kName);
+});
+GERR_BENCH_CAPTURE(BM_Create, New/CodeStringFormat, [] {
+  static std::string const formatStr = "fail: uin={}, client={}";
+  return gerr::New(kCode, formatStr, kUin, kName);
+});
+GERR_BENCH_CAPTURE(BM_Create, New/CodeFmtString, [] {
+  return gerr::New(kCode, FMT_STRING("fail: uin={}, client={}"), kUin, kName);
+});
+
+GERR_BENCH_CAPTURE(BM_Create, Define/Static, [] { return ErrPlain::E(); });
+GERR_BENCH_CAPTURE(BM_Create, Define/Cause,
+                   [] { return ErrPlain::E(ErrBottom::E()); });
+GERR_BENCH_CAPTURE(BM_Create, DefineCode/Static,
+                   [] { return ErrTimeout::E(); });
+GERR_BENCH_CAPTURE(BM_Create, DefineCode/Cause,
+                   [] { return ErrTimeout::E(ErrBottom::E()); });
+GERR_BENCH_CAPTURE(BM_Create, DefineContext/Context,
+                   [] { return ErrContext::E({kUin, kName}); });
+GERR_BENCH_CAPTURE(BM_Create, DefineContext/Cause, [] {
+  return ErrContext::E(ErrBottom::E(), {kUin, kName});
+});
+GERR_BENCH_CAPTURE(BM_Create, DefineCodeContext/Context,
+                   [] { return ErrCallFailed::E({kUin, kName}); });
+GERR_BENCH_CAPTURE(BM_Create, DefineCodeContext/Cause, [] {
+  return ErrCallFailed::E(ErrBottom::E(), {kUin, kName});
+});
+GERR_BENCH_CAPTURE(BM_Create, DefineMemoContext/Context,
+                   [] { return ErrShardDown::E(kShard); });
+
+// ---------------------------------------------------------------------------
+// 包装，被包装的错误在计时之外创建，每次迭代只计入包装本身和一次引用计数
+// ---------------------------------------------------------------------------
+
+template <class Fn>
+void BM_Wrap(benchmark::State& state, Fn fn) {
+  auto const cause = ErrBottom::E(nullptr);
+  AllocCounter counter{state};
+  for (auto _ : state) {
+    auto err = fn(cause);
+    benchmark::DoNotOptimize(err);
+  }
+}
+
+GERR_BENCH_CAPTURE(BM_Wrap, Message,
+                   [](gerr::Error const& e) { return gerr::Wrap(e, "fail"); });
+GERR_BENCH_CAPTURE(BM_Wrap, Format, [](gerr::Error const& e) {
+  return gerr::Wrap(e, "fail: uin={}, client={}", kUin, kName);
+});
+GERR_BENCH_CAPTURE(BM_Wrap, StringFormat, [](gerr::Error const& e) {
+  static std::string const formatStr = "fail: uin={}, client={}";
+  return gerr::Wrap(e, formatStr, kUin, kName);
+});
+GERR_BENCH_CAPTURE(BM_Wrap, FmtString, [](gerr::Error const& e) {
+  return gerr::Wrap(e, FMT_STRING("fail: uin={}, client={}"), kUin, kName);
+});
+GERR_BENCH_CAPTURE(BM_Wrap, Code,
+                   [](gerr::Error const& e) { return gerr::Wrap(e, kCode); });
+GERR_BENCH_CAPTURE(BM_Wrap, CodeMessage, [](gerr::Error const& e) {
+  return gerr::Wrap(e, kCode, "fail");
+});
+GERR_BENCH_CAPTURE(BM_Wrap, CodeFormat, [](gerr::Error const& e) {
+  return gerr::Wrap(e, kCode, "fail: uin={}, client={}", kUin, kName);
+});
+GERR_BENCH_CAPTURE(BM_Wrap, CodeStringFormat, [](gerr::Error const& e) {
+  static std::string const formatStr = "fail: uin={}, client={}";
+  return gerr::Wrap(e, kCode, formatStr, kUin, kName);
+});
+GERR_BENCH_CAPTURE(BM_Wrap, CodeFmtString, [](gerr::Error const& e) {
+  return gerr::Wrap(e, kCode, FMT_STRING("fail: uin={}, client={}"), kUin,
+                    kName);
+});
+
+// ---------------------------------------------------------------------------
+// 查询，Hit 用例要找的错误在链条最底层，Miss 用例需要遍历整条链条
+// ---------------------------------------------------------------------------
+
+template <class Fn>
+void BM_Query(benchmark::State& state, Fn fn) {
+  auto const err = MakeChain(static_cast<int>(state.range(0)));
+  AllocCounter counter{state};
+  for (auto _ : state) {
+    auto result = fn(err);
+    benchmark::DoNotOptimize(result);
+  }
+}
+
+void BM_IsHit(benchmark::State& state) {
+  BM_Query(state, [](gerr::Error const& e) { return gerr::Is<ErrBottom>(e); });
+}
+GERR_BENCH_CHAIN(BM_IsHit);
+
+void BM_IsMiss(benchmark::State& state) {
+  BM_Query(state,
+           [](gerr::Error const& e) { return gerr::Is<ErrNeverRaised>(e); });
+}
+GERR_BENCH_CHAIN(BM_IsMiss);
+
+void BM_As(benchmark::State& state) {
+  BM_Query(state, [](gerr::Error const& e) { return gerr::As<ErrBottom>(e); });
+}
+GERR_BENCH_CHAIN(BM_As);
+
+void BM_IsCodeHit(benchmark::State& state) {
+  BM_Query(state,
+           [](gerr::Error const& e) { return gerr::IsCode(kBottomCode, e); });
+}
+GERR_BENCH_CHAIN(BM_IsCodeHit);
+
+void BM_IsCodeMiss(benchmark::State& state) {
+  BM_Query(state, [](gerr::Error const& e) { return gerr::IsCode(kCode, e); });
+}
+GERR_BENCH_CHAIN(BM_IsCodeMiss);
+
+void BM_Code(benchmark::State& state) {
+  BM_Query(state, [](gerr::Error const& e) { return gerr::Code(e); });
+}
+GERR_BENCH_CHAIN(BM_Code);
+
+// ---------------------------------------------------------------------------
+// 结构比较和哈希，Equal 用例比较两条分别构造、内容相同的链条，需要走完整条链条
+// ---------------------------------------------------------------------------
+
+void BM_ShapeHash(benchmark::State& state) {
+  BM_Query(state, [](gerr::Error const& e) { return gerr::ShapeHash(e); });
+}
+GERR_BENCH_CHAIN(BM_ShapeHash);
+
+void BM_DeepHash(benchmark::State& state) {
+  BM_Query(state, [](gerr::Error const& e) { return gerr::DeepHash(e); });
+}
+GERR_BENCH_CHAIN(BM_DeepHash);
+
+void BM_DeepEqual(benchmark::State& state) {
+  auto const other = MakeChain(static_cast<int>(state.range(0)));
+  BM_Query(state,
+           [&](gerr::Error const& e) { return gerr::DeepEqual(e, other); });
+}
+GERR_BENCH_CHAIN(BM_DeepEqual);
+
+// ---------------------------------------------------------------------------
+// 格式化
+// ---------------------------------------------------------------------------
+
+void BM_String(benchmark::State& state) {
+  BM_Query(state, [](gerr::Error const& e) { return gerr::String(e); });
+}
+GERR_BENCH_CHAIN(BM_String);
+
+void BM_StreamOutput(benchmark::State& state) {
+  auto const err = MakeChain(static_cast<int>(state.range(0)));
+  std::ostringstream os;
+  AllocCounter counter{state};
+  for (auto _ : state) {
+    os.str(std::string{});
+    os << *err;
+    benchmark::DoNotOptimize(os);
+  }
+}
+GERR_BENCH_CHAIN(BM_StreamOutput);
+
+// ---------------------------------------------------------------------------
+// 析构，链条在计时之外按批构造，计时部分只包含释放最后一个引用
+// ---------------------------------------------------------------------------
+
+void BM_Destroy(benchmark::State& state) {
+  constexpr std::size_t kBatch = 256;
+  auto const depth = static_cast<int>(state.range(0));
+  std::vector<gerr::Error> errs;
+  errs.reserve(kBatch);
+  std::size_t allocs = 0;
+  while (state.KeepRunningBatch(kBatch)) {
+    state.PauseTiming();
+    for (std::size_t i = 0; i < kBatch; ++i) {
+      errs.push_back(MakeChain(depth));
+    }
+    auto const before = AllocCount();
+    state.ResumeTiming();
+    errs.clear();
+    allocs += AllocCount() - before;
+  }
+  state.counters["allocs"] = benchmark::Counter(
+      static_cast<double>(allocs), benchmark::Counter::kAvgIterations);
+}
+GERR_BENCH_CHAIN(BM_Destroy);
+
+// ---------------------------------------------------------------------------
+// 故障注入，Baseline 是不带注入点的同一个函数，
+// 关闭注入时 Disabled 和 Baseline 的差距应当只有一次原子读和分支
+// ---------------------------------------------------------------------------
+
+GERR_NOINLINE gerr::Error CallWithoutInject(int i) {
+  if (i < 0) {
+    return ErrTimeout::E();
+  }
+  return nullptr;
+}
+
+GERR_NOINLINE gerr::Error CallWithInject(int i) {
+  GERR_INJECT("bench.call", ErrTimeout);
+  if (i < 0) {
+    return ErrTimeout::E();
+  }
+  return nullptr;
+}
+
+template <class Fn>
+void BM_Inject(benchmark::State& state, char const* config, Fn fn) {
+  if (state.thread_index() == 0) {
+    gerr::SetInjectConfig(config);
+  }
+  std::int64_t fired = 0;
+  int i = 0;
+  for (auto _ : state) {
+    auto err = fn(i++ & 0xff);
+    fired += err != nullptr;
+    benchmark::DoNotOptimize(err);
+  }
+  state.counters["fired"] =
+      benchmark::Counter(static_cast<double>(fired),
+                         benchmark::Counter::kAvgIterations);
+  if (state.thread_index() == 0) {
+    gerr::DisableInject();
+  }
+}
+
+GERR_BENCH_CAPTURE(BM_Inject, Baseline, "", CallWithoutInject);
+GERR_BENCH_CAPTURE(BM_Inject, Disabled, "", CallWithInject);
+GERR_BENCH_CAPTURE(BM_Inject, OtherSite, "other.site 1", CallWithInject);
+GERR_BENCH_CAPTURE(BM_Inject, Every100, "bench.call:ErrTimeout every 100",
+                   CallWithInject);
+GERR_BENCH_CAPTURE(BM_Inject, Rate1Percent, "bench.* 0.01", CallWithInject);
+
+// ---------------------------------------------------------------------------
+// 重试分类，Naive 是手写的逐条规则判断，每条规则遍历一次错误链条；
+// 错误链条的最底层是 ErrBottom，不命中任何规则，需要遍历整条链条
+// ---------------------------------------------------------------------------
+
+gerr::RetryPolicy const& BenchRetryPolicy() {
+  static auto const policy = gerr::RetryPolicy{}
+                                 .RetryOnCode(kCode)
+                                 .RetryOnCodes(5000, 5999)
+                                 .StopOnCodes(5100, 5199)
+                                 .RetryOnCodes(6000, 6099)
+                                 .RetryOn<ErrPlain>()
+                                 .StopOn<ErrNeverRaised>()
+                                 .RetryOnDomain("generic");
+  return policy;
+}
+
+bool NaiveRetryable(gerr::Error const& err) {
+  for (auto code = 5100; code <= 5199; ++code) {
+    if (gerr::IsCode(code, err)) {
+      return false;
+    }
+  }
+  if (gerr::Is<ErrNeverRaised>(err)) {
+    return false;
+  }
+  if (gerr::IsCode(kCode, err) || gerr::Is<ErrPlain>(err)) {
+    return true;
+  }
+  for (auto code = 5000; code <= 5999; ++code) {
+    if (gerr::IsCode(code, err)) {
+      return true;
+    }
+  }
+  for (auto code = 6000; code <= 6099; ++code) {
+    if (gerr::IsCode(code, err)) {
+      return true;
+    }
+  }
+  return gerr::ToErrorCode(err).category() == std::generic_category();
+}
+
+void BM_RetryClassify(benchmark::State& state) {
+  auto const err = MakeChain(static_cast<int>(state.range(0)));
+  auto const& policy = BenchRetryPolicy();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(policy.Retryable(err));
+  }
+}
+GERR_BENCH_CHAIN(BM_RetryClassify);
+
+void BM_RetryClassifyNaive(benchmark::State& state) {
+  auto const err = MakeChain(static_cast<int>(state.range(0)));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(NaiveRetryable(err));
+  }
+}
+GERR_BENCH_CHAIN(BM_RetryClassifyNaive);
+
+// ---------------------------------------------------------------------------
+// 熔断器，所有线程共享同一个熔断器，失败比例阈值设为 1 保证一直处于关闭状态
+// ---------------------------------------------------------------------------
+
+gerr::CircuitBreaker& BenchBreaker() {
+  static gerr::CircuitBreaker breaker{
+      gerr::CircuitKey::kCode,
+      [] {
+        gerr::CircuitBreaker::Options options;
+        options.failureRatio = 1.0;
+        options.minCalls = std::numeric_limits<std::uint64_t>::max();
+        return options;
+      }()};
+  return breaker;
+}
+
+void BM_CircuitAllow(benchmark::State& state) {
+  auto& breaker = BenchBreaker();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(breaker.Allow());
+  }
+}
+GERR_BENCH(BM_CircuitAllow);
+
+void BM_CircuitRecord(benchmark::State& state, gerr::Error err) {
+  auto& breaker = BenchBreaker();
+  for (auto _ : state) {
+    breaker.Record(err);
+  }
+}
+GERR_BENCH_CAPTURE(BM_CircuitRecord, Success, nullptr);
+GERR_BENCH_CAPTURE(BM_CircuitRecord, Failure, ErrTimeout::E());
+
+// ---------------------------------------------------------------------------
+// 错误率统计，所有线程共享同一个 RateTracker，各自写入自己的计数器
+// ---------------------------------------------------------------------------
+
+gerr::RateTracker& BenchRateTracker() {
+  static gerr::RateTracker tracker;
+  return tracker;
+}
+
+void BM_RateRecord(benchmark::State& state, gerr::Error err) {
+  auto& tracker = BenchRateTracker();
+  for (auto _ : state) {
+    tracker.Record(err);
+  }
+}
+GERR_BENCH_CAPTURE(BM_RateRecord, Success, nullptr);
+GERR_BENCH_CAPTURE(BM_RateRecord, Failure, ErrTimeout::E());
+
+void BM_RateSnapshot(benchmark::State& state) {
+  auto& tracker = BenchRateTracker();
+  tracker.Record(ErrTimeout::E());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(tracker.Snapshot(60));
+  }
+}
+BENCHMARK(BM_RateSnapshot);
+
+// ---------------------------------------------------------------------------
+// 逐行失败的一批数据，每批 kBatchRows 行，每 kBatchFailEvery 行失败一行。
+// Build 计时包括逐行填充、统计失败行数、转换为整批的结果和释放，
+// 逐行处理本身的开销两者相同；bytes_per_row 是每行占用的内存。
+// Count 只统计失败行数，数据在计时之外构造。
+// ---------------------------------------------------------------------------
+
+constexpr std::size_t kBatchRows = 1 << 20;
+constexpr std::size_t kBatchFailEvery = 10000;
+
+gerr::ErrorBatch MakeErrorBatch(std::vector<int>* values) {
+  values->assign(kBatchRows, 0);
+  gerr::ErrorBatch errors{kBatchRows};
+  for (std::size_t i = 0, next = 1; i < kBatchRows; ++i, ++next) {
+    if (next == kBatchFailEvery) {
+      next = 0;
+      errors.FailCode(i, kCode);
+    } else {
+      (*values)[i] = static_cast<int>(i);
+    }
+  }
+  return errors;
+}
+
+std::vector<gerr::Result<int>> MakeResultVector() {
+  std::vector<gerr::Result<int>> results;
+  results.reserve(kBatchRows);
+  for (std::size_t i = 0, next = 1; i < kBatchRows; ++i, ++next) {
+    if (next == kBatchFailEvery) {
+      next = 0;
+      results.emplace_back(ErrTimeout::E());
+    } else {
+      results.emplace_back(static_cast<int>(i));
+    }
+  }
+  return results;
+}
+
+std::size_t CountFailed(std::vector<gerr::Result<int>> const& results) {
+  return static_cast<std::size_t>(
+      std::count_if(results.begin(), results.end(),
+                    [](gerr::Result<int> const& r) { return r.IsFailure(); }));
+}
+
+void BM_BatchBuild_ErrorBatch(benchmark::State& state) {
+  AllocCounter counter{state};
+  for (auto _ : state) {
+    std::vector<int> values;
+    auto const errors = MakeErrorBatch(&values);
+    benchmark::DoNotOptimize(errors.CountFailed());
+    auto result = errors.ToResult(std::move(values));
+    benchmark::DoNotOptimize(result);
+  }
+  state.counters["bytes_per_row"] = sizeof(int) + sizeof(std::int32_t) + 0.125;
+}
+BENCHMARK(BM_BatchBuild_ErrorBatch)->Unit(benchmark::kMillisecond);
+
+void BM_BatchBuild_ResultVector(benchmark::State& state) {
+  AllocCounter counter{state};
+  for (auto _ : state) {
+    auto const results = MakeResultVector();
+    benchmark::DoNotOptimize(CountFailed(results));
+  }
+  state.counters["bytes_per_row"] = sizeof(gerr::Result<int>);
+}
+BENCHMARK(BM_BatchBuild_ResultVector)->Unit(benchmark::kMillisecond);
+
+void BM_BatchCount_ErrorBatch(benchmark::State& state) {
+  std::vector<int> values;
+  auto const errors = MakeErrorBatch(&values);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(errors.CountFailed());
+  }
+}
+BENCHMARK(BM_BatchCount_ErrorBatch)->Unit(benchmark::kMicrosecond);
+
+void BM_BatchCount_ResultVector(benchmark::State& state) {
+  auto const results = MakeResultVector();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(CountFailed(results));
+  }
+}
+BENCHMARK(BM_BatchCount_ResultVector)->Unit(benchmark::kMicrosecond);
+
+// ---------------------------------------------------------------------------
+// 字段校验，每次校验 kValidateFields 个字段，其中前 failed 个失败。
+// Naive 为每个失败的字段调用一次 gerr::New，最后拼接成一个错误
+// ---------------------------------------------------------------------------
+
+constexpr int kValidateFields = 16;
+
+void BM_Validate(benchmark::State& state, int failed) {
+  AllocCounter counter{state};
+  for (auto _ : state) {
+    gerr::Validator v;
+    for (int i = 0; i < kValidateFields; ++i) {
+      v.Check(i >= failed, "items.name", kCode, "must be positive, got {}", -i);
+    }
+    auto err = v.Finish("invalid request");
+    benchmark::DoNotOptimize(err);
+  }
+}
+GERR_BENCH_CAPTURE(BM_Validate, Pass, 0);
+GERR_BENCH_CAPTURE(BM_Validate, Fail3, 3);
+
+void BM_ValidateNaive(benchmark::State& state, int failed) {
+  AllocCounter counter{state};
+  for (auto _ : state) {
+    std::vector<gerr::Error> errors;
+    for (int i = 0; i < kValidateFields; ++i) {
+      if (i < failed) {
+        errors.push_back(gerr::New(kCode, "items.name: must be positive, got {}",
+                                   -i));
+      }
+    }
+    gerr::Error err;
+    if (!errors.empty()) {
+      std::string joined;
+      for (auto const& e : errors) {
+        joined += gerr::String(e);
+        joined += "; ";
+      }
+      err = gerr::New(kCode, "invalid request: {}", joined);
+    }
+    benchmark::DoNotOptimize(err);
+  }
+}
+GERR_BENCH_CAPTURE(BM_ValidateNaive, Pass, 0);
+GERR_BENCH_CAPTURE(BM_ValidateNaive, Fail3, 3);
+
+}  // namespace
+
+BENCHMARK_MAIN();
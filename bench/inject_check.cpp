@@ -0,0 +1,174 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cstdio>
+#include <cstdlib>
+#include <gerr/gerr.hpp>
+#include <gerr/inject.hpp>
+
+// GERR_INJECT 的行为检查：规则解析、每 N 次注入、按概率注入、按站点和错误类型匹配，
+// 以及运行时重新加载配置，结果不符时以非 0 值退出
+
+namespace {
+
+DEFINE_CODE_ERROR(ErrTimeout, 1001, "call timeout");
+DEFINE_CODE_ERROR(ErrRefused, 1002, "connection refused");
+
+int failures = 0;
+
+void Check(bool ok, char const* what) {
+  if (!ok) {
+    std::fprintf(stderr, "FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+gerr::Error Query() {
+  GERR_INJECT("db.query", ErrTimeout);
+  return nullptr;
+}
+
+gerr::Error Connect() {
+  GERR_INJECT("db.connect", ErrRefused);
+  return nullptr;
+}
+
+gerr::Error CacheGet() {
+  GERR_INJECT("cache.get", ErrTimeout);
+  return nullptr;
+}
+
+/** 调用 fn n 次，返回注入的次数，并检查注入的错误类型 */
+template <class ErrType>
+int Fires(gerr::Error (*fn)(), int n) {
+  auto fired = 0;
+  for (auto i = 0; i < n; ++i) {
+    auto const err = fn();
+    if (err != nullptr) {
+      Check(gerr::Is<ErrType>(err), "injected error has the point's type");
+      ++fired;
+    }
+  }
+  return fired;
+}
+
+void CheckParse() {
+  Check(gerr::SetInjectConfig("db.query 1.5") != nullptr,
+        "rate above 1 is rejected");
+  Check(gerr::SetInjectConfig("db.query -0.1") != nullptr,
+        "negative rate is rejected");
+  Check(gerr::SetInjectConfig("db.query 0.5x") != nullptr,
+        "trailing garbage in rate is rejected");
+  Check(gerr::SetInjectConfig("db.query every 0") != nullptr,
+        "'every 0' is rejected");
+  Check(gerr::SetInjectConfig("db.query every") != nullptr,
+        "'every' without count is rejected");
+  Check(gerr::SetInjectConfig("db.query") != nullptr,
+        "rule without rate is rejected");
+  Check(gerr::SetInjectConfig("db.query 0.5 extra") != nullptr,
+        "extra token is rejected");
+  Check(gerr::SetInjectConfig("# comment\n\n  ;db.query every 2; "
+                              "db.connect:ErrRefused 1\n") == nullptr,
+        "comments, blank lines and separators are accepted");
+  Check(gerr::SetInjectConfig("db.query every 1\nbad line here") != nullptr,
+        "one bad line rejects the whole config");
+  // 解析失败时保持原有配置
+  Check(Fires<ErrTimeout>(Query, 10) == 5, "failed parse keeps old config");
+  gerr::DisableInject();
+}
+
+void CheckEvery() {
+  Check(gerr::SetInjectConfig("db.query every 3") == nullptr, "every 3");
+  // 第 3、6、9 次调用注入
+  for (auto i = 1; i <= 9; ++i) {
+    Check((Query() != nullptr) == (i % 3 == 0), "every 3 fires on 3rd call");
+  }
+  Check(Fires<ErrRefused>(Connect, 10) == 0, "unmatched site never fires");
+  gerr::DisableInject();
+}
+
+void CheckRate() {
+  Check(gerr::SetInjectConfig("db.query 0; db.connect 1") == nullptr,
+        "rate 0 and 1");
+  Check(Fires<ErrTimeout>(Query, 1000) == 0, "rate 0 never fires");
+  Check(Fires<ErrRefused>(Connect, 1000) == 1000, "rate 1 always fires");
+  Check(gerr::SetInjectConfig("db.query 0.5") == nullptr, "rate 0.5");
+  auto const fired = Fires<ErrTimeout>(Query, 10000);
+  Check(fired > 4000 && fired < 6000, "rate 0.5 fires about half the time");
+  gerr::DisableInject();
+}
+
+void CheckMatch() {
+  Check(gerr::SetInjectConfig("db.*:ErrTimeout every 1") == nullptr,
+        "prefix with type");
+  Check(Fires<ErrTimeout>(Query, 10) == 10, "prefix matches db.query");
+  Check(Fires<ErrRefused>(Connect, 10) == 0, "type filter skips ErrRefused");
+  Check(Fires<ErrTimeout>(CacheGet, 10) == 0, "prefix skips cache.get");
+  // 每个注入点使用第一条匹配的规则
+  Check(gerr::SetInjectConfig("cache.get every 2; * every 1") == nullptr,
+        "wildcard");
+  Check(Fires<ErrTimeout>(CacheGet, 10) == 5, "first matching rule wins");
+  Check(Fires<ErrTimeout>(Query, 10) == 10, "'*' matches every site");
+  gerr::DisableInject();
+}
+
+void CheckReload() {
+  Check(gerr::SetInjectConfig("db.query every 4") == nullptr, "every 4");
+  Check(Query() == nullptr && Query() == nullptr, "two calls under every 4");
+  // 重新加载后注入点重新匹配规则并从头计数
+  Check(gerr::SetInjectConfig("db.query every 2") == nullptr, "reload");
+  Check(Query() == nullptr, "1st call after reload");
+  Check(Query() != nullptr, "2nd call after reload fires");
+  Check(gerr::SetInjectConfig("# nothing") == nullptr, "empty config");
+  Check(Fires<ErrTimeout>(Query, 10) == 0, "empty config disables inject");
+
+  ::setenv("GERR_INJECT_CHECK", "db.connect every 1", 1);
+  Check(gerr::LoadInjectConfigFromEnv("GERR_INJECT_CHECK") == nullptr,
+        "load from env");
+  Check(Fires<ErrRefused>(Connect, 3) == 3, "env config takes effect");
+  ::setenv("GERR_INJECT_CHECK", "db.connect every x", 1);
+  Check(gerr::LoadInjectConfigFromEnv("GERR_INJECT_CHECK") != nullptr,
+        "bad env config is rejected");
+  Check(Fires<ErrRefused>(Connect, 3) == 3, "bad env config keeps old one");
+  ::unsetenv("GERR_INJECT_CHECK");
+  Check(gerr::LoadInjectConfigFromEnv("GERR_INJECT_CHECK") == nullptr,
+        "missing env");
+  Check(Fires<ErrRefused>(Connect, 3) == 0, "missing env disables inject");
+}
+
+}  // namespace
+
+int main() {
+  Check(Fires<ErrTimeout>(Query, 10) == 0, "no config, no injection");
+  CheckParse();
+  CheckEvery();
+  CheckRate();
+  CheckMatch();
+  CheckReload();
+
+  if (failures != 0) {
+    std::fprintf(stderr, "%d injection check(s) failed\n", failures);
+    return 1;
+  }
+  std::printf("all injection checks passed\n");
+  return 0;
+}
@@ -0,0 +1,141 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <chrono>
+#include <cstdio>
+#include <gerr/gerr.hpp>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+// gerr::Intern 在一个 100 万条目的失败缓存上的效果：每个条目是
+// Wrap(New(code, "..."), "...")，其中只有 1000 种不同的错误。
+// 分别在不去重和经过 gerr::Intern 的情况下填满缓存，输出填充耗时、
+// 不同节点的个数和缓存持有的堆内存（glibc 上通过 mallinfo2 统计）：
+//   cmake --build . --target gerr_intern_report && bench/gerr_intern_report
+// 去重后不同节点的个数和不同错误的个数不一致时以非 0 值退出。
+// 最后让 100 万个互不相同的错误经过一个 10 万条目的滚动窗口，输出不去重和
+// 经过 gerr::Intern 时窗口和登记表一共持有的堆内存，差值主要是失效条目。
+
+namespace {
+
+constexpr std::size_t kEntries = 1000000;
+constexpr int kDistinct = 1000;
+constexpr std::size_t kWindow = 100000;
+
+std::size_t HeapInUse() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+  return mallinfo2().uordblks;
+#else
+  return 0;
+#endif
+}
+
+gerr::Error MakeEntry(std::size_t i) {
+  auto const key = static_cast<int>(i % kDistinct);
+  return gerr::Wrap(gerr::New(5000 + key % 8, "upstream shard {} unavailable",
+                              key % 125),
+                    "fetch key {}", key);
+}
+
+struct Row {
+  double seconds;
+  std::size_t unique;
+  std::size_t bytes;
+};
+
+template <class Fn>
+Row Fill(std::vector<gerr::Error>& cache, Fn fn) {
+  auto const before = HeapInUse();
+  auto const start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < kEntries; ++i) {
+    cache.push_back(fn(i));
+  }
+  std::chrono::duration<double> const elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::unordered_set<gerr::details::IError const*> unique;
+  for (auto const& err : cache) {
+    unique.insert(err.get());
+  }
+  return {elapsed.count(), unique.size(), HeapInUse() - before};
+}
+
+void Print(char const* name, Row const& row) {
+  std::printf("%-10s %10.3f %10zu %14zu %10.1f\n", name, row.seconds,
+              row.unique, row.bytes,
+              static_cast<double>(row.bytes) / kEntries);
+}
+
+/**
+ * 滚动窗口中每个错误都不同，被替换之后在登记表中留下一个失效条目，
+ * 返回填完之后窗口和登记表一共持有的堆内存
+ */
+template <class Fn>
+std::size_t Churn(Fn fn) {
+  auto const before = HeapInUse();
+  std::vector<gerr::Error> window(kWindow);
+  for (std::size_t i = 0; i < kEntries; ++i) {
+    window[i % kWindow] = fn(gerr::New(5000, "request {} expired", i));
+  }
+  return HeapInUse() - before;
+}
+
+}  // namespace
+
+int main() {
+  std::printf("%-10s %10s %10s %14s %10s\n", "mode", "fill(s)", "unique",
+              "heap bytes", "per entry");
+  Row plain;
+  {
+    std::vector<gerr::Error> cache;
+    cache.reserve(kEntries);
+    plain = Fill(cache, [](std::size_t i) { return MakeEntry(i); });
+  }
+  std::vector<gerr::Error> cache;
+  cache.reserve(kEntries);
+  auto const interned = Fill(
+      cache, [](std::size_t i) { return gerr::Intern(MakeEntry(i)); });
+  Print("plain", plain);
+  Print("Intern", interned);
+  if (HeapInUse() != 0) {
+    std::printf("saved %.1f%% of the heap held by the cache\n",
+                100.0 * (1.0 - static_cast<double>(interned.bytes) /
+                                   static_cast<double>(plain.bytes)));
+  }
+  if (HeapInUse() != 0) {
+    auto const churnPlain = Churn([](gerr::Error err) { return err; });
+    auto const churnInterned = Churn(
+        [](gerr::Error err) { return gerr::Intern(std::move(err)); });
+    std::printf("rolling window of %zu: plain %zu bytes, Intern %zu bytes\n",
+                kWindow, churnPlain, churnInterned);
+  }
+  if (interned.unique != kDistinct) {
+    std::fprintf(stderr, "expected %d unique errors after Intern, got %zu\n",
+                 kDistinct, interned.unique);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,187 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cstdio>
+#include <gerr/gerr.hpp>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fail_alloc.hpp"
+
+// 开启 GERR_TRACK_LIVE 时的存活错误统计检查：
+// 在本线程和其他线程上创建错误，一部分保留在缓存里，一部分立即丢弃，
+// 一部分交给其他线程释放，检查 gerr::LiveErrors 的汇总结果；
+// 无法为线程登记链表时节点照常创建，只是不参与统计；
+// 最后用 gerr::DumpLive 输出仍然存活的节点，检查调用栈只在开启抽样后记录
+
+namespace {
+
+struct Key {
+  int uin;
+};
+
+DEFINE_CODE_ERROR(ErrTimeout, 1001, "call timeout");
+DEFINE_CODE_CONTEXT_ERROR(ErrCallFailed, 1002, Key, "fail to call: uin={}",
+                          context.uin);
+DEFINE_CODE_MEMO_CONTEXT_ERROR(ErrShardDown, 1003, int, "shard {} is down",
+                               context);
+
+int failures = 0;
+
+void Check(bool ok, char const* what) {
+  if (!ok) {
+    std::fprintf(stderr, "FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+gerr::LiveGroup Find(int code) {
+  gerr::LiveGroup total{{}, code, 0, 0};
+  for (auto const& g : gerr::LiveErrors()) {
+    if (g.code == code) {
+      total.count += g.count;
+      total.bytes += g.bytes;
+    }
+  }
+  return total;
+}
+
+std::size_t Total() {
+  std::size_t count = 0;
+  for (auto const& g : gerr::LiveErrors()) {
+    count += g.count;
+  }
+  return count;
+}
+
+/** DumpLive 输出的行数 */
+int DumpedLines(std::size_t limit) {
+  auto const file = std::tmpfile();
+  if (file == nullptr) {
+    return -1;
+  }
+  gerr::DumpLive(fileno(file), limit);
+  std::rewind(file);
+  auto lines = 0;
+  for (int c; (c = std::fgetc(file)) != EOF;) {
+    lines += c == '\n';
+  }
+  std::fclose(file);
+  return lines;
+}
+
+}  // namespace
+
+int main() {
+  // 常驻的静态节点不计入
+  auto const timeout = ErrTimeout::E();
+  auto const text = gerr::New("static text");
+  Check(Total() == 0, "immortal nodes are not tracked");
+
+  // 带缓存的 E(context) 进入缓存表的节点常驻，不计入；表满之后返回的普通节点照常计入
+  std::vector<gerr::Error> shards;
+  std::size_t shared = 0;
+  for (int i = 0; i < 200; ++i) {
+    shards.push_back(ErrShardDown::E(i));
+    shared += shards.back().use_count() != 0;
+  }
+  Check(Find(1003).count == shared && shared > 0 && shared < 200,
+        "memo nodes are not tracked, overflow nodes are");
+  shards.clear();
+  Check(Total() == 0, "overflow memo nodes are released");
+
+  // 新线程第一次创建节点时登记链表失败：节点照常可用，只是不参与统计。
+  // 放在最前面，此时还没有退出的线程留下可以复用的链表
+  std::thread{[&] {
+    FailAllocAfter(1);  // 只有节点本身的分配成功
+    auto const untracked = gerr::Wrap(timeout, "untracked");
+    SetFailAlloc(false);
+    Check(untracked != nullptr && gerr::Is<ErrTimeout>(untracked),
+          "node is created when its thread cannot be registered");
+    Check(Total() == 0, "unregistered node is not counted");
+    auto const tracked = gerr::Wrap(timeout, "tracked");
+    Check(Total() == 1, "registration is retried later");
+  }}.join();
+  Check(Total() == 0, "untracked node is released safely");
+
+  std::map<int, gerr::Error> cache;
+  for (int i = 0; i < 100; ++i) {
+    auto err = ErrCallFailed::E(Key{i});
+    if (i % 4 == 0) {
+      cache[i] = std::move(err);  // 模拟被意外长期持有的错误
+    }
+  }
+  Check(Find(1002).count == 25, "kept errors are counted");
+  std::size_t usage = 0;
+  for (auto const& kv : cache) {
+    usage += gerr::MemoryUsage(kv.second);
+  }
+  Check(Find(1002).bytes == usage, "bytes match gerr::MemoryUsage");
+
+  // 在其他线程创建，在本线程释放；在本线程创建，在其他线程释放
+  std::vector<gerr::Error> fromOther;
+  std::thread{[&] {
+    for (int i = 0; i < 10; ++i) {
+      fromOther.push_back(gerr::Wrap(timeout, "worker {}", i));
+    }
+  }}.join();
+  // 汇总的是节点自身的错误码，包装节点没有错误码
+  Check(Find(0).count == 10, "errors from exited thread");
+  fromOther.clear();
+  Check(Find(0).count == 0, "freed on another thread");
+
+  std::vector<gerr::Error> toOther;
+  for (int i = 0; i < 10; ++i) {
+    toOther.push_back(gerr::New("dynamic {}", i));
+  }
+  Check(Total() == 35, "dynamic messages are counted");
+  std::thread{[](std::vector<gerr::Error> moved) { moved.clear(); },
+              std::move(toOther)}
+      .join();
+  Check(Total() == 25, "released by another thread");
+
+  for (auto& kv : cache) {
+    if (kv.first >= 40) {
+      kv.second = nullptr;
+    }
+  }
+  Check(Find(1002).count == 10, "released from cache");
+
+  // 默认不记录调用栈：汇总两行、每组一行，每个节点一行
+  auto const plain = DumpedLines(3);
+  Check(plain == 2 + 1 + 3, "no backtrace by default");
+  {
+    gerr::SetLiveBacktraceSampling(1);
+    auto const sampled = ErrCallFailed::E(Key{-1});
+    gerr::SetLiveBacktraceSampling(0);
+    // 新节点最晚创建，输出全部 11 个节点时才会出现，之后是它的调用栈
+    Check(DumpedLines(11) > 2 + 1 + 11, "backtrace when sampling");
+  }
+
+  gerr::DumpLive(1, 3);
+  cache.clear();
+  Check(Total() == 0, "nothing left alive");
+  (void)text;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,693 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <gerr/gerr.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+// 模拟一个多线程 RPC 服务的错误路径：每个请求经过 3-10 层调用，最底层按配置的
+// 错误率返回错误，每一层都用 gerr::Wrap 包装后向上传递，最外层对错误分类并
+// 写入日志，日志可以在请求线程同步写入，也可以交给日志线程异步写入（错误对象
+// 因此会在另一个线程上析构）。
+//
+// 用法：gerr_loadsim <场景配置文件>
+// 配置文件的格式参考 bench/loadsim/*.conf，由全局配置和若干个按顺序执行的
+// 阶段组成，每个报告周期输出一行吞吐、延迟分位数和 RSS，每个阶段结束时输出
+// 该阶段的汇总。
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// ---------------------------------------------------------------------------
+// 配置
+// ---------------------------------------------------------------------------
+
+enum ErrorKind { kStatic, kContext, kFormat, kErrno, kKindCount };
+
+char const* const kKindNames[kKindCount] = {"static", "context", "format",
+                                            "errno"};
+
+struct Phase {
+  std::string name;
+  int durationMs{5000};
+  double errorRate{0.01};
+  int depthMin{3};
+  int depthMax{10};
+  int work{200};     // 成功路径上每个请求的计算量（循环次数）
+  int qps{0};        // 所有线程合计的目标 QPS，0 表示不限速
+  int retain{0};     // 每个线程保留最近多少个错误，模拟错误被缓存后延迟析构
+  int mix[kKindCount]{25, 25, 25, 25};  // 各类底层错误的权重
+};
+
+struct Scenario {
+  int threads{4};
+  int reportMs{1000};
+  std::string log{"async"};  // none / sync / async
+  std::string logPath{"/dev/null"};
+  int logQueue{65536};       // 异步日志队列长度，队列满时丢弃
+  std::vector<Phase> phases;
+};
+
+std::string Trim(std::string const& s) {
+  auto const begin = s.find_first_not_of(" \t\r");
+  if (begin == std::string::npos) {
+    return {};
+  }
+  auto const end = s.find_last_not_of(" \t\r");
+  return s.substr(begin, end - begin + 1);
+}
+
+bool ParseMix(std::string const& value, int* mix) {
+  std::fill(mix, mix + kKindCount, 0);
+  std::istringstream is{value};
+  std::string item;
+  while (is >> item) {
+    auto const colon = item.find(':');
+    if (colon == std::string::npos) {
+      return false;
+    }
+    auto const name = item.substr(0, colon);
+    auto const it = std::find_if(
+        kKindNames, kKindNames + kKindCount,
+        [&](char const* kind) { return name == kind; });
+    if (it == kKindNames + kKindCount) {
+      return false;
+    }
+    mix[it - kKindNames] = std::atoi(item.c_str() + colon + 1);
+  }
+  return true;
+}
+
+bool SetPhase(Phase& phase, std::string const& key, std::string const& value) {
+  if (key == "duration_ms") {
+    phase.durationMs = std::atoi(value.c_str());
+  } else if (key == "error_rate") {
+    phase.errorRate = std::atof(value.c_str());
+  } else if (key == "depth_min") {
+    phase.depthMin = std::atoi(value.c_str());
+  } else if (key == "depth_max") {
+    phase.depthMax = std::atoi(value.c_str());
+  } else if (key == "work") {
+    phase.work = std::atoi(value.c_str());
+  } else if (key == "qps") {
+    phase.qps = std::atoi(value.c_str());
+  } else if (key == "retain") {
+    phase.retain = std::atoi(value.c_str());
+  } else if (key == "mix") {
+    return ParseMix(value, phase.mix);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool SetGlobal(Scenario& scenario, std::string const& key,
+               std::string const& value) {
+  if (key == "threads") {
+    scenario.threads = std::atoi(value.c_str());
+  } else if (key == "report_ms") {
+    scenario.reportMs = std::atoi(value.c_str());
+  } else if (key == "log") {
+    scenario.log = value;
+  } else if (key == "log_path") {
+    scenario.logPath = value;
+  } else if (key == "log_queue") {
+    scenario.logQueue = std::atoi(value.c_str());
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/**
+ * 读取场景配置，出错时返回 gerr::Error。
+ * 全局配置写在第一个 [phase <名称>] 之前，全局配置中出现的阶段参数作为
+ * 之后所有阶段的默认值。
+ */
+gerr::Error LoadScenario(char const* path, Scenario* scenario) {
+  std::ifstream in{path};
+  if (!in) {
+    return gerr::Wrap(gerr::FromErrno(errno), "open {}", path);
+  }
+  Phase defaults;
+  std::string line;
+  for (int lineNo = 1; std::getline(in, line); ++lineNo) {
+    line = Trim(line.substr(0, line.find('#')));
+    if (line.empty()) {
+      continue;
+    }
+    if (line.front() == '[') {
+      if (line.back() != ']' || line.compare(0, 7, "[phase ") != 0) {
+        return gerr::New("{}:{}: expect [phase <name>]", path, lineNo);
+      }
+      scenario->phases.push_back(defaults);
+      scenario->phases.back().name = Trim(line.substr(7, line.size() - 8));
+      continue;
+    }
+    auto const eq = line.find('=');
+    if (eq == std::string::npos) {
+      return gerr::New("{}:{}: expect key = value", path, lineNo);
+    }
+    auto const key = Trim(line.substr(0, eq));
+    auto const value = Trim(line.substr(eq + 1));
+    auto const ok = scenario->phases.empty()
+                        ? SetGlobal(*scenario, key, value) ||
+                              SetPhase(defaults, key, value)
+                        : SetPhase(scenario->phases.back(), key, value);
+    if (!ok) {
+      return gerr::New("{}:{}: bad setting: {}", path, lineNo, line);
+    }
+  }
+  if (scenario->phases.empty()) {
+    return gerr::New("{}: no [phase] defined", path);
+  }
+  if (scenario->threads <= 0 || scenario->reportMs <= 0) {
+    return gerr::New("{}: threads and report_ms must be positive", path);
+  }
+  if (scenario->log != "none" && scenario->log != "sync" &&
+      scenario->log != "async") {
+    return gerr::New("{}: log must be none, sync or async", path);
+  }
+  for (auto const& phase : scenario->phases) {
+    if (phase.depthMin < 1 || phase.depthMax < phase.depthMin) {
+      return gerr::New("{}: phase {}: bad depth range", path, phase.name);
+    }
+  }
+  return nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// 延迟直方图：小于 16ns 的值精确记录，之后每个 2 的幂区间分为 16 个桶，
+// 相对误差不超过 1/16。每个线程只写自己的直方图，报告线程只读。
+// ---------------------------------------------------------------------------
+
+class Histogram {
+ public:
+  static constexpr int kBuckets = 1024;
+
+  static int Bucket(std::uint64_t v) {
+    if (v < 16) {
+      return static_cast<int>(v);
+    }
+    auto const e = 63 - __builtin_clzll(v);
+    return (e - 3) * 16 + static_cast<int>((v >> (e - 4)) & 15);
+  }
+
+  static std::uint64_t LowerBound(int bucket) {
+    if (bucket < 16) {
+      return static_cast<std::uint64_t>(bucket);
+    }
+    auto const e = bucket / 16 + 3;
+    auto const sub = static_cast<std::uint64_t>(bucket % 16);
+    return (16 + sub) << (e - 4);
+  }
+
+  std::uint64_t counts[kBuckets]{};
+
+  void Add(Histogram const& other) {
+    for (int i = 0; i < kBuckets; ++i) {
+      counts[i] += other.counts[i];
+    }
+  }
+
+  std::uint64_t Total() const {
+    std::uint64_t total = 0;
+    for (auto c : counts) {
+      total += c;
+    }
+    return total;
+  }
+
+  double Percentile(double p) const {
+    auto const total = Total();
+    if (total == 0) {
+      return 0;
+    }
+    auto const rank = static_cast<std::uint64_t>(p * (total - 1));
+    std::uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+      seen += counts[i];
+      if (seen > rank) {
+        return static_cast<double>(LowerBound(i));
+      }
+    }
+    return 0;
+  }
+};
+
+/** 单个线程写入、其他线程读取的计数器 */
+class Counter {
+ public:
+  void Inc(std::uint64_t n = 1) {
+    value_.store(value_.load(std::memory_order_relaxed) + n,
+                 std::memory_order_relaxed);
+  }
+  std::uint64_t Load() const { return value_.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<std::uint64_t> value_{0};
+};
+
+struct WorkerStats {
+  Counter requests;
+  Counter errors;
+  Counter retriable;
+  Counter latency[Histogram::kBuckets];
+
+  void Snapshot(Histogram* h, std::uint64_t* req, std::uint64_t* err,
+                std::uint64_t* retry) const {
+    for (int i = 0; i < Histogram::kBuckets; ++i) {
+      h->counts[i] += latency[i].Load();
+    }
+    *req += requests.Load();
+    *err += errors.Load();
+    *retry += retriable.Load();
+  }
+};
+
+// ---------------------------------------------------------------------------
+// 日志
+// ---------------------------------------------------------------------------
+
+class LogSink {
+ public:
+  virtual ~LogSink() {}
+  virtual void Log(gerr::Error err) = 0;
+  virtual std::uint64_t Dropped() const { return 0; }
+};
+
+class NullSink : public LogSink {
+ public:
+  void Log(gerr::Error) override {}
+};
+
+/** 在请求线程上格式化并写入，多个线程共享同一个文件 */
+class SyncSink : public LogSink {
+ public:
+  explicit SyncSink(std::FILE* file) : file_{file} {}
+
+  void Log(gerr::Error err) override {
+    auto const line = gerr::String(err);
+    std::lock_guard<std::mutex> lock{mu_};
+    std::fprintf(file_, "%s\n", line.c_str());
+  }
+
+ private:
+  std::mutex mu_;
+  std::FILE* file_;
+};
+
+/** 请求线程只把错误放进队列，由日志线程格式化、写入并析构 */
+class AsyncSink : public LogSink {
+ public:
+  AsyncSink(std::FILE* file, std::size_t capacity)
+      : file_{file}, capacity_{capacity}, thread_{[this] { Loop(); }} {}
+
+  ~AsyncSink() override {
+    {
+      std::lock_guard<std::mutex> lock{mu_};
+      stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+  }
+
+  void Log(gerr::Error err) override {
+    {
+      std::lock_guard<std::mutex> lock{mu_};
+      if (queue_.size() >= capacity_) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      queue_.push_back(std::move(err));
+    }
+    cv_.notify_one();
+  }
+
+  std::uint64_t Dropped() const override {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  void Loop() {
+    std::deque<gerr::Error> batch;
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock{mu_};
+        cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty() && stop_) {
+          return;
+        }
+        batch.swap(queue_);
+      }
+      for (auto const& err : batch) {
+        std::fprintf(file_, "%s\n", gerr::String(err).c_str());
+      }
+      batch.clear();
+    }
+  }
+
+  std::FILE* file_;
+  std::size_t capacity_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<gerr::Error> queue_;
+  bool stop_{};
+  std::atomic<std::uint64_t> dropped_{0};
+  std::thread thread_;
+};
+
+// ---------------------------------------------------------------------------
+// 请求处理
+// ---------------------------------------------------------------------------
+
+struct CallContext {
+  std::uint64_t requestId;
+  int shard;
+};
+
+DEFINE_CODE_ERROR(ErrBackendBusy, 503001, "backend busy");
+DEFINE_CODE_CONTEXT_ERROR(ErrBackendTimeout, 504001, CallContext,
+                          "backend timeout: request={}, shard={}",
+                          context.requestId, context.shard);
+
+constexpr int kLayerCode = 600000;
+constexpr int kBadRequest = 400001;
+
+struct Request {
+  std::uint64_t id;
+  int depth;
+  ErrorKind kind;  // 请求失败时底层返回的错误类型
+  bool fail;
+  int work;
+};
+
+GERR_NOINLINE gerr::Error Backend(Request const& req) {
+  if (!req.fail) {
+    volatile std::uint64_t x = req.id;
+    for (int i = 0; i < req.work; ++i) {
+      x = x * 6364136223846793005ull + 1442695040888963407ull;
+    }
+    return nullptr;
+  }
+  switch (req.kind) {
+    case kStatic:
+      return ErrBackendBusy::E();
+    case kContext:
+      return ErrBackendTimeout::E({req.id, static_cast<int>(req.id % 64)});
+    case kFormat:
+      return gerr::New(kBadRequest, "bad request {}: field {} missing", req.id,
+                       "user_id");
+    default:
+      return gerr::FromErrno(ECONNRESET);
+  }
+}
+
+/** 第 layer 层调用，每一层都包装下层返回的错误，奇偶层交替使用两种包装方式 */
+GERR_NOINLINE gerr::Error CallLayer(Request const& req, int layer) {
+  auto err = layer == req.depth ? Backend(req) : CallLayer(req, layer + 1);
+  if (err == nullptr) {
+    return nullptr;
+  }
+  if (layer % 2 == 0) {
+    return gerr::Wrap(std::move(err), "layer {} fail: request={}", layer,
+                      req.id);
+  }
+  return gerr::Wrap(std::move(err), kLayerCode + layer, "layer call fail");
+}
+
+class Worker {
+ public:
+  Worker(int index, int threads, std::vector<Phase> const& phases,
+         std::atomic<int> const& phase, LogSink& sink)
+      : index_{index},
+        threads_{threads},
+        phases_(phases),
+        phase_(phase),
+        sink_(sink),
+        rng_{static_cast<std::uint32_t>(index) * 7919u + 1u} {}
+
+  WorkerStats const& Stats() const { return stats_; }
+
+  void Run() {
+    std::uint64_t seq = 0;
+    auto next = Clock::now();
+    std::vector<gerr::Error> retained;
+    std::size_t retainPos = 0;
+    for (;;) {
+      auto const current = phase_.load(std::memory_order_acquire);
+      if (current < 0) {
+        return;
+      }
+      auto const& phase = phases_[current];
+      if (phase.qps > 0) {
+        next += std::chrono::nanoseconds{1000000000ll * threads_ / phase.qps};
+        auto const now = Clock::now();
+        if (next > now) {
+          std::this_thread::sleep_until(next);
+        } else if (now - next > std::chrono::seconds{1}) {
+          next = now;  // 落后太多时不再补发
+        }
+      }
+      if (retained.size() != static_cast<std::size_t>(phase.retain)) {
+        retained.assign(static_cast<std::size_t>(phase.retain), nullptr);
+        retainPos = 0;
+      }
+
+      auto const req = MakeRequest(phase, seq++);
+      auto const begin = Clock::now();
+      auto err = CallLayer(req, 1);
+      if (err != nullptr) {
+        if (gerr::IsCode(504001, err) || gerr::Is<ErrBackendBusy>(err)) {
+          stats_.retriable.Inc();
+        }
+        stats_.errors.Inc();
+        if (!retained.empty()) {
+          retained[retainPos] = err;
+          retainPos = (retainPos + 1) % retained.size();
+        }
+        sink_.Log(std::move(err));
+      }
+      auto const ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          Clock::now() - begin)
+                          .count();
+      stats_.latency[Histogram::Bucket(static_cast<std::uint64_t>(ns))].Inc();
+      stats_.requests.Inc();
+    }
+  }
+
+ private:
+  Request MakeRequest(Phase const& phase, std::uint64_t seq) {
+    Request req{};
+    req.id = (seq << 8) | static_cast<std::uint64_t>(index_);
+    req.depth = std::uniform_int_distribution<int>{phase.depthMin,
+                                                   phase.depthMax}(rng_);
+    req.fail = std::uniform_real_distribution<double>{}(rng_) < phase.errorRate;
+    req.work = phase.work;
+    if (req.fail) {
+      int total = 0;
+      for (auto w : phase.mix) {
+        total += w;
+      }
+      auto pick = total > 0 ? std::uniform_int_distribution<int>{
+                                  0, total - 1}(rng_)
+                            : 0;
+      int kind = 0;
+      while (kind < kKindCount - 1 && pick >= phase.mix[kind]) {
+        pick -= phase.mix[kind];
+        ++kind;
+      }
+      req.kind = static_cast<ErrorKind>(kind);
+    }
+    return req;
+  }
+
+  int index_;
+  int threads_;
+  std::vector<Phase> const& phases_;
+  std::atomic<int> const& phase_;
+  LogSink& sink_;
+  std::minstd_rand rng_;
+  WorkerStats stats_;
+};
+
+// ---------------------------------------------------------------------------
+// 报告
+// ---------------------------------------------------------------------------
+
+double RssMiB() {
+#ifdef __linux__
+  std::ifstream in{"/proc/self/statm"};
+  long pages = 0;
+  long resident = 0;
+  if (in >> pages >> resident) {
+    return static_cast<double>(resident) * sysconf(_SC_PAGESIZE) /
+           (1024.0 * 1024.0);
+  }
+#endif
+  return 0;
+}
+
+struct Totals {
+  Histogram latency;
+  std::uint64_t requests{};
+  std::uint64_t errors{};
+  std::uint64_t retriable{};
+
+  static Totals Collect(std::vector<std::unique_ptr<Worker>> const& workers) {
+    Totals t;
+    for (auto const& w : workers) {
+      w->Stats().Snapshot(&t.latency, &t.requests, &t.errors, &t.retriable);
+    }
+    return t;
+  }
+
+  Totals Since(Totals const& before) const {
+    Totals t = *this;
+    for (int i = 0; i < Histogram::kBuckets; ++i) {
+      t.latency.counts[i] -= before.latency.counts[i];
+    }
+    t.requests -= before.requests;
+    t.errors -= before.errors;
+    t.retriable -= before.retriable;
+    return t;
+  }
+};
+
+void Print(char const* label, std::string const& phase, double seconds,
+           Totals const& t, double elapsed, LogSink const& sink) {
+  std::printf(
+      "%-7s %-12s t=%7.1fs qps=%10.0f err/s=%9.0f retriable=%5.1f%% "
+      "p50=%8.2fus p99=%8.2fus p999=%8.2fus rss=%7.1fMiB log_drops=%llu\n",
+      label, phase.c_str(), seconds, t.requests / elapsed,
+      t.errors / elapsed,
+      t.errors == 0 ? 0.0 : 100.0 * t.retriable / t.errors,
+      t.latency.Percentile(0.5) / 1000, t.latency.Percentile(0.99) / 1000,
+      t.latency.Percentile(0.999) / 1000, RssMiB(),
+      static_cast<unsigned long long>(sink.Dropped()));
+  std::fflush(stdout);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    std::fprintf(stderr, "usage: %s <scenario.conf>\n", argv[0]);
+    return 1;
+  }
+  Scenario scenario;
+  auto err = LoadScenario(argv[1], &scenario);
+  if (err != nullptr) {
+    std::fprintf(stderr, "%s\n", gerr::String(err).c_str());
+    return 1;
+  }
+
+  std::FILE* file = nullptr;
+  std::unique_ptr<LogSink> sink;
+  if (scenario.log == "none") {
+    sink.reset(new NullSink{});
+  } else {
+    file = std::fopen(scenario.logPath.c_str(), "w");
+    if (file == nullptr) {
+      err = gerr::Wrap(gerr::FromErrno(errno), "open log {}",
+                       scenario.logPath);
+      std::fprintf(stderr, "%s\n", gerr::String(err).c_str());
+      return 1;
+    }
+    if (scenario.log == "sync") {
+      sink.reset(new SyncSink{file});
+    } else {
+      sink.reset(new AsyncSink{file,
+                               static_cast<std::size_t>(scenario.logQueue)});
+    }
+  }
+
+  std::atomic<int> phase{0};
+  std::vector<std::unique_ptr<Worker>> workers;
+  for (int i = 0; i < scenario.threads; ++i) {
+    workers.emplace_back(
+        new Worker{i, scenario.threads, scenario.phases, phase, *sink});
+  }
+  std::vector<std::thread> threads;
+  for (auto const& w : workers) {
+    threads.emplace_back([&w] { w->Run(); });
+  }
+
+  auto const start = Clock::now();
+  auto const report = std::chrono::milliseconds{scenario.reportMs};
+  auto last = Totals::Collect(workers);
+  for (std::size_t i = 0; i < scenario.phases.size(); ++i) {
+    auto const& p = scenario.phases[i];
+    phase.store(static_cast<int>(i), std::memory_order_release);
+    auto const phaseStart = Clock::now();
+    auto const phaseEnd = phaseStart + std::chrono::milliseconds{p.durationMs};
+    auto const phaseBegin = last;
+    auto tick = phaseStart;
+    while (tick < phaseEnd) {
+      tick = std::min(tick + report, phaseEnd);
+      std::this_thread::sleep_until(tick);
+      auto const now = Totals::Collect(workers);
+      auto const elapsed =
+          std::chrono::duration<double>(Clock::now() - start).count();
+      Print("report", p.name, elapsed, now.Since(last),
+            std::chrono::duration<double>(report).count(), *sink);
+      last = now;
+    }
+    Print("phase", p.name,
+          std::chrono::duration<double>(Clock::now() - start).count(),
+          last.Since(phaseBegin),
+          std::chrono::duration<double>(Clock::now() - phaseStart).count(),
+          *sink);
+  }
+
+  phase.store(-1, std::memory_order_release);
+  for (auto& t : threads) {
+    t.join();
+  }
+  workers.clear();
+  sink.reset();
+  if (file != nullptr) {
+    std::fclose(file);
+  }
+  return 0;
+}
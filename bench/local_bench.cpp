@@ -0,0 +1,101 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <benchmark/benchmark.h>
+
+#include <gerr/gerr.hpp>
+
+#include "alloc_count.hpp"
+
+// gerr::LocalError 和堆上的 gerr::Error 在"创建后只检查错误码就丢弃"这一路径上
+// 的开销对比。全局 operator new 被替换为计数版本，每个用例都会输出 allocs 计数，
+// 即每次迭代的平均分配次数，LocalError 不逃逸时应当为 0。
+
+namespace {
+
+constexpr int kBadDigit = 1001;
+
+gerr::Error ParseHeap(char c, int* out) {
+  if (c < '0' || c > '9') {
+    return gerr::New(kBadDigit, "bad digit: {}", c);
+  }
+  *out = c - '0';
+  return nullptr;
+}
+
+gerr::LocalError ParseLocal(char c, int* out) {
+  if (c < '0' || c > '9') {
+    return {kBadDigit, "bad digit: {}", c};
+  }
+  *out = c - '0';
+  return nullptr;
+}
+
+gerr::LocalError ParseLocalStatic(char c, int* out) {
+  if (c < '0' || c > '9') {
+    return {kBadDigit, "bad digit"};
+  }
+  *out = c - '0';
+  return nullptr;
+}
+
+template <class Fn>
+void RunParse(benchmark::State& state, Fn fn) {
+  auto const before = AllocCount();
+  int out = 0;
+  for (auto _ : state) {
+    auto err = fn('x', &out);
+    auto const bad = gerr::IsCode(kBadDigit, err);
+    benchmark::DoNotOptimize(bad);
+  }
+  state.counters["allocs"] =
+      benchmark::Counter(static_cast<double>(AllocCount() - before),
+                         benchmark::Counter::kAvgIterations);
+}
+
+void BM_HeapFormatted(benchmark::State& state) { RunParse(state, ParseHeap); }
+BENCHMARK(BM_HeapFormatted);
+
+void BM_LocalFormatted(benchmark::State& state) { RunParse(state, ParseLocal); }
+BENCHMARK(BM_LocalFormatted);
+
+void BM_LocalStatic(benchmark::State& state) {
+  RunParse(state, ParseLocalStatic);
+}
+BENCHMARK(BM_LocalStatic);
+
+void BM_LocalEscape(benchmark::State& state) {
+  auto const before = AllocCount();
+  int out = 0;
+  for (auto _ : state) {
+    auto err = ParseLocal('x', &out).Escape();
+    benchmark::DoNotOptimize(err);
+  }
+  state.counters["allocs"] =
+      benchmark::Counter(static_cast<double>(AllocCount() - before),
+                         benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_LocalEscape);
+
+}  // namespace
+
+BENCHMARK_MAIN();
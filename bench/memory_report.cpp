@@ -0,0 +1,250 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cerrno>
+#include <cstdio>
+#include <gerr/exception.hpp>
+#include <gerr/gerr.hpp>
+#include <gerr/status.hpp>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include "alloc_count.hpp"
+
+// 列出每种错误节点和典型错误链条的内存占用：
+//   sizeof     节点类型本身的大小
+//   allocs     创建时 operator new 的调用次数
+//   requested  向 operator new 申请的字节数（节点、控制块、字符串等）
+//   usable     malloc 实际给出的字节数，和 requested 的差值是分配器的取整开销
+//   usage      gerr::MemoryUsage 的结果，应当和 requested 相等
+// 任何一行 usage 和 requested 不相等时以非 0 值退出：
+//   cmake --build . --target gerr_memory_report && bench/gerr_memory_report
+
+namespace {
+
+enum class ParseCode { kOk, kBadDigit };
+
+}  // namespace
+
+namespace gerr {
+
+template <>
+struct StatusDomain<ParseCode> {
+  static constexpr char const* Name() { return "parse"; }
+  static char const* Message(ParseCode code) {
+    return code == ParseCode::kBadDigit ? "bad digit" : "";
+  }
+};
+
+}  // namespace gerr
+
+namespace {
+
+struct CallContext {
+  int uin;
+  char const* client;
+};
+
+struct RequestContext {
+  std::string path;
+  int attempt;
+};
+
+DEFINE_ERROR(ErrPlain, "plain error");
+DEFINE_CODE_ERROR(ErrTimeout, 1001, "call timeout");
+DEFINE_CODE_CONTEXT_ERROR(ErrCallFailed, 1002, CallContext,
+                          "fail to call: uin={}, client={}", context.uin,
+                          context.client);
+DEFINE_CONTEXT_ERROR(ErrShortContext, CallContext, "uin={}", context.uin);
+
+// 带堆内存的环境信息类型需要在同一个命名空间中提供 HeapUsage，
+// 才能被 gerr::MemoryUsage 统计到
+std::size_t HeapUsage(RequestContext const& context) {
+  return gerr::details::StringHeapUsage(context.path);
+}
+
+DEFINE_CODE_CONTEXT_ERROR(ErrRequest, 1003, RequestContext,
+                          "request fail: path={}, attempt={}", context.path,
+                          context.attempt);
+
+constexpr char const* kLongMessage = "a message longer than the short string";
+
+struct Sample {
+  gerr::Error err;
+  std::size_t allocs;
+  std::size_t requested;
+  std::size_t usable;
+};
+
+template <class Fn>
+Sample Measure(Fn fn) {
+  auto const allocs = AllocCount();
+  auto const requested = AllocBytes();
+  auto const usable = AllocUsableBytes();
+  auto err = fn();
+  return {std::move(err), AllocCount() - allocs, AllocBytes() - requested,
+          AllocUsableBytes() - usable};
+}
+
+int gMismatches = 0;
+
+void Print(char const* name, std::size_t size, Sample const& s) {
+  auto const usage = gerr::MemoryUsage(s.err);
+  auto const ok = usage == s.requested;
+  if (!ok) {
+    ++gMismatches;
+  }
+  char sizeText[16] = "-";
+  if (size != 0) {
+    std::snprintf(sizeText, sizeof(sizeText), "%zu", size);
+  }
+  std::printf("%-44s %6s %6zu %9zu %9zu %9zu%s\n", name, sizeText, s.allocs,
+              s.requested, s.usable, usage, ok ? "" : "  MISMATCH");
+}
+
+template <class NodeType, class Fn>
+void Node(char const* name, Fn fn) {
+  Print(name, sizeof(NodeType), Measure(fn));
+}
+
+template <class Fn>
+void Chain(char const* name, Fn fn) {
+  Print(name, 0, Measure(fn));
+}
+
+gerr::Error WrapChain(int depth) {
+  auto err = ErrTimeout::E();
+  for (int i = 1; i < depth; ++i) {
+    err = gerr::Wrap(err, "layer {} fail: request=1234567890", i);
+  }
+  return err;
+}
+
+void ReportNodes() {
+  using namespace gerr::details;
+  auto const cause = ErrTimeout::E();
+
+  Node<RawStrMessageError>("RawStrMessageError (Make)",
+                           [] { return gerr::Make<RawStrMessageError>("x"); });
+  Node<MessageError>("MessageError (New fmt, short)",
+                     [] { return gerr::New("bad {}", 1); });
+  Node<MessageError>("MessageError (New fmt, long)",
+                     [] { return gerr::New("{}", kLongMessage); });
+  Node<CodeRawStrMessageError>("CodeRawStrMessageError (Make)", [] {
+    return gerr::Make<CodeRawStrMessageError>(1, "x");
+  });
+  Node<CodeMessageError>("CodeMessageError (New code fmt, long)",
+                         [] { return gerr::New(1, "{}", kLongMessage); });
+  Node<CodeSubError>("CodeSubError (Wrap code)",
+                     [&] { return gerr::Wrap(cause, 2); });
+  Node<RawStrMessageSubError>("RawStrMessageSubError (Wrap msg)",
+                              [&] { return gerr::Wrap(cause, "fail"); });
+  Node<MessageSubError>("MessageSubError (Wrap fmt, long)", [&] {
+    return gerr::Wrap(cause, "{}", kLongMessage);
+  });
+  Node<CodeRawStrMessageSubError>("CodeRawStrMessageSubError (Wrap code msg)",
+                                  [&] { return gerr::Wrap(cause, 2, "fail"); });
+  Node<CodeMessageSubError>("CodeMessageSubError (Wrap code fmt, long)", [&] {
+    return gerr::Wrap(cause, 2, "{}", kLongMessage);
+  });
+  Node<ErrnoError>("ErrnoError (FromErrno, uncached)",
+                   [] { return gerr::FromErrno(100000); });
+  Node<ErrorCodeError>("ErrorCodeError (FromErrorCode, rendered)", [] {
+    auto err =
+        gerr::FromErrorCode(std::make_error_code(std::io_errc::stream));
+    err->Message();
+    return err;
+  });
+  Node<StatusError<ParseCode>>("StatusError (Status with context)", [] {
+    return gerr::Status<ParseCode>{ParseCode::kBadDigit, kLongMessage}
+        .ToError();
+  });
+  try {
+    throw std::runtime_error{kLongMessage};
+  } catch (std::exception const& e) {
+    Node<ExceptionError>("ExceptionError (FromException)",
+                         [&] { return gerr::FromException(e); });
+  }
+  Node<CodeMessageError>("LocalError::Escape (formatted)", [] {
+    return gerr::LocalError{1, "bad digit: {}", 'x'}.Escape();
+  });
+}
+
+void ReportDefined() {
+  auto const cause = ErrTimeout::E();
+
+  Node<ErrPlain>("DEFINE_ERROR E(cause)", [&] { return ErrPlain::E(cause); });
+  Node<ErrTimeout>("DEFINE_CODE_ERROR E(cause)",
+                   [&] { return ErrTimeout::E(cause); });
+  Node<ErrShortContext>("DEFINE_CONTEXT_ERROR E(ctx), short",
+                        [] { return ErrShortContext::E({1, "c"}); });
+  Node<ErrCallFailed>("DEFINE_CODE_CONTEXT_ERROR E(ctx)", [] {
+    return ErrCallFailed::E({123456789, "some-client"});
+  });
+  Node<ErrCallFailed>("DEFINE_CODE_CONTEXT_ERROR E(cause, ctx)", [&] {
+    return ErrCallFailed::E(cause, {123456789, "some-client"});
+  });
+  Node<ErrRequest>("DEFINE_CODE_CONTEXT_ERROR, string context", [] {
+    return ErrRequest::E({std::string{"/api/v1/users/12345/profile"}, 3});
+  });
+}
+
+void ReportShared() {
+  // 常驻节点在第一次调用时创建，之后不再分配，也不计入任何链条
+  (void)ErrPlain::E();
+  (void)gerr::New(1, "static message");
+  (void)gerr::FromErrno(ENOENT);
+  Chain("static E()", [] { return ErrPlain::E(); });
+  Chain("New(code, literal)", [] { return gerr::New(1, "static message"); });
+  Chain("FromErrno(ENOENT)", [] { return gerr::FromErrno(ENOENT); });
+}
+
+void ReportChains() {
+  for (auto depth : {2, 4, 16, 64}) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "Wrap fmt chain, depth %d", depth);
+    Chain(name, [&] { return WrapChain(depth); });
+  }
+  // 共享的父错误在每条链条上都会计入，因此这一行不和实际分配对比
+  auto const shared = WrapChain(4);
+  auto const err = gerr::Wrap(shared, "fail");
+  std::printf("%-44s %6s %6s %9s %9s %9zu\n", "Wrap over a shared depth-4 chain",
+              "-", "-", "-", "-", gerr::MemoryUsage(err));
+}
+
+}  // namespace
+
+int main() {
+  std::printf("%-44s %6s %6s %9s %9s %9s\n", "node / chain", "sizeof",
+              "allocs", "requested", "usable", "usage");
+  ReportNodes();
+  ReportDefined();
+  ReportShared();
+  ReportChains();
+  if (gMismatches != 0) {
+    std::fprintf(stderr, "%d row(s) where MemoryUsage != requested bytes\n",
+                 gMismatches);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,129 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+#include <gerr/gerr.hpp>
+#include <new>
+
+#include "fail_alloc.hpp"
+
+// 内存不足时错误创建的开销和行为。全局 operator new 被替换为可以按需失败的版本，
+// 每个用例在分配失败的情况下创建错误，并检查返回的后备错误是否保留了错误码、
+// 静态错误信息和父错误、能否通过 AsError 取得所有权，不符合预期时用例会报错。
+
+namespace {
+
+struct CallContext {
+  int uin;
+};
+
+DEFINE_CODE_ERROR(ErrOomStatic, 2001, "static error");
+DEFINE_CODE_CONTEXT_ERROR(ErrOomContext, 2002, CallContext,
+                          "call fail: uin={}", context.uin);
+
+/** 在分配失败的状态下执行 fn */
+template <class Fn>
+gerr::Error Failing(Fn fn) {
+  SetFailAlloc(true);
+  auto err = fn();
+  SetFailAlloc(false);
+  return err;
+}
+
+/** 后备节点有真正的所有者，内存不足时在它上面调用 AsError 也不会抛出 */
+bool Owned(gerr::Error const& err) {
+  SetFailAlloc(true);
+  bool owned = false;
+  try {
+    owned = err->AsError() == err;
+  } catch (...) {
+  }
+  SetFailAlloc(false);
+  return owned;
+}
+
+void Check(benchmark::State& state, gerr::Error const& err, int code,
+           char const* message, gerr::Error const& cause) {
+  if (!gerr::Is<gerr::details::OutOfMemoryError>(err) || !Owned(err) ||
+      err->Code() != code || std::strcmp(err->Message(), message) != 0 ||
+      err->Cause() != cause) {
+    state.SkipWithError("unexpected fallback error");
+  }
+}
+
+void BM_NewFormatOom(benchmark::State& state) {
+  gerr::Error err;
+  for (auto _ : state) {
+    err = Failing([] { return gerr::New(1, "fail to call: uin={}", 123); });
+    benchmark::DoNotOptimize(err);
+  }
+  Check(state, err, 1, "fail to call: uin={}", nullptr);
+}
+BENCHMARK(BM_NewFormatOom);
+
+void BM_WrapOom(benchmark::State& state) {
+  auto const cause = gerr::New(7, "cause");
+  gerr::Error err;
+  for (auto _ : state) {
+    err = Failing([&] { return gerr::Wrap(cause, 2, "retry {}", 3); });
+    benchmark::DoNotOptimize(err);
+  }
+  // 后备节点释放后槽位会被回收，父错误始终保留
+  Check(state, err, 2, "retry {}", cause);
+}
+BENCHMARK(BM_WrapOom);
+
+void BM_DefineWrapOom(benchmark::State& state) {
+  auto const cause = gerr::New(7, "cause");
+  gerr::Error err;
+  for (auto _ : state) {
+    err = Failing([&] { return ErrOomStatic::E(cause); });
+    benchmark::DoNotOptimize(err);
+  }
+  Check(state, err, 2001, "static error", cause);
+}
+BENCHMARK(BM_DefineWrapOom);
+
+void BM_DefineContextOom(benchmark::State& state) {
+  gerr::Error err;
+  for (auto _ : state) {
+    err = Failing([] { return ErrOomContext::E({123}); });
+    benchmark::DoNotOptimize(err);
+  }
+  Check(state, err, 2002, "call fail: uin={}", nullptr);
+}
+BENCHMARK(BM_DefineContextOom);
+
+// 对照：正常情况下的创建开销，用于观察 noexcept 包装本身的开销
+void BM_NewFormat(benchmark::State& state) {
+  for (auto _ : state) {
+    auto err = gerr::New(1, "fail to call: uin={}", 123);
+    benchmark::DoNotOptimize(err);
+  }
+}
+BENCHMARK(BM_NewFormat);
+
+}  // namespace
+
+BENCHMARK_MAIN();
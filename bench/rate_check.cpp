@@ -0,0 +1,202 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <gerr/gerr.hpp>
+#include <gerr/rate.hpp>
+#include <sstream>
+#include <string>
+#include <thread>
+
+// gerr::RateTracker 的窗口统计检查：按秒滚动的窗口边界、计数行被循环复用之后的
+// 计数、多个线程的合并、超出错误码上限时的归并，以及 Prometheus 文本导出，
+// 结果不符时以非 0 值退出。以 GERR_STRIP_MESSAGES 编译时同样应当通过
+
+namespace {
+
+constexpr int kCodeA = 1001;
+constexpr int kCodeB = 1002;
+
+int failures = 0;
+
+void Check(bool ok, char const* what) {
+  if (!ok) {
+    std::fprintf(stderr, "FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+std::uint64_t Errors(gerr::RateSnapshot const& snapshot, int code) {
+  for (auto const& sample : snapshot.codes) {
+    if (sample.code == code) {
+      return sample.errors;
+    }
+  }
+  return 0;
+}
+
+void Record(gerr::RateTracker& tracker, std::uint32_t second, int calls,
+            int failed, int code) {
+  for (auto i = 0; i < calls; ++i) {
+    tracker.RecordCodeAt(i < failed ? code : 0, second);
+  }
+}
+
+void CheckWindows() {
+  gerr::RateTracker tracker;
+  std::uint32_t const start = 1000;
+  Record(tracker, start, 10, 2, kCodeA);
+  Record(tracker, start + 5, 10, 5, kCodeB);
+
+  // 正在进行中的这一秒不计入
+  auto snapshot = tracker.SnapshotAt(1, start);
+  Check(snapshot.calls == 0 && snapshot.codes.empty(),
+        "current second is excluded");
+  snapshot = tracker.SnapshotAt(1, start + 1);
+  Check(snapshot.calls == 10 && Errors(snapshot, kCodeA) == 2,
+        "1s window sees the last second");
+  Check(snapshot.codes.size() == 1 && snapshot.codes[0].rate == 0.2,
+        "error rate is errors / calls");
+  snapshot = tracker.SnapshotAt(1, start + 2);
+  Check(snapshot.calls == 0, "1s window drops older seconds");
+
+  snapshot = tracker.SnapshotAt(10, start + 6);
+  Check(snapshot.calls == 20 && Errors(snapshot, kCodeA) == 2 &&
+            Errors(snapshot, kCodeB) == 5,
+        "10s window sums both seconds");
+  Check(snapshot.codes.size() == 2 && snapshot.codes[0].code == kCodeA,
+        "codes are sorted");
+  snapshot = tracker.SnapshotAt(10, start + 11);
+  Check(snapshot.calls == 10 && Errors(snapshot, kCodeA) == 0 &&
+            Errors(snapshot, kCodeB) == 5,
+        "10s window rolls past the first second");
+  snapshot = tracker.SnapshotAt(60, start + 100);
+  Check(snapshot.calls == 0, "stale rows are ignored");
+  snapshot = tracker.SnapshotAt(1000, start + 6);
+  Check(snapshot.seconds == 60 && snapshot.calls == 20,
+        "window is clamped to 60s");
+}
+
+void CheckRingReuse() {
+  gerr::RateTracker tracker;
+  std::uint32_t const start = 2000;
+  auto const rows = static_cast<std::uint32_t>(gerr::details::RateSlot::kRows);
+  Record(tracker, start, 10, 10, kCodeA);
+  // 同一行在 kRows 秒后被复用，先清空再计数
+  Record(tracker, start + rows, 4, 1, kCodeB);
+  auto const snapshot = tracker.SnapshotAt(60, start + rows + 1);
+  Check(snapshot.calls == 4, "reused row is reset");
+  Check(Errors(snapshot, kCodeA) == 0 && Errors(snapshot, kCodeB) == 1,
+        "reused row keeps only new errors");
+
+  // 连续记录超过一圈，每一秒的窗口只看到自己那一秒
+  for (std::uint32_t s = 0; s < rows * 2; ++s) {
+    Record(tracker, start + 100 + s, static_cast<int>(s % 7) + 1, 1, kCodeA);
+  }
+  auto const last = start + 100 + rows * 2 - 1;
+  auto expected = 0;
+  for (std::uint32_t s = last - 9; s <= last; ++s) {
+    expected += static_cast<int>((s - start - 100) % 7) + 1;
+  }
+  auto const window = tracker.SnapshotAt(10, last + 1);
+  Check(window.calls == static_cast<std::uint64_t>(expected) &&
+            Errors(window, kCodeA) == 10,
+        "10s window after wrapping around the ring");
+}
+
+void CheckThreads() {
+  gerr::RateTracker tracker;
+  std::uint32_t const start = 3000;
+  Record(tracker, start, 10, 1, kCodeA);
+  std::thread other{[&] { Record(tracker, start, 30, 3, kCodeA); }};
+  other.join();
+  // 退出的线程留下的计数仍然有效，它的计数器之后被复用
+  std::thread next{[&] { Record(tracker, start + 1, 5, 5, kCodeB); }};
+  next.join();
+  auto const snapshot = tracker.SnapshotAt(10, start + 2);
+  Check(snapshot.calls == 45 && Errors(snapshot, kCodeA) == 4 &&
+            Errors(snapshot, kCodeB) == 5,
+        "threads are merged");
+}
+
+void CheckOverflow() {
+  gerr::RateTracker tracker;
+  std::uint32_t const start = 4000;
+  auto const columns = gerr::details::RateSlot::kColumns;
+  for (auto code = 1; code <= columns + 10; ++code) {
+    tracker.RecordCodeAt(code, start);
+  }
+  auto const snapshot = tracker.SnapshotAt(1, start + 1);
+  Check(snapshot.calls == static_cast<std::uint64_t>(columns + 10),
+        "every call is counted");
+  Check(snapshot.codes.size() == static_cast<std::size_t>(columns),
+        "codes beyond the limit share one column");
+  Check(Errors(snapshot, gerr::RateTracker::kOtherCode) == 11,
+        "overflowing codes go to kOtherCode");
+}
+
+void CheckExport() {
+  gerr::RateTracker tracker;
+  auto const second = gerr::details::RateNowSecond() - 1;
+  Record(tracker, second, 8, 3, kCodeA);
+  auto const text = tracker.PrometheusText("rpc");
+  Check(text.find("# TYPE rpc_calls gauge\n") != std::string::npos,
+        "type lines");
+  Check(text.find("rpc_calls{window=\"10s\"} 8\n") != std::string::npos,
+        "calls line");
+  Check(text.find("rpc_errors{window=\"60s\",code=\"1001\"} 3\n") !=
+            std::string::npos,
+        "errors line");
+  Check(text.find("rpc_error_ratio{window=\"10s\",code=\"1001\"} 0.375\n") !=
+            std::string::npos,
+        "ratio line");
+
+  char const* const path = "gerr_rate_check.prom";
+  Check(tracker.ExportFile(path, "rpc") == nullptr, "export file");
+  std::ifstream in{path};
+  std::ostringstream file;
+  file << in.rdbuf();
+  Check(file.str().find("rpc_calls{window=\"60s\"} 8\n") != std::string::npos,
+        "exported file has the metrics");
+  std::remove(path);
+  Check(tracker.ExportFile("no-such-dir/x.prom") != nullptr,
+        "export to a bad path fails");
+}
+
+}  // namespace
+
+int main() {
+  CheckWindows();
+  CheckRingReuse();
+  CheckThreads();
+  CheckOverflow();
+  CheckExport();
+
+  if (failures != 0) {
+    std::fprintf(stderr, "%d rate check(s) failed\n", failures);
+    return 1;
+  }
+  std::printf("all rate checks passed\n");
+  return 0;
+}
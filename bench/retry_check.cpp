@@ -0,0 +1,241 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <gerr/gerr.hpp>
+#include <gerr/result.hpp>
+#include <gerr/retry.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+// gerr::RetryPolicy 的行为检查：错误分类规则的优先级、重试循环在各种条件下的
+// 停止原因，以及 RetryError 只保留有限的历史，结果不符时以非 0 值退出。
+// 退避通过 Sleeper 记录下来而不是真的等待
+
+namespace {
+
+using std::chrono::milliseconds;
+
+DEFINE_CODE_ERROR(ErrTimeout, 1001, "call timeout");
+DEFINE_CODE_ERROR(ErrAuth, 1002, "not authorized");
+DEFINE_CODE_ERROR(ErrOverload, 5003, "server overloaded");
+
+int failures = 0;
+
+void Check(bool ok, char const* what) {
+  if (!ok) {
+    std::fprintf(stderr, "FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+gerr::RetryPolicy Policy() {
+  return gerr::RetryPolicy{}
+      .RetryOn<ErrTimeout>()
+      .StopOn<ErrAuth>()
+      .RetryOnCodes(5000, 5999)
+      .StopOnCode(5003)
+      .RetryOnDomain("generic");
+}
+
+/** 不真的等待，只记录每次退避的时间 */
+struct Sleeps {
+  std::vector<gerr::RetryPolicy::Duration> delays;
+
+  gerr::RetryPolicy Apply(gerr::RetryPolicy policy) {
+    return policy.Jitter(0)
+        .Backoff(milliseconds{1}, milliseconds{4})
+        .Sleeper([this](gerr::RetryPolicy::Duration d) { delays.push_back(d); });
+  }
+};
+
+bool Classified(gerr::RetryPolicy const& policy, gerr::Error const& err,
+                gerr::RetryClass cls) {
+  return policy.Classify(err) == cls;
+}
+
+void CheckClassify() {
+  using gerr::RetryClass;
+  auto const policy = Policy();
+  Check(Classified(policy, nullptr, RetryClass::kUnknown), "nullptr");
+  Check(Classified(policy, gerr::New(5001, "x"), RetryClass::kRetryable),
+        "code in retry range");
+  Check(Classified(policy, gerr::New(5003, "x"), RetryClass::kPermanent),
+        "stop code overrides retry range");
+  Check(Classified(policy, gerr::New(4000, "x"), RetryClass::kUnknown),
+        "code outside rules");
+  Check(Classified(policy, ErrTimeout::E(), RetryClass::kRetryable),
+        "retry type");
+  Check(Classified(policy, ErrOverload::E(), RetryClass::kPermanent),
+        "type without rule falls back to its code");
+  Check(Classified(policy, gerr::Wrap(ErrTimeout::E(), "query"),
+                   RetryClass::kRetryable),
+        "wrapping without code keeps inner class");
+  Check(Classified(policy, ErrAuth::E(ErrTimeout::E()),
+                   RetryClass::kPermanent),
+        "outer stop type overrides inner retry");
+  Check(Classified(policy, ErrTimeout::E(ErrAuth::E()),
+                   RetryClass::kRetryable),
+        "outer retry type overrides inner stop");
+  Check(Classified(policy, gerr::Wrap(ErrTimeout::E(), 5003),
+                   RetryClass::kPermanent),
+        "outer stop code overrides inner retry");
+  Check(Classified(policy, gerr::FromErrno(ETIMEDOUT)->AsError(),
+                   RetryClass::kRetryable),
+        "errno domain");
+
+  Check(!policy.Retryable(gerr::New(4000, "x")), "unknown is not retried");
+  auto const eager = Policy().RetryUnknown(true);
+  Check(eager.Retryable(gerr::New(4000, "x")), "RetryUnknown(true)");
+  Check(!eager.Retryable(ErrAuth::E()), "RetryUnknown keeps permanent");
+}
+
+void CheckDelay() {
+  auto const policy = gerr::RetryPolicy{}.Jitter(0).Backoff(
+      milliseconds{10}, milliseconds{50}, 3.0);
+  Check(policy.Delay(1) == milliseconds{10}, "first delay is initial");
+  Check(policy.Delay(2) == milliseconds{30}, "second delay is multiplied");
+  Check(policy.Delay(3) == milliseconds{50}, "delay is capped");
+  Check(policy.Delay(10) == milliseconds{50}, "delay stays capped");
+  auto const jittered = gerr::RetryPolicy{}.Jitter(0.5).Backoff(
+      milliseconds{10}, milliseconds{10});
+  for (auto i = 0; i < 100; ++i) {
+    auto const d = jittered.Delay(1);
+    Check(d > milliseconds{5} && d <= milliseconds{10},
+          "jitter shortens by less than the fraction");
+  }
+}
+
+void CheckHistory() {
+  Sleeps sleeps;
+  auto const policy = sleeps.Apply(Policy()).MaxAttempts(7);
+  auto calls = 0;
+  auto const err = policy.Run([&] { return gerr::New(5100 + ++calls, "x"); });
+  Check(calls == 7, "runs MaxAttempts times");
+  Check(sleeps.delays.size() == 6, "sleeps between attempts");
+  Check(sleeps.delays[0] == milliseconds{1} && sleeps.delays[1] ==
+            milliseconds{2} && sleeps.delays[5] == milliseconds{4},
+        "backoff doubles up to max");
+
+  auto const retry = gerr::As<gerr::RetryError>(err);
+  Check(retry != nullptr, "gives a RetryError");
+  if (retry == nullptr) {
+    return;
+  }
+  Check(retry->Attempts() == 7, "counts attempts");
+  Check(retry->Stop() == gerr::RetryStop::kMaxAttempts, "stops on max");
+  Check(retry->Earlier().size() == gerr::RetryError::kMaxKept,
+        "history is bounded");
+  Check(gerr::Code(retry->Earlier().front()) == 5103 &&
+            gerr::Code(retry->Earlier().back()) == 5106,
+        "history keeps the latest attempts in order");
+  Check(gerr::Code(retry->Cause()) == 5107, "last error is the cause");
+  Check(gerr::IsCode(5107, err), "IsCode sees the last error");
+  Check(gerr::String(err).find("gave up after 7 attempts") !=
+            std::string::npos,
+        "message names the attempts");
+}
+
+void CheckStops() {
+  Sleeps sleeps;
+  auto const policy = sleeps.Apply(Policy()).MaxAttempts(5);
+
+  auto calls = 0;
+  auto const auth = ErrAuth::E();
+  auto err = policy.Run([&] {
+    ++calls;
+    return auth;
+  });
+  Check(calls == 1 && err == auth, "permanent first error is returned as is");
+
+  calls = 0;
+  err = policy.Run([&] {
+    return ++calls == 1 ? ErrTimeout::E() : ErrAuth::E();
+  });
+  auto retry = gerr::As<gerr::RetryError>(err);
+  Check(calls == 2 && retry != nullptr &&
+            retry->Stop() == gerr::RetryStop::kPermanent,
+        "stops on a later permanent error");
+
+  calls = 0;
+  err = policy.Run([&] { return ++calls < 3 ? ErrTimeout::E() : nullptr; });
+  Check(calls == 3 && err == nullptr, "succeeds after retries");
+
+  calls = 0;
+  auto const value = policy.Run([&]() -> gerr::Result<int> {
+    if (++calls < 2) {
+      return ErrTimeout::E();
+    }
+    return 42;
+  });
+  Check(value && value.Value() == 42, "Result is retried");
+
+  // 一个令牌，不再存入：只能重试一次
+  auto const budget = std::make_shared<gerr::RetryBudget>(0.0, 1);
+  auto const limited = sleeps.Apply(Policy()).MaxAttempts(5).Budget(budget);
+  calls = 0;
+  err = limited.Run([&] {
+    ++calls;
+    return ErrTimeout::E();
+  });
+  retry = gerr::As<gerr::RetryError>(err);
+  Check(calls == 2 && retry != nullptr &&
+            retry->Stop() == gerr::RetryStop::kBudget,
+        "stops when the budget is exhausted");
+
+  // 退避 10、20、40 毫秒，第三次退避会超过 25 毫秒的截止时间
+  auto const timed = gerr::RetryPolicy{}
+                         .RetryOn<ErrTimeout>()
+                         .Jitter(0)
+                         .Backoff(milliseconds{10}, milliseconds{100})
+                         .Sleeper([](gerr::RetryPolicy::Duration) {})
+                         .MaxAttempts(10)
+                         .Deadline(milliseconds{25});
+  calls = 0;
+  err = timed.Run([&] {
+    ++calls;
+    return ErrTimeout::E();
+  });
+  retry = gerr::As<gerr::RetryError>(err);
+  Check(calls == 3 && retry != nullptr &&
+            retry->Stop() == gerr::RetryStop::kDeadline,
+        "stops before the deadline would pass");
+}
+
+}  // namespace
+
+int main() {
+  CheckClassify();
+  CheckDelay();
+  CheckHistory();
+  CheckStops();
+
+  if (failures != 0) {
+    std::fprintf(stderr, "%d retry check(s) failed\n", failures);
+    return 1;
+  }
+  std::printf("all retry checks passed\n");
+  return 0;
+}
@@ -0,0 +1,158 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#include <benchmark/benchmark.h>
+
+#include <gerr/status.hpp>
+#include <string>
+
+// 最内层解析循环中 int 错误码、gerr::Status<E> 和 gerr::Error 的开销对比。
+// 输入是一串数字，参数为每 1000 个字符中非法字符的个数，解析失败时跳过该字符
+// 继续，模拟需要逐个检查返回值的热点循环。
+
+namespace {
+
+enum class ParseCode { kOk, kBadDigit };
+
+}  // namespace
+
+namespace gerr {
+
+template <>
+struct StatusDomain<ParseCode> {
+  static constexpr char const* Name() { return "parse"; }
+  static char const* Message(ParseCode code) {
+    return code == ParseCode::kBadDigit ? "bad digit" : "";
+  }
+};
+
+}  // namespace gerr
+
+namespace {
+
+static_assert(std::is_trivially_copyable<gerr::Status<ParseCode>>::value,
+              "Status should be trivially copyable");
+static_assert(sizeof(gerr::Status<ParseCode>) <= 2 * sizeof(void*),
+              "Status should fit in two registers");
+
+constexpr int kBadDigit = 1;
+
+std::string MakeInput(int badPerThousand) {
+  std::string s(4096, '7');
+  for (int i = 0; i < badPerThousand * 4; ++i) {
+    s[(i * 997) % s.size()] = 'x';
+  }
+  return s;
+}
+
+__attribute__((noinline)) int ParseInt(char c, int* out) {
+  if (c < '0' || c > '9') {
+    return kBadDigit;
+  }
+  *out = c - '0';
+  return 0;
+}
+
+__attribute__((noinline)) gerr::Status<ParseCode> ParseStatus(char c,
+                                                              int* out) {
+  if (c < '0' || c > '9') {
+    return {ParseCode::kBadDigit, "expect 0-9"};
+  }
+  *out = c - '0';
+  return {};
+}
+
+__attribute__((noinline)) gerr::Error ParseError(char c, int* out) {
+  if (c < '0' || c > '9') {
+    return gerr::New(kBadDigit, "bad digit");
+  }
+  *out = c - '0';
+  return nullptr;
+}
+
+void BM_IntCode(benchmark::State& state) {
+  auto const input = MakeInput(static_cast<int>(state.range(0)));
+  for (auto _ : state) {
+    int sum = 0, d = 0, bad = 0;
+    for (auto c : input) {
+      if (ParseInt(c, &d) != 0) {
+        ++bad;
+        continue;
+      }
+      sum += d;
+    }
+    benchmark::DoNotOptimize(sum);
+    benchmark::DoNotOptimize(bad);
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_IntCode)->Arg(0)->Arg(10)->Arg(100);
+
+void BM_Status(benchmark::State& state) {
+  auto const input = MakeInput(static_cast<int>(state.range(0)));
+  for (auto _ : state) {
+    int sum = 0, d = 0, bad = 0;
+    for (auto c : input) {
+      if (ParseStatus(c, &d).IsFailure()) {
+        ++bad;
+        continue;
+      }
+      sum += d;
+    }
+    benchmark::DoNotOptimize(sum);
+    benchmark::DoNotOptimize(bad);
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_Status)->Arg(0)->Arg(10)->Arg(100);
+
+void BM_Error(benchmark::State& state) {
+  auto const input = MakeInput(static_cast<int>(state.range(0)));
+  for (auto _ : state) {
+    int sum = 0, d = 0, bad = 0;
+    for (auto c : input) {
+      if (ParseError(c, &d) != nullptr) {
+        ++bad;
+        continue;
+      }
+      sum += d;
+    }
+    benchmark::DoNotOptimize(sum);
+    benchmark::DoNotOptimize(bad);
+  }
+  state.SetItemsProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_Error)->Arg(0)->Arg(10)->Arg(100);
+
+// 失败跨越到需要 Wrap 的上层时才转换为 gerr::Error
+void BM_StatusToError(benchmark::State& state) {
+  int d = 0;
+  for (auto _ : state) {
+    auto err = gerr::Wrap(ParseStatus('x', &d), "parse input");
+    benchmark::DoNotOptimize(err);
+  }
+}
+BENCHMARK(BM_StatusToError);
+
+}  // namespace
+
+BENCHMARK_MAIN();
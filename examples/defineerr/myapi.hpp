@@ -22,6 +22,8 @@
 //
 #pragma once
 
+#include <cstddef>
+#include <functional>
 #include <gerr/gerr.hpp>
 #include <random>
 #include <utility>
@@ -37,10 +39,31 @@ struct LERandErrorContext {
   int randNum1;
   int randNum2;
 };
-// 定义 error 类型，附带错误环境信息
-DEFINE_CONTEXT_ERROR(ErrLERandNum1, LERandErrorContext,
-                     "Random num is illegal, rand val1: {}, rand val2: {}",
-                     context.randNum1, context.randNum2);
+
+inline bool operator==(LERandErrorContext const& lhs,
+                       LERandErrorContext const& rhs) {
+  return lhs.randNum1 == rhs.randNum1 && lhs.randNum2 == rhs.randNum2;
+}
+
+}  // namespace fake
+
+namespace std {
+template <>
+struct hash<fake::LERandErrorContext> {
+  size_t operator()(fake::LERandErrorContext const& context) const {
+    return static_cast<size_t>(context.randNum1) * 31 +
+           static_cast<size_t>(context.randNum2);
+  }
+};
+}  // namespace std
+
+namespace fake {
+
+// 定义 error 类型，附带错误环境信息；环境信息只有十几种取值，
+// 使用 MEMO 版本，相同的环境信息会复用同一个错误节点
+DEFINE_MEMO_CONTEXT_ERROR(ErrLERandNum1, LERandErrorContext,
+                          "Random num is illegal, rand val1: {}, rand val2: {}",
+                          context.randNum1, context.randNum2);
 
 // 定义 error 类型，附带错误码和错误环境信息
 DEFINE_CODE_CONTEXT_ERROR(ErrLERandNum2, 1000002, LERandErrorContext,
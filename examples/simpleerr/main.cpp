@@ -30,7 +30,8 @@ gerr::Error CheckArgumentValue(char const* arg) {
   try {
     std::stoi(arg);
   } catch (std::exception const& e) {
-    return gerr::New("conv exception:{}", arg, e.what());
+    // 使用 GERR_FMT 时占位符和参数的个数在编译期检查，不一致时无法编译
+    return gerr::New(GERR_FMT("conv exception({}):{}"), arg, e.what());
   }
   return nullptr;
 }
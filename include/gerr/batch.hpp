@@ -0,0 +1,269 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <gerr/gerr.hpp>
+#include <gerr/result.hpp>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace gerr {
+
+namespace details {
+
+inline int PopCount(std::uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(word);
+#else
+  word = word - ((word >> 1) & 0x5555555555555555ull);
+  word = (word & 0x3333333333333333ull) + ((word >> 2) & 0x3333333333333333ull);
+  word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0full;
+  return static_cast<int>((word * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+/** word 不能为 0 */
+inline int LowestBit(std::uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzll(word);
+#else
+  int n = 0;
+  for (; (word & 1) == 0; word >>= 1) {
+    ++n;
+  }
+  return n;
+#endif
+}
+
+}  // namespace details
+
+/**
+ * 按列保存一批数据的逐行错误，用于一批处理上百万行、只有少数几行失败的场景。
+ * 和 std::vector<gerr::Result<T>> 相比，每行只占 1 bit 的失败位图和 4 字节的错误码，
+ * 完整的 gerr::Error 只为调用了 Fail 的行保存在一个按行号排序的稀疏表中，
+ * 释放时也不需要逐行析构空的 Error。错误码列只在失败的行上有意义，
+ * 因此 Reset 只需要清空位图。行号 row 必须小于 Size()。
+ *
+ * CountFailed / CodeHistogram / ForEachFailure 按 64 行一个字扫描位图，
+ * 整字为 0 的部分直接跳过。不是线程安全的，多个线程处理同一批数据时
+ * 各自使用一个 ErrorBatch，或者按 64 行对齐切分行号区间；Error 和
+ * ForEachFailure 会缓存只带错误码的节点，也不能在多个线程中同时调用。
+ * Example:
+ *   gerr::ErrorBatch errors{rows.size()};
+ *   std::vector<Parsed> parsed(rows.size());
+ *   for (std::size_t i = 0; i < rows.size(); ++i) {
+ *       if (!Parse(rows[i], &parsed[i])) {
+ *           errors.FailCode(i, kBadRow);
+ *       }
+ *   }
+ *   for (auto const& bucket : errors.CodeHistogram()) { ... }
+ *   return errors.ToResult(std::move(parsed));
+ */
+class ErrorBatch {
+ public:
+  explicit ErrorBatch(std::size_t rows = 0) { Reset(rows); }
+
+  /** 重新开始一批 rows 行的数据，已经分配的内存会被复用 */
+  void Reset(std::size_t rows) {
+    auto const words = (rows + 63) / 64;
+    if (rows > capacity_) {
+      codes_.reset(new std::int32_t[rows]);
+      capacity_ = rows;
+    }
+    bits_.assign(words, 0);
+    errors_.clear();
+    rows_ = rows;
+  }
+
+  std::size_t Size() const noexcept { return rows_; }
+
+  /** 将 row 行标记为失败，记录完整的错误；err 为 nullptr 时不做任何事 */
+  void Fail(std::size_t row, ::gerr::Error err) {
+    if (err == nullptr) {
+      return;
+    }
+    auto const code = ::gerr::Code(err);
+    auto it = errors_.end();
+    if (!errors_.empty() && errors_.back().first >= row) {
+      it = std::lower_bound(
+          errors_.begin(), errors_.end(), row,
+          [](Entry const& entry, std::size_t r) { return entry.first < r; });
+    }
+    if (it != errors_.end() && it->first == row) {
+      it->second = std::move(err);
+    } else {
+      errors_.emplace(it, row, std::move(err));
+    }
+    FailCode(row, code);
+  }
+
+  /** 将 row 行标记为失败，只记录错误码，不创建错误节点 */
+  void FailCode(std::size_t row, int code) noexcept {
+    bits_[row / 64] |= std::uint64_t{1} << (row % 64);
+    codes_[row] = code;
+  }
+
+  bool Failed(std::size_t row) const noexcept {
+    return (bits_[row / 64] >> (row % 64) & 1) != 0;
+  }
+
+  /** row 行的错误码，成功的行返回 0 */
+  int Code(std::size_t row) const noexcept {
+    return Failed(row) ? codes_[row] : 0;
+  }
+
+  /**
+   * row 行的错误，成功的行返回 nullptr。只通过 FailCode 标记的行返回一个
+   * 只带错误码的节点，同一个 ErrorBatch 中错误码相同的行共享一个节点，
+   * 每个错误码只在第一次查询时分配一次。
+   */
+  ::gerr::Error Error(std::size_t row) const {
+    if (!Failed(row)) {
+      return nullptr;
+    }
+    auto const it = std::lower_bound(
+        errors_.begin(), errors_.end(), row,
+        [](Entry const& entry, std::size_t r) { return entry.first < r; });
+    if (it != errors_.end() && it->first == row) {
+      return it->second;
+    }
+    return CodeError(codes_[row]);
+  }
+
+  std::size_t CountFailed() const noexcept {
+    std::size_t n = 0;
+    for (auto const word : bits_) {
+      n += static_cast<std::size_t>(details::PopCount(word));
+    }
+    return n;
+  }
+
+  /** 按错误码统计失败的行数，结果按错误码排序 */
+  std::vector<std::pair<int, std::size_t>> CodeHistogram() const {
+    std::vector<std::pair<int, std::size_t>> histogram;
+    ForEachFailedRow([&](std::size_t row) {
+      auto const code = codes_[row];
+      // 一批数据中不同的错误码通常只有几个，线性查找比哈希表更快
+      auto it = std::find_if(histogram.begin(), histogram.end(),
+                             [code](std::pair<int, std::size_t> const& b) {
+                               return b.first == code;
+                             });
+      if (it == histogram.end()) {
+        histogram.emplace_back(code, 1);
+      } else {
+        ++it->second;
+      }
+    });
+    std::sort(histogram.begin(), histogram.end());
+    return histogram;
+  }
+
+  /**
+   * 按行号顺序遍历失败的行，fn 的参数为 (std::size_t row, gerr::Error const& err)，
+   * err 同 Error(row)。
+   */
+  template <class Fn>
+  void ForEachFailure(Fn fn) const {
+    auto it = errors_.begin();
+    ForEachFailedRow([&](std::size_t row) {
+      while (it != errors_.end() && it->first < row) {
+        ++it;
+      }
+      if (it != errors_.end() && it->first == row) {
+        fn(row, it->second);
+      } else {
+        fn(row, CodeError(codes_[row]));
+      }
+    });
+  }
+
+  /**
+   * 合并为一个错误：没有失败的行时返回 nullptr，否则包装第一个失败的行的错误，
+   * 错误信息中带上失败的行数，gerr::Code 等查询得到的是第一个失败的行的错误码。
+   */
+  ::gerr::Error ToError() const {
+    for (std::size_t i = 0; i < bits_.size(); ++i) {
+      if (bits_[i] != 0) {
+        auto const row = i * 64 + details::LowestBit(bits_[i]);
+        return Wrap(Error(row), "{} of {} rows failed, first at row {}",
+                    CountFailed(), rows_, row);
+      }
+    }
+    return nullptr;
+  }
+
+  /** 没有失败的行时返回 values，否则返回 ToError() */
+  template <class ValueType>
+  Result<std::vector<ValueType>> ToResult(std::vector<ValueType> values) const {
+    auto err = ToError();
+    if (err != nullptr) {
+      return err;
+    }
+    return Result<std::vector<ValueType>>{std::move(values)};
+  }
+
+ private:
+  using Entry = std::pair<std::size_t, ::gerr::Error>;
+
+  static constexpr char const* kRowFailed = "row failed";
+
+  /**
+   * 只带错误码的行使用的节点。错误码通常来自数据，不使用全局的
+   * StaticCodeError 表，以免不同的错误码把它占满；节点缓存在本批数据中，
+   * Reset 之后仍然复用。
+   */
+  ::gerr::Error const& CodeError(int code) const {
+    // 一批数据中不同的错误码通常只有几个，线性查找比哈希表更快
+    for (auto const& entry : codeErrors_) {
+      if (entry.first == code) {
+        return entry.second;
+      }
+    }
+    codeErrors_.emplace_back(
+        code, details::MakeShared<details::CodeRawStrMessageError>(code,
+                                                                   kRowFailed));
+    return codeErrors_.back().second;
+  }
+
+  template <class Fn>
+  void ForEachFailedRow(Fn fn) const {
+    for (std::size_t i = 0; i < bits_.size(); ++i) {
+      for (auto word = bits_[i]; word != 0; word &= word - 1) {
+        fn(i * 64 + static_cast<std::size_t>(details::LowestBit(word)));
+      }
+    }
+  }
+
+  std::size_t rows_{};
+  std::size_t capacity_{};
+  std::vector<std::uint64_t> bits_;
+  std::unique_ptr<std::int32_t[]> codes_;
+  std::vector<Entry> errors_;
+  mutable std::vector<std::pair<int, ::gerr::Error>> codeErrors_;
+};
+
+}  // namespace gerr
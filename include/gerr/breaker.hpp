@@ -0,0 +1,318 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <gerr/exception.hpp>
+#include <gerr/gerr.hpp>
+#include <gerr/result.hpp>
+#include <typeinfo>
+#include <utility>
+
+namespace gerr {
+
+/** gerr::CircuitBreaker 处于打开状态时返回的常驻错误 */
+DEFINE_ERROR(ErrCircuitOpen, "circuit breaker is open");
+
+/** gerr::CircuitBreaker 按什么区分不同的失败 */
+enum class CircuitKey {
+  kCode,         // gerr::Code(err)
+  kType,         // 错误链条最底层节点的类型，即根本原因的类型
+  kFingerprint,  // 错误链条的形状，即 gerr::ShapeHash
+};
+
+enum class CircuitState { kClosed, kOpen, kHalfOpen };
+
+namespace details {
+
+/**
+ * 无锁的滑动窗口计数器，窗口被划分为 kBuckets 个桶，每个桶的序号和计数
+ * 打包在一个 64 位原子变量中，桶过期后由第一个写入者通过 CAS 重置。
+ */
+class CircuitWindow {
+ public:
+  static constexpr int kBuckets = 10;
+
+  void Add(std::uint32_t epoch) noexcept {
+    auto& bucket = buckets_[epoch % kBuckets];
+    auto value = bucket.load(std::memory_order_relaxed);
+    for (;;) {
+      auto const next = static_cast<std::uint32_t>(value >> 32) == epoch
+                            ? value + 1
+                            : (static_cast<std::uint64_t>(epoch) << 32) | 1;
+      if (bucket.compare_exchange_weak(value, next,
+                                       std::memory_order_relaxed)) {
+        return;
+      }
+    }
+  }
+
+  std::uint64_t Sum(std::uint32_t epoch) const noexcept {
+    std::uint64_t sum = 0;
+    for (auto const& bucket : buckets_) {
+      auto const value = bucket.load(std::memory_order_relaxed);
+      if (epoch - static_cast<std::uint32_t>(value >> 32) <
+          static_cast<std::uint32_t>(kBuckets)) {
+        sum += value & 0xffffffffu;
+      }
+    }
+    return sum;
+  }
+
+  void Reset() noexcept {
+    for (auto& bucket : buckets_) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+  }
+
+ private:
+  std::atomic<std::uint64_t> buckets_[kBuckets]{};
+};
+
+}  // namespace details
+
+/**
+ * 熔断器：下游持续失败时快速失败，而不是继续堆积请求。
+ *
+ * 每次调用的结果通过 Record 上报，失败按 CircuitKey 分组，每组在一个无锁的
+ * 滑动窗口中计数；任意一组失败占窗口内总调用数的比例达到阈值（且调用数不少于
+ * minCalls）时熔断器打开，此后 Allow 直接返回常驻的 ErrCircuitOpen::E()。
+ * 打开 openFor 之后，第一个调用 Allow 的线程通过 CAS 获得唯一的探测机会
+ * （半开状态），其余调用继续被拒绝；探测成功时关闭并清空窗口，失败时重新打开。
+ * 探测者在 openFor 之内没有上报结果时，下一个调用者会接替探测。
+ *
+ * 关闭状态下 Allow 只有一次原子读。不同的键最多 kMaxKeys 种，
+ * 超出的键共享最后一个窗口。
+ * Example:
+ *   static gerr::CircuitBreaker breaker{gerr::CircuitKey::kCode};
+ *
+ *   gerr::Error CallDownstream(Request const& req) {
+ *       return breaker.Call([&] { return client.Call(req); });
+ *   }
+ */
+class CircuitBreaker {
+ public:
+  using Duration = std::chrono::nanoseconds;
+
+  static constexpr int kMaxKeys = 32;
+
+  struct Options {
+    double failureRatio = 0.5;
+    std::uint64_t minCalls = 20;
+    Duration window = std::chrono::seconds{10};
+    Duration openFor = std::chrono::seconds{5};
+    /** 返回 true 的错误不算作失败，例如参数错误、记录不存在 */
+    std::function<bool(ErrorView)> ignore;
+  };
+
+  explicit CircuitBreaker(CircuitKey key = CircuitKey::kCode)
+      : CircuitBreaker{key, Options{}} {}
+  CircuitBreaker(CircuitKey key, Options options)
+      : key_{key}, options_{std::move(options)} {
+    bucketNs_ = options_.window.count() / details::CircuitWindow::kBuckets;
+    if (bucketNs_ <= 0) {
+      bucketNs_ = 1;
+    }
+  }
+
+  CircuitBreaker(CircuitBreaker const&) = delete;
+  CircuitBreaker& operator=(CircuitBreaker const&) = delete;
+
+  /**
+   * 是否可以发起调用，可以时返回 nullptr，否则返回 ErrCircuitOpen::E()。
+   * probe 不为空时，输出本次调用是否是半开状态下的探测，需要原样传给 Record。
+   */
+  Error Allow(bool* probe = nullptr) noexcept {
+    auto state = state_.load(std::memory_order_relaxed);
+    if (state == kClosed) {
+      return nullptr;
+    }
+    return AllowSlow(state, probe);
+  }
+
+  /** 上报一次调用的结果，err 为 nullptr 表示成功 */
+  void Record(ErrorView err, bool probe = false) noexcept {
+    auto const failed =
+        err != nullptr && !(options_.ignore && options_.ignore(err));
+    if (probe) {
+      FinishProbe(failed);
+      return;
+    }
+    auto const now = NowNs();
+    auto const epoch = static_cast<std::uint32_t>(now / bucketNs_);
+    calls_.Add(epoch);
+    if (!failed) {
+      return;
+    }
+    auto& window = Slot(KeyOf(err));
+    window.Add(epoch);
+    if (state_.load(std::memory_order_relaxed) != kClosed) {
+      return;
+    }
+    auto const calls = calls_.Sum(epoch);
+    if (calls >= options_.minCalls &&
+        static_cast<double>(window.Sum(epoch)) >=
+            options_.failureRatio * static_cast<double>(calls)) {
+      auto expected = kClosed;
+      state_.compare_exchange_strong(expected, Pack(now, CircuitState::kOpen),
+                                     std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * 经过熔断器调用 fn，fn 返回 gerr::Error 或者 gerr::Result<T>，
+   * 打开时不调用 fn，直接返回 ErrCircuitOpen::E()。fn 抛出的异常经
+   * gerr::FromCurrentException 转换后记为一次失败，然后原样抛出。
+   */
+  template <class Fn>
+  auto Call(Fn&& fn) -> decltype(fn()) {
+    auto probe = false;
+    auto err = Allow(&probe);
+    if (err != nullptr) {
+      return decltype(fn()){std::move(err)};
+    }
+    // fn 抛出异常时把异常转换为错误按失败上报后继续抛出，
+    // 避免半开状态的探测永远没有结果，也不会和熔断打开的拒绝混在一起
+    auto result = [&]() -> decltype(fn()) {
+      try {
+        return fn();
+      } catch (...) {
+        Record(FromCurrentException(), probe);
+        throw;
+      }
+    }();
+    Record(details::ErrorOf(result), probe);
+    return result;
+  }
+
+  CircuitState State() const noexcept {
+    return static_cast<CircuitState>(state_.load(std::memory_order_relaxed) &
+                                     3);
+  }
+
+ private:
+  // state_ 的低 2 位是 CircuitState，其余位是进入该状态的时间（纳秒），
+  // 关闭状态恒为 0，因此关闭时的判断只是和 0 比较
+  static constexpr std::uint64_t kClosed = 0;
+
+  static std::uint64_t Pack(std::int64_t now, CircuitState state) {
+    return (static_cast<std::uint64_t>(now) << 2) |
+           static_cast<std::uint64_t>(state);
+  }
+
+  static std::int64_t NowNs() {
+    // 加 1 保证打开状态的时间戳不为 0
+    return std::chrono::duration_cast<Duration>(
+               std::chrono::steady_clock::now().time_since_epoch())
+               .count() +
+           1;
+  }
+
+  Error AllowSlow(std::uint64_t state, bool* probe) noexcept {
+    auto const since = static_cast<std::int64_t>(state >> 2);
+    auto const now = NowNs();
+    if (now - since < options_.openFor.count() ||
+        !state_.compare_exchange_strong(state,
+                                        Pack(now, CircuitState::kHalfOpen),
+                                        std::memory_order_relaxed)) {
+      return ErrCircuitOpen::E();
+    }
+    if (probe != nullptr) {
+      *probe = true;
+    }
+    return nullptr;
+  }
+
+  void FinishProbe(bool failed) noexcept {
+    auto state = state_.load(std::memory_order_relaxed);
+    if ((state & 3) != static_cast<std::uint64_t>(CircuitState::kHalfOpen)) {
+      return;
+    }
+    if (failed) {
+      state_.compare_exchange_strong(state,
+                                     Pack(NowNs(), CircuitState::kOpen),
+                                     std::memory_order_relaxed);
+      return;
+    }
+    calls_.Reset();
+    for (auto& slot : slots_) {
+      slot.window.Reset();
+    }
+    state_.compare_exchange_strong(state, kClosed, std::memory_order_relaxed);
+  }
+
+  std::uint64_t KeyOf(ErrorView err) const {
+    std::uint64_t key = 0;
+    switch (key_) {
+      case CircuitKey::kCode:
+        key = static_cast<std::uint32_t>(Code(err));
+        break;
+      case CircuitKey::kType: {
+        auto p = err.Get();
+        while (p->Cause() != nullptr) {
+          p = p->Cause().get();
+        }
+        key = typeid(*p).hash_code();
+        break;
+      }
+      case CircuitKey::kFingerprint:
+        key = ShapeHash(err);
+        break;
+    }
+    // 0 表示空槽位
+    return key == 0 ? 1 : key;
+  }
+
+  details::CircuitWindow& Slot(std::uint64_t key) noexcept {
+    auto const start = static_cast<int>((key * 0x9e3779b97f4a7c15ull) >> 59);
+    for (int i = 0; i < kMaxKeys - 1; ++i) {
+      auto& slot = slots_[(start + i) % (kMaxKeys - 1)];
+      auto current = slot.key.load(std::memory_order_relaxed);
+      if (current == 0 && slot.key.compare_exchange_strong(
+                              current, key, std::memory_order_relaxed)) {
+        return slot.window;
+      }
+      if (current == key) {
+        return slot.window;
+      }
+    }
+    return slots_[kMaxKeys - 1].window;
+  }
+
+  struct KeySlot {
+    std::atomic<std::uint64_t> key{0};
+    details::CircuitWindow window;
+  };
+
+  CircuitKey key_;
+  Options options_;
+  std::int64_t bucketNs_{};
+  std::atomic<std::uint64_t> state_{kClosed};
+  details::CircuitWindow calls_;
+  KeySlot slots_[kMaxKeys];
+};
+
+}  // namespace gerr
@@ -0,0 +1,193 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#pragma once
+
+#include <exception>
+#include <gerr/gerr.hpp>
+#include <gerr/result.hpp>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+namespace gerr {
+
+/**
+ * 持有一个 gerr::Error 的异常，用于需要把错误通过异常抛出的场合，
+ * 例如穿过一个只能通过异常报告失败的回调。
+ * 构造和抛出时不会格式化错误，what() 的内容在第一次调用时才生成。
+ * Example:
+ *   lib.ForEach([&](Item const& item) {
+ *       auto err = Handle(item);
+ *       if (err != nullptr) {
+ *           throw gerr::Exception{err};
+ *       }
+ *   });
+ */
+class Exception : public std::exception {
+ public:
+  explicit Exception(::gerr::Error err) noexcept : error_{std::move(err)} {}
+  Exception(Exception const& src) noexcept : error_{src.error_} {}
+
+  char const* what() const noexcept override {
+    once_.Call([this] {
+      try {
+        what_ = String(error_);
+      } catch (...) {
+      }
+    });
+    return what_.empty() ? "gerr::Exception" : what_.c_str();
+  }
+
+  ::gerr::Error const& Error() const noexcept { return error_; }
+
+ private:
+  ::gerr::Error error_{};
+  details::RenderOnce once_{};
+  mutable std::string what_{};
+};
+
+namespace details {
+
+/**
+ * 从异常转换而来的错误，持有原异常对象，错误信息复制自异常的 what()：
+ * exception_ptr 持有的可能是异常的副本（例如 MSVC），catch 块结束后
+ * 原对象的 what() 就可能失效。来自 std::system_error 时还会保留其错误码，
+ * gerr::Code 和 gerr::ToErrorCode 对其有效。
+ */
+class ExceptionError : public IError, public ErrorCodeSource {
+ public:
+  ExceptionError(std::exception_ptr ptr, char const* what,
+                 std::error_code const& ec = {})
+      : exception_{std::move(ptr)}, what_{what}, ec_{ec} {}
+
+  int Code() const override { return ec_.value(); }
+  char const* Message() const override { return what_.c_str(); }
+  std::error_code ErrorCode() const override { return ec_; }
+
+  std::size_t HeapUsage() const override { return StringHeapUsage(what_); }
+
+  std::exception_ptr const& Exception() const { return exception_; }
+
+ private:
+  std::exception_ptr exception_{};
+  std::string what_{};
+  std::error_code ec_{};
+};
+
+}  // namespace details
+
+/**
+ * 在 catch 块中将正在处理的异常转换为 gerr::Error，不需要重新抛出异常：
+ *   gerr::Exception 直接返回其持有的错误；
+ *   std::system_error 保留其错误码和 what()；
+ *   其他 std::exception 保留其 what()。
+ * 只能在 catch 块中调用，e 必须是当前正在处理的异常。
+ * Example:
+ *   try {
+ *       v = std::stoi(s);
+ *   } catch (std::exception const& e) {
+ *       return gerr::Wrap(gerr::FromException(e), "parse {}", s);
+ *   }
+ */
+inline Error FromException(std::exception const& e) noexcept {
+  if (auto p = dynamic_cast<Exception const*>(&e)) {
+    return p->Error();
+  }
+  if (auto p = dynamic_cast<std::system_error const*>(&e)) {
+    return Make<details::ExceptionError>(std::current_exception(), e.what(),
+                                         p->code());
+  }
+  return Make<details::ExceptionError>(std::current_exception(), e.what());
+}
+
+/**
+ * 将当前正在处理的异常转换为 gerr::Error，用于 catch (...) 块中，
+ * 规则同 gerr::FromException，非 std::exception 的异常使用固定的错误信息。
+ * 不在 catch 块中调用时返回 nullptr。
+ * 需要重新抛出一次异常来获取其类型，已知是 std::exception 时优先使用
+ * gerr::FromException。
+ */
+inline Error FromCurrentException() noexcept {
+  auto ptr = std::current_exception();
+  if (ptr == nullptr) {
+    return nullptr;
+  }
+  try {
+    std::rethrow_exception(ptr);
+  } catch (std::exception const& e) {
+    return FromException(e);
+  } catch (...) {
+    return Make<details::ExceptionError>(std::move(ptr), "unknown exception");
+  }
+}
+
+namespace details {
+
+template <class Fn, class... Args>
+auto InvokeImpl(std::true_type, Fn&& fn, Args&&... args) -> Error {
+  try {
+    std::forward<Fn>(fn)(std::forward<Args>(args)...);
+    return nullptr;
+  } catch (std::exception const& e) {
+    return FromException(e);
+  } catch (...) {
+    return FromCurrentException();
+  }
+}
+
+template <class Fn, class... Args>
+auto InvokeImpl(std::false_type, Fn&& fn, Args&&... args)
+    -> Result<decltype(std::forward<Fn>(fn)(std::forward<Args>(args)...))> {
+  try {
+    return std::forward<Fn>(fn)(std::forward<Args>(args)...);
+  } catch (std::exception const& e) {
+    return FromException(e);
+  } catch (...) {
+    return FromCurrentException();
+  }
+}
+
+}  // namespace details
+
+/**
+ * 调用一个可能抛出异常的函数，将异常转换为错误。
+ * fn 返回 void 时返回 gerr::Error，否则返回 gerr::Result<返回值类型>。
+ * Example:
+ *   auto res = gerr::Invoke([&] { return std::stoi(s); });
+ *   if (!res) {
+ *       return gerr::Wrap(res.Error(), "parse {}", s);
+ *   }
+ */
+template <class Fn, class... Args>
+auto Invoke(Fn&& fn, Args&&... args) -> decltype(details::InvokeImpl(
+    std::is_void<decltype(std::forward<Fn>(fn)(
+        std::forward<Args>(args)...))>{},
+    std::forward<Fn>(fn), std::forward<Args>(args)...)) {
+  return details::InvokeImpl(
+      std::is_void<decltype(std::forward<Fn>(fn)(
+          std::forward<Args>(args)...))>{},
+      std::forward<Fn>(fn), std::forward<Args>(args)...);
+}
+
+}  // namespace gerr
@@ -0,0 +1,1021 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#pragma once
+
+// gerr 的非模板实现。header-only 模式下由 gerr.hpp 在末尾包含，
+// 定义 GERR_COMPILED_LIB 时只在 src/gerr.cpp 中编译一次。
+
+#ifdef GERR_COMPILED_LIB
+#include <gerr/gerr.hpp>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <sstream>
+#include <typeinfo>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef GERR_TRACK_LIVE
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#if defined(__GLIBC__)
+#include <execinfo.h>
+#endif
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#endif
+#endif
+
+namespace gerr {
+
+namespace details {
+
+GERR_INLINE Error const& NoError() {
+  static Error noError = nullptr;
+  return noError;
+}
+
+GERR_INLINE std::ostream& operator<<(std::ostream& os, IError const& err) {
+  for (auto p = &err;;) {
+    auto const c = p->Code();
+    auto const msg = p->Message();
+    auto const hasMsg = msg != nullptr && msg[0] != '\0';
+    if (c != 0 && hasMsg) {
+      // 同时持有非 0 的 code 和 message，同时打印
+      os << c << ":" << msg;
+    } else if (c == 0) {
+      // 如果 code == 0，就只打印 message
+      os << msg;
+    } else {  // c != 0 && !hasMsg
+      // 如果 message 是空，就只打印 code
+      os << std::to_string(c);
+    }
+    auto const& next = p->Cause();
+    if (next != nullptr) {
+      os << ":";
+      p = next.get();
+    } else {
+      break;
+    }
+  }
+  return os;
+}
+
+GERR_INLINE Error FindCode(int code, Error const& err) {
+  for (auto p = &err; *p != nullptr; p = &(*p)->Cause()) {
+    if ((*p)->Code() == code) {
+      return *p;
+    }
+  }
+  return nullptr;
+}
+
+GERR_INLINE int FirstCode(IError const& err, int defaultErrCode) {
+  for (auto p = &err; p != nullptr; p = p->Cause().get()) {
+    auto const c = p->Code();
+    if (c != 0) {
+      return c;
+    }
+  }
+  return defaultErrCode;
+}
+
+GERR_INLINE std::string ToString(IError const& err) {
+  std::ostringstream oss{};
+  oss << err;
+  return oss.str();
+}
+
+GERR_INLINE std::string VFormat(fmt::string_view formatStr,
+                                fmt::format_args args) {
+  try {
+    return fmt::vformat(formatStr, args);
+  } catch (fmt::format_error const&) {
+    return std::string{formatStr.data(), formatStr.size()};
+  }
+}
+
+GERR_INLINE void PinImmortal(Error* holder) noexcept {
+  // 有意泄漏一个引用，节点在进程退出时也不会被析构，
+  // 避免静态对象的析构顺序导致其他地方持有的 Error 失效
+  (void)holder;
+}
+
+GERR_INLINE Error MakeImmortal(Error owner) {
+  auto const p = owner.get();
+  PinImmortal(new Error(std::move(owner)));
+  return Error{Error{}, p};
+}
+
+/** 各个错误类型的节点大小，开放寻址，只插入不删除 */
+class NodeSizeTable {
+ public:
+  static NodeSizeTable& Instance() noexcept {
+    static typename std::aligned_storage<sizeof(NodeSizeTable),
+                                         alignof(NodeSizeTable)>::type storage;
+    static auto const table = new (&storage) NodeSizeTable{};
+    return *table;
+  }
+
+  void Register(std::type_info const& type, std::size_t bytes) noexcept {
+    for (std::size_t n = 0, i = Hash(type); n < kCapacity;
+         ++n, i = (i + 1) % kCapacity) {
+      std::type_info const* expected = nullptr;
+      if (slots_[i].type.compare_exchange_strong(expected, &type,
+                                                 std::memory_order_acq_rel) ||
+          *expected == type) {
+        slots_[i].bytes.store(bytes, std::memory_order_release);
+        return;
+      }
+    }
+  }
+
+  std::size_t Find(std::type_info const& type) const noexcept {
+    for (std::size_t n = 0, i = Hash(type); n < kCapacity;
+         ++n, i = (i + 1) % kCapacity) {
+      auto const t = slots_[i].type.load(std::memory_order_acquire);
+      if (t == nullptr) {
+        return 0;
+      }
+      if (*t == type) {
+        return slots_[i].bytes.load(std::memory_order_acquire);
+      }
+    }
+    return 0;
+  }
+
+ private:
+  static constexpr std::size_t kCapacity = 1024;
+
+  struct Slot {
+    std::atomic<std::type_info const*> type{};
+    std::atomic<std::size_t> bytes{};
+  };
+
+  static std::size_t Hash(std::type_info const& type) noexcept {
+    return type.hash_code() % kCapacity;
+  }
+
+  Slot slots_[kCapacity];
+};
+
+GERR_INLINE void RegisterNodeSize(std::type_info const& type,
+                                  std::size_t bytes) noexcept {
+  NodeSizeTable::Instance().Register(type, bytes);
+}
+
+GERR_INLINE std::size_t NodeSize(std::type_info const& type) noexcept {
+  return NodeSizeTable::Instance().Find(type);
+}
+
+GERR_INLINE std::size_t ChainMemoryUsage(Error const& err) {
+  std::size_t total = 0;
+  for (auto p = &err; *p != nullptr; p = &(*p)->Cause()) {
+    if (p->use_count() == 0) {
+      // 没有控制块的是常驻节点，它和它的父错误都不归这条链条所有
+      break;
+    }
+    auto const& node = **p;
+    total += NodeSize(typeid(node)) + node.HeapUsage();
+  }
+  return total;
+}
+
+/**
+ * New / Wrap 创建的节点，这些类型之间只是错误码、错误信息和父错误的存储方式不同，
+ * 比较和哈希错误链条时视为同一种类型
+ */
+inline bool PlainNodeType(std::type_info const& type) {
+  return type == typeid(RawStrMessageError) || type == typeid(MessageError) ||
+         type == typeid(CodeRawStrMessageError) ||
+         type == typeid(CodeMessageError) || type == typeid(CodeSubError) ||
+         type == typeid(RawStrMessageSubError) ||
+         type == typeid(MessageSubError) ||
+         type == typeid(CodeRawStrMessageSubError) ||
+         type == typeid(CodeMessageSubError);
+}
+
+/** 节点的内容是否完全由类型、错误码和错误信息决定，只有这样的节点才参与 Intern */
+inline bool InternableNode(IError const& node) {
+  auto const& type = typeid(node);
+  return PlainNodeType(type) || type == typeid(ErrnoError) ||
+         dynamic_cast<StaticDefinedError const*>(&node) != nullptr;
+}
+
+/**
+ * Intern 的登记表，按哈希值分片，每个分片一把锁，只持有弱引用。
+ * 失效的弱引用仍然持有 allocate_shared 的整块内存，因此每次登记都顺带清理
+ * 固定数量的桶，轮流扫过整个分片，不会等到分片增长之后才一次性清理。
+ */
+class InternTable {
+ public:
+  static InternTable& Instance() {
+    static typename std::aligned_storage<sizeof(InternTable),
+                                         alignof(InternTable)>::type storage;
+    static auto const table = new (&storage) InternTable{};
+    return *table;
+  }
+
+  Error Find(Error err) {
+    // 哈希需要遍历整条链条，放在锁外计算；锁内的比较遇到共享的节点即停止
+    auto const hash = DeepHash(err);
+    auto& shard = shards_[hash % kShards];
+    std::lock_guard<std::mutex> lock{shard.mu};
+    auto range = shard.entries.equal_range(hash);
+    for (auto it = range.first; it != range.second;) {
+      auto found = it->second.lock();
+      if (found == nullptr) {
+        it = shard.entries.erase(it);
+        continue;
+      }
+      if (DeepEqual(found, err)) {
+        return found;
+      }
+      ++it;
+    }
+    shard.entries.emplace(hash, err);
+    SweepSome(shard);
+    return err;
+  }
+
+ private:
+  static constexpr std::size_t kShards = 64;
+  static constexpr std::size_t kSweepBuckets = 8;
+
+  struct Shard {
+    std::mutex mu;
+    std::unordered_multimap<std::size_t, std::weak_ptr<IError>> entries;
+    std::size_t cursor{0};
+  };
+
+  /** 从上次停下的位置开始检查 kSweepBuckets 个桶，删除其中失效的条目 */
+  static void SweepSome(Shard& shard) {
+    auto& entries = shard.entries;
+    auto const buckets = entries.bucket_count();
+    for (std::size_t n = 0; n < kSweepBuckets; ++n) {
+      auto const bucket = shard.cursor++ % buckets;
+      auto it = entries.cbegin(bucket);
+      while (it != entries.cend(bucket)) {
+        if (!it->second.expired()) {
+          ++it;
+          continue;
+        }
+        // 桶内迭代器不能用于删除，按哈希值删除后从桶头重新开始
+        EraseExpired(entries, it->first);
+        it = entries.cbegin(bucket);
+      }
+    }
+  }
+
+  static void EraseExpired(
+      std::unordered_multimap<std::size_t, std::weak_ptr<IError>>& entries,
+      std::size_t hash) {
+    auto range = entries.equal_range(hash);
+    while (range.first != range.second) {
+      range.first = range.first->second.expired() ? entries.erase(range.first)
+                                                  : std::next(range.first);
+    }
+  }
+
+  InternTable() {}
+
+  Shard shards_[kShards];
+};
+
+/** OutOfMemoryPool 的一个槽位，足够放下 allocate_shared 创建的控制块和节点 */
+struct OutOfMemorySlot {
+  static constexpr std::size_t kBytes = 128;
+
+  typename std::aligned_storage<kBytes, alignof(std::max_align_t)>::type
+      storage;
+  std::atomic<bool> busy{};
+};
+
+/** 在指定槽位上分配的分配器，不会分配内存，释放时归还槽位 */
+template <class T>
+struct OutOfMemorySlotAllocator {
+  using value_type = T;
+
+  explicit OutOfMemorySlotAllocator(OutOfMemorySlot* s) noexcept : slot{s} {}
+  template <class U>
+  OutOfMemorySlotAllocator(OutOfMemorySlotAllocator<U> const& other) noexcept
+      : slot{other.slot} {}
+
+  T* allocate(std::size_t) noexcept {
+    static_assert(sizeof(T) <= OutOfMemorySlot::kBytes &&
+                      alignof(T) <= alignof(std::max_align_t),
+                  "OutOfMemorySlot is too small");
+    return reinterpret_cast<T*>(&slot->storage);
+  }
+  void deallocate(T*, std::size_t) noexcept {
+    slot->busy.store(false, std::memory_order_release);
+  }
+
+  template <class U>
+  bool operator==(OutOfMemorySlotAllocator<U> const& other) const {
+    return slot == other.slot;
+  }
+  template <class U>
+  bool operator!=(OutOfMemorySlotAllocator<U> const& other) const {
+    return slot != other.slot;
+  }
+
+  OutOfMemorySlot* slot;
+};
+
+/**
+ * OutOfMemory 使用的后备错误节点池。节点连同控制块构造在预留的静态槽位上，
+ * 获取时不会分配内存，节点上的 AsError / shared_from_this 也可以正常使用；
+ * 最后一个引用释放时节点析构，父错误随之释放，槽位归还给池。
+ * 槽位全部被占用时返回 generic_，它只有通用的错误信息，不保留父错误。
+ */
+class OutOfMemoryPool {
+ public:
+  static constexpr int kSize = 64;
+
+  static OutOfMemoryPool& Instance() noexcept {
+    static typename std::aligned_storage<sizeof(OutOfMemoryPool),
+                                         alignof(OutOfMemoryPool)>::type
+        storage;
+    static auto const pool = new (&storage) OutOfMemoryPool{};
+    return *pool;
+  }
+
+  Error Get(int code, char const* msg, Error cause) noexcept {
+    auto const start = next_.fetch_add(1, std::memory_order_relaxed);
+    for (unsigned n = 0; n < kSize; ++n) {
+      auto& slot = slots_[(start + n) % kSize];
+      bool expected = false;
+      if (!slot.busy.load(std::memory_order_relaxed) &&
+          slot.busy.compare_exchange_strong(expected, true,
+                                            std::memory_order_acquire)) {
+        return Build(slot, code, msg, std::move(cause));
+      }
+    }
+    return generic_;
+  }
+
+ private:
+  // 池本身从不析构，generic_ 占用的槽位也就永远不会归还
+  OutOfMemoryPool() noexcept
+      : generic_{Build(genericSlot_, 0, nullptr, nullptr)} {}
+
+  static Error Build(OutOfMemorySlot& slot, int code, char const* msg,
+                     Error cause) noexcept {
+    slot.busy.store(true, std::memory_order_relaxed);
+    return std::allocate_shared<OutOfMemoryError>(
+        OutOfMemorySlotAllocator<OutOfMemoryError>{&slot}, code, msg,
+        std::move(cause));
+  }
+
+  std::atomic<unsigned> next_{0};
+  OutOfMemorySlot slots_[kSize];
+  OutOfMemorySlot genericSlot_;
+  Error generic_;
+};
+
+GERR_INLINE Error OutOfMemory(int code, char const* msg, Error cause) noexcept {
+  return OutOfMemoryPool::Instance().Get(code, msg, std::move(cause));
+}
+
+GERR_INLINE Error CreateFailed(int code, char const* msg,
+                               Error cause) noexcept {
+  try {
+    return MakeShared<CodeRawStrMessageSubError>(
+        code, msg != nullptr ? msg : "exception thrown while creating error",
+        cause);
+  } catch (...) {
+    return OutOfMemory(code, msg, std::move(cause));
+  }
+}
+
+namespace {
+
+// 在程序启动时初始化后备节点池，而不是等到第一次内存不足时
+OutOfMemoryPool const& gOutOfMemoryPoolReady = OutOfMemoryPool::Instance();
+
+}  // namespace
+
+/** StaticCodeError 使用的常驻节点表，开放寻址，只插入不删除 */
+class StaticCodeTable {
+ public:
+  static constexpr std::size_t kCapacity = 1024;
+  static constexpr std::size_t kMaxProbe = 16;
+
+  static StaticCodeTable& Instance() {
+    static StaticCodeTable table{};
+    return table;
+  }
+
+  CodeRawStrMessageError* Find(int code, char const* msg) {
+    auto i = Hash(code, msg);
+    for (std::size_t n = 0; n < kMaxProbe; ++n, i = (i + 1) % kCapacity) {
+      auto const node = slots_[i].load(std::memory_order_acquire);
+      if (node == nullptr) {
+        if (!Insert(i, code, msg)) {
+          continue;
+        }
+        return slots_[i].load(std::memory_order_acquire);
+      }
+      if (Match(node, code, msg)) {
+        return node;
+      }
+    }
+    return nullptr;
+  }
+
+ private:
+  static std::size_t Hash(int code, char const* msg) {
+    auto h = reinterpret_cast<std::uintptr_t>(msg) * 0x9e3779b97f4a7c15ull;
+    h ^= static_cast<unsigned>(code) * 0xff51afd7ed558ccdull;
+    return static_cast<std::size_t>(h >> 32) % kCapacity;
+  }
+
+  static bool Match(CodeRawStrMessageError const* node, int code,
+                    char const* msg) {
+    return node->Code() == code && node->Message() == msg;
+  }
+
+  // 在空槽 i 上插入新节点，返回 false 表示被其他线程抢先插入了不同的节点
+  bool Insert(std::size_t i, int code, char const* msg) {
+    Error const owner = std::make_shared<CodeRawStrMessageError>(code, msg);
+    CodeRawStrMessageError* expected = nullptr;
+    return PublishImmortal(slots_[i], expected, owner) ||
+           Match(expected, code, msg);
+  }
+
+  std::atomic<CodeRawStrMessageError*> slots_[kCapacity]{};
+};
+
+GERR_INLINE Error StaticCodeError(int code, char const* msg) {
+  auto const node = StaticCodeTable::Instance().Find(code, msg);
+  if (node == nullptr) {
+    return Make<CodeRawStrMessageError>(code, msg);
+  }
+  return Error{Error{}, node};
+}
+
+GERR_INLINE std::size_t VFormatTo(char* buffer, std::size_t size,
+                                  fmt::string_view formatStr,
+                                  fmt::format_args args) {
+  auto const result = fmt::vformat_to_n(buffer, size - 1, formatStr, args);
+  auto const n = result.size < size - 1 ? result.size : size - 1;
+  buffer[n] = '\0';
+  return n;
+}
+
+// strerror_r 有 GNU 和 XSI 两种版本，分别返回字符串和错误码
+inline char const* StrErrorResult(char const* result, char const*) {
+  return result;
+}
+
+inline char const* StrErrorResult(int result, char const* buffer) {
+  return result == 0 ? buffer : "Unknown error";
+}
+
+GERR_INLINE void ErrnoError::Render() const {
+#ifdef _WIN32
+  char const* msg =
+      strerror_s(buffer_, kBufferSize, value_) == 0 ? buffer_ : "Unknown error";
+#else
+  char const* msg = StrErrorResult(
+      ::strerror_r(value_, buffer_, kBufferSize), buffer_);
+#endif
+  if (msg != buffer_) {
+    std::strncpy(buffer_, msg, kBufferSize - 1);
+    buffer_[kBufferSize - 1] = '\0';
+  }
+}
+
+/**
+ * errno 的常驻错误节点表，覆盖 Linux / macOS 上定义的全部 errno。
+ * 所有节点在程序启动时创建（共约 20KB），和 StaticCodeTable 一样通过常驻引用持有，
+ * 因此 FromErrno 不会分配内存，节点上的 AsError / shared_from_this 也可以正常使用。
+ * 启动时内存不足而没有创建的节点在第一次使用时再创建。
+ */
+class ErrnoTable {
+ public:
+  static constexpr int kSize = 160;
+
+  static ErrnoTable& Instance() {
+    static ErrnoTable table{};
+    return table;
+  }
+
+  ErrnoError* Find(int value) {
+    if (value <= 0 || value >= kSize) {
+      return nullptr;
+    }
+    auto& slot = slots_[value];
+    auto node = slot.load(std::memory_order_acquire);
+    if (node != nullptr) {
+      return node;
+    }
+    Error const owner = std::make_shared<ErrnoError>(value);
+    if (PublishImmortal(slot, node, owner)) {
+      return static_cast<ErrnoError*>(owner.get());
+    }
+    return node;
+  }
+
+ private:
+  ErrnoTable() noexcept {
+    for (int value = 1; value < kSize; ++value) {
+      try {
+        Find(value);
+      } catch (...) {
+      }
+    }
+  }
+
+  std::atomic<ErrnoError*> slots_[kSize]{};
+};
+
+namespace {
+
+// 在程序启动时创建全部 errno 节点，而不是等到第一次使用时
+ErrnoTable const& gErrnoTableReady = ErrnoTable::Instance();
+
+}  // namespace
+
+class ErrorCategoryImpl : public std::error_category {
+ public:
+  char const* name() const noexcept override { return "gerr"; }
+  std::string message(int code) const override {
+    return "gerr error " + std::to_string(code);
+  }
+};
+
+}  // namespace details
+
+GERR_INLINE Error FromErrno(int value) noexcept {
+  if (value == 0) {
+    return nullptr;
+  }
+  details::ErrnoError* node = nullptr;
+  try {
+    node = details::ErrnoTable::Instance().Find(value);
+  } catch (...) {
+  }
+  if (node == nullptr) {
+    return Make<details::ErrnoError>(value);
+  }
+  return Error{Error{}, node};
+}
+
+GERR_INLINE Error FromErrorCode(std::error_code const& ec) noexcept {
+  if (!ec) {
+    return nullptr;
+  }
+  if (ec.category() == std::generic_category()) {
+    return FromErrno(ec.value());
+  }
+  return Make<details::ErrorCodeError>(ec);
+}
+
+GERR_INLINE Error Intern(Error err) noexcept {
+  // 常驻节点没有控制块，不能被弱引用
+  if (err == nullptr || err.use_count() == 0) {
+    return err;
+  }
+  try {
+    for (auto p = err.get(); p != nullptr; p = p->Cause().get()) {
+      if (!details::InternableNode(*p)) {
+        return err;
+      }
+    }
+    return details::InternTable::Instance().Find(err);
+  } catch (...) {
+    return err;
+  }
+}
+
+GERR_INLINE std::error_category const& ErrorCategory() {
+  static typename std::aligned_storage<
+      sizeof(details::ErrorCategoryImpl),
+      alignof(details::ErrorCategoryImpl)>::type storage;
+  static auto const category = new (&storage) details::ErrorCategoryImpl{};
+  return *category;
+}
+
+GERR_INLINE std::error_code ToErrorCode(ErrorView err) {
+  if (err == nullptr) {
+    return {};
+  }
+  for (auto p = err.Get(); p != nullptr; p = p->Cause().get()) {
+    if (auto e = dynamic_cast<details::ErrnoError const*>(p)) {
+      return {e->Value(), std::generic_category()};
+    }
+    if (auto e = dynamic_cast<details::ErrorCodeSource const*>(p)) {
+      auto const ec = e->ErrorCode();
+      if (ec) {
+        return ec;
+      }
+    }
+  }
+  return {Code(err), ErrorCategory()};
+}
+
+GERR_INLINE bool IsCode(int code, ErrorView err) {
+  for (auto p = err.Get(); p != nullptr; p = p->Cause().get()) {
+    if (p->Code() == code) {
+      return true;
+    }
+  }
+  return false;
+}
+
+GERR_INLINE int Code(ErrorView err, int defaultErrCode) {
+  if (err == nullptr) {
+    return 0;
+  }
+  return details::FirstCode(*err, defaultErrCode);
+}
+
+GERR_INLINE std::string String(ErrorView err) {
+  if (err == nullptr) {
+    return "<nil>";
+  }
+  return details::ToString(*err);
+}
+
+namespace details {
+
+inline bool SameMessage(IError const& lhs, IError const& rhs) {
+  auto const a = lhs.Message();
+  auto const b = rhs.Message();
+  return a == b ||
+         std::strcmp(a == nullptr ? "" : a, b == nullptr ? "" : b) == 0;
+}
+
+/** 比较和哈希错误链条时使用的节点类型，New / Wrap 的各种节点归为同一种 */
+struct NodeKind {
+  std::type_info const* type;
+  std::size_t hash;
+};
+
+/**
+ * 判断 PlainNodeType 和 type_info::hash_code 每次都要比较或哈希类型名，
+ * 这里按 type_info 的地址缓存结果，每个线程一份，直接映射，冲突时覆盖
+ */
+inline NodeKind KindOf(std::type_info const& type) {
+  struct Entry {
+    std::type_info const* key;
+    NodeKind kind;
+  };
+  static thread_local Entry cache[16];
+  auto& entry = cache[(reinterpret_cast<std::uintptr_t>(&type) >> 4) % 16];
+  if (entry.key != &type) {
+    auto const& kind = PlainNodeType(type) ? typeid(MessageError) : type;
+    entry = Entry{&type, NodeKind{&kind, kind.hash_code()}};
+  }
+  return entry.kind;
+}
+
+template <bool Deep>
+bool ChainEqual(IError const* a, IError const* b) {
+  for (; a != nullptr && b != nullptr;
+       a = a->Cause().get(), b = b->Cause().get()) {
+    if (a == b) {
+      return true;
+    }
+    if (*KindOf(typeid(*a)).type != *KindOf(typeid(*b)).type ||
+        a->Code() != b->Code() || (Deep && !SameMessage(*a, *b))) {
+      return false;
+    }
+  }
+  return a == b;
+}
+
+template <bool Deep>
+std::size_t ChainHash(IError const* p) {
+  std::uint64_t h = 14695981039346656037ull;
+  for (; p != nullptr; p = p->Cause().get()) {
+    h = (h ^ KindOf(typeid(*p)).hash) * 1099511628211ull;
+    h = (h ^ static_cast<std::uint32_t>(p->Code())) * 1099511628211ull;
+    auto s = Deep ? p->Message() : nullptr;
+    for (; s != nullptr && *s != '\0'; ++s) {
+      h = (h ^ static_cast<unsigned char>(*s)) * 1099511628211ull;
+    }
+  }
+  return static_cast<std::size_t>(h);
+}
+
+}  // namespace details
+
+GERR_INLINE bool ShapeEqual(ErrorView lhs, ErrorView rhs) {
+  return details::ChainEqual<false>(lhs.Get(), rhs.Get());
+}
+
+GERR_INLINE std::size_t ShapeHash(ErrorView err) {
+  return details::ChainHash<false>(err.Get());
+}
+
+GERR_INLINE bool DeepEqual(ErrorView lhs, ErrorView rhs) {
+  return details::ChainEqual<true>(lhs.Get(), rhs.Get());
+}
+
+GERR_INLINE std::size_t DeepHash(ErrorView err) {
+  return details::ChainHash<true>(err.Get());
+}
+
+namespace details {
+
+GERR_INLINE void WriteFd(int fd, std::string const& text) {
+  std::size_t done = 0;
+  while (done < text.size()) {
+#ifdef _WIN32
+    auto const n = ::_write(fd, text.data() + done,
+                            static_cast<unsigned>(text.size() - done));
+#else
+    auto const n = ::write(fd, text.data() + done, text.size() - done);
+#endif
+    if (n <= 0) {
+      return;
+    }
+    done += static_cast<std::size_t>(n);
+  }
+}
+
+#ifdef GERR_TRACK_LIVE
+
+/** 一个线程创建的存活节点链表，线程退出后链表留给之后的线程复用 */
+struct LiveList {
+  std::mutex mu;
+  LiveHeader head;
+  bool owned{};
+
+  LiveList() { head.prev = head.next = &head; }
+};
+
+/** 所有线程的存活节点链表，链表一旦创建就不再释放 */
+class LiveRegistry {
+ public:
+  static LiveRegistry& Instance() {
+    static typename std::aligned_storage<sizeof(LiveRegistry),
+                                         alignof(LiveRegistry)>::type storage;
+    static auto const registry = new (&storage) LiveRegistry{};
+    return *registry;
+  }
+
+  /** 内存不足时返回 nullptr，调用方下次再试 */
+  LiveList* TryAcquire() noexcept {
+    std::lock_guard<std::mutex> lock{mu_};
+    for (auto list : lists_) {
+      if (!list->owned) {
+        list->owned = true;
+        return list;
+      }
+    }
+    try {
+      lists_.reserve(lists_.size() + 1);
+      lists_.push_back(new LiveList{});
+    } catch (...) {
+      return nullptr;
+    }
+    lists_.back()->owned = true;
+    return lists_.back();
+  }
+
+  void Release(LiveList* list) {
+    std::lock_guard<std::mutex> lock{mu_};
+    list->owned = false;
+  }
+
+  template <class Fn>
+  void ForEach(Fn fn) {
+    std::lock_guard<std::mutex> lock{mu_};
+    for (auto list : lists_) {
+      std::lock_guard<std::mutex> listLock{list->mu};
+      for (auto h = list->head.next; h != &list->head; h = h->next) {
+        fn(*h);
+      }
+    }
+  }
+
+ private:
+  LiveRegistry() {}
+
+  std::mutex mu_;
+  std::vector<LiveList*> lists_;
+};
+
+struct LiveThread {
+  LiveList* list{};
+
+  ~LiveThread() {
+    if (list != nullptr) {
+      LiveRegistry::Instance().Release(list);
+    }
+  }
+};
+
+/** 当前线程的链表，还没有并且内存不足时返回 nullptr */
+inline LiveList* CurrentLiveList() noexcept {
+  static thread_local LiveThread thread;
+  if (thread.list == nullptr) {
+    thread.list = LiveRegistry::Instance().TryAcquire();
+  }
+  return thread.list;
+}
+
+/** 每多少个节点记录一次调用栈，0 表示不记录 */
+inline std::atomic<unsigned>& LiveBacktraceEvery() noexcept {
+  static std::atomic<unsigned> every{0};
+  return every;
+}
+
+inline std::int64_t LiveNowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+GERR_INLINE void LiveLink(LiveHeader* header, std::type_info const& type,
+                          std::size_t bytes) noexcept {
+  header->prev = header->next = header;
+  auto const list = CurrentLiveList();
+  if (list == nullptr) {
+    // 内存不足，无法为当前线程登记链表，这个节点不参与统计
+    return;
+  }
+  header->type = &type;
+  header->bytes = bytes;
+  header->createdNs = LiveNowNs();
+#if defined(__GLIBC__)
+  auto const every = LiveBacktraceEvery().load(std::memory_order_relaxed);
+  static thread_local unsigned created = 0;
+  if (every != 0 && ++created % every == 0) {
+    header->frameCount = ::backtrace(header->frames, LiveHeader::kMaxFrames);
+  }
+#endif
+  header->list = list;
+  std::lock_guard<std::mutex> lock{list->mu};
+  header->prev = list->head.prev;
+  header->next = &list->head;
+  list->head.prev->next = header;
+  list->head.prev = header;
+}
+
+GERR_INLINE void LiveFinish(LiveHeader* header, IError const& node) noexcept {
+  auto const list = static_cast<LiveList*>(header->list);
+  if (list == nullptr) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock{list->mu};
+  header->node = &node;
+  header->code = node.Code();
+  header->bytes += node.HeapUsage();
+}
+
+GERR_INLINE void LiveUnlink(LiveHeader* header) noexcept {
+  auto const list = static_cast<LiveList*>(header->list);
+  if (list == nullptr) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock{list->mu};
+  header->prev->next = header->next;
+  header->next->prev = header->prev;
+}
+
+inline std::string LiveTypeName(std::type_info const& type) {
+#if defined(__GNUG__)
+  int status = 0;
+  auto const name = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+  if (status == 0 && name != nullptr) {
+    std::string result{name};
+    std::free(name);
+    return result;
+  }
+#endif
+  return type.name();
+}
+
+#endif  // GERR_TRACK_LIVE
+
+}  // namespace details
+
+#ifdef GERR_TRACK_LIVE
+
+GERR_INLINE std::vector<LiveGroup> LiveErrors() {
+  struct Key {
+    std::type_info const* type;
+    int code;
+  };
+  std::vector<std::pair<Key, LiveGroup>> groups;
+  details::LiveRegistry::Instance().ForEach([&](details::LiveHeader const& h) {
+    auto it = std::find_if(groups.begin(), groups.end(),
+                           [&](std::pair<Key, LiveGroup> const& g) {
+                             return *g.first.type == *h.type &&
+                                    g.first.code == h.code;
+                           });
+    if (it == groups.end()) {
+      groups.push_back({Key{h.type, h.code}, LiveGroup{{}, h.code, 0, 0}});
+      it = groups.end() - 1;
+    }
+    ++it->second.count;
+    it->second.bytes += h.bytes;
+  });
+  std::vector<LiveGroup> result;
+  result.reserve(groups.size());
+  for (auto& g : groups) {
+    g.second.type = details::LiveTypeName(*g.first.type);
+    result.push_back(std::move(g.second));
+  }
+  std::sort(result.begin(), result.end(),
+            [](LiveGroup const& a, LiveGroup const& b) {
+              return a.bytes > b.bytes;
+            });
+  return result;
+}
+
+GERR_INLINE void DumpLive(int fd, std::size_t limit) {
+  std::vector<details::LiveHeader> oldest;
+  details::LiveRegistry::Instance().ForEach(
+      [&](details::LiveHeader const& h) { oldest.push_back(h); });
+  std::sort(oldest.begin(), oldest.end(),
+            [](details::LiveHeader const& a, details::LiveHeader const& b) {
+              return a.createdNs < b.createdNs;
+            });
+
+  std::size_t totalBytes = 0;
+  for (auto const& h : oldest) {
+    totalBytes += h.bytes;
+  }
+  auto const groups = LiveErrors();
+  std::string out = fmt::format("gerr live errors: {} nodes, {} bytes\n",
+                                oldest.size(), totalBytes);
+  for (auto const& g : groups) {
+    out += fmt::format("  {:>8} nodes {:>10} bytes  code={} {}\n", g.count,
+                       g.bytes, g.code, g.type);
+  }
+  details::WriteFd(fd, out);
+
+  auto const now = details::LiveNowNs();
+  auto const n = std::min(limit, oldest.size());
+  details::WriteFd(fd, fmt::format("oldest {} live errors:\n", n));
+  for (std::size_t i = 0; i < n; ++i) {
+    auto const& h = oldest[i];
+    details::WriteFd(
+        fd, fmt::format("#{} age={:.3f}s code={} bytes={} {}\n", i,
+                        static_cast<double>(now - h.createdNs) / 1e9, h.code,
+                        h.bytes, details::LiveTypeName(*h.type)));
+#if defined(__GLIBC__)
+    ::backtrace_symbols_fd(const_cast<void* const*>(h.frames), h.frameCount,
+                           fd);
+#endif
+  }
+}
+
+GERR_INLINE void SetLiveBacktraceSampling(unsigned every) noexcept {
+  details::LiveBacktraceEvery().store(every, std::memory_order_relaxed);
+}
+
+#else
+
+GERR_INLINE std::vector<LiveGroup> LiveErrors() { return {}; }
+
+GERR_INLINE void SetLiveBacktraceSampling(unsigned) noexcept {}
+
+GERR_INLINE void DumpLive(int fd, std::size_t) {
+  details::WriteFd(fd,
+                   "gerr live error tracking is disabled, "
+                   "build with GERR_TRACK_LIVE\n");
+}
+
+#endif  // GERR_TRACK_LIVE
+
+}  // namespace gerr
@@ -22,13 +22,21 @@
 //
 #pragma once
 
+#include <fmt/compile.h>
 #include <fmt/format.h>
 
-#include <iostream>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
 #include <memory>
-#include <sstream>
+#include <new>
 #include <string>
+#include <system_error>
 #include <type_traits>
+#include <typeinfo>
+#include <vector>
 
 /**
  * 定义一个自定义的 gerr::Error 类型，并附加一个错误码和错误信息。
@@ -68,289 +76,218 @@
  *       }
  *       return nullptr; // 没有错误
  *   }
+ *
+ * 错误码可以是任意 int 表达式，不要求是常量表达式（例如从配置中读取的全局变量），
+ * 在创建错误节点时求值；E() 返回的共享节点在第一次调用时创建，错误码也在那时确定。
+ * 每个宏都生成一个普通的类，可以像其他类一样前置声明（class MyError1;）。
+ * 生成的类只包含构造函数和 E，Code / Message / Cause 以及 E 的实现都由
+ * gerr::details 中的公共基类和函数模板提供，不会为每个错误类型重复生成。
  */
-#define DEFINE_ERROR(__ErrTypE__, __ErrMessagE__)                             \
-  class __ErrTypE__ : public ::gerr::details::IError {                        \
-   protected:                                                                 \
-    struct __PrivateStruct__ {};                                              \
-                                                                              \
-   public:                                                                    \
-    __ErrTypE__(__PrivateStruct__ const&) {}                                  \
-    __ErrTypE__(::gerr::Error __c__, __PrivateStruct__ const&)                \
-        : __causE__{::std::move(__c__)} {}                                    \
-                                                                              \
-    static ::gerr::Error E() {                                                \
-      static auto __valuE__ = ::gerr::Make<__ErrTypE__>(__PrivateStruct__{}); \
-      return __valuE__;                                                       \
-    }                                                                         \
-                                                                              \
-    template <class ErrType,                                                  \
-              class = typename ::std::enable_if<                              \
-                  ::std::is_base_of<IError, ErrType>::value>::type>           \
-    static ::gerr::Error E(::std::shared_ptr<ErrType>&& __p__) {              \
-      return ::gerr::Make<__ErrTypE__>(::std::move(__p__),                    \
-                                       __PrivateStruct__{});                  \
-    }                                                                         \
-                                                                              \
-    template <class ErrType,                                                  \
-              class = typename ::std::enable_if<                              \
-                  ::std::is_base_of<IError, ErrType>::value>::type>           \
-    static ::gerr::Error E(::std::shared_ptr<ErrType> const& __p__) {         \
-      return ::gerr::Make<__ErrTypE__>(__p__, __PrivateStruct__{});           \
-    }                                                                         \
-                                                                              \
-    char const* Message() const override { return __ErrMessagE__; }           \
-    ::gerr::Error const& Cause() const override { return __causE__; }         \
-                                                                              \
-   private:                                                                   \
-    ::gerr::Error __causE__{};                                                \
-  }
+#define DEFINE_ERROR(__ErrTypE__, __ErrMessagE__) \
+  DEFINE_CODE_ERROR(__ErrTypE__, 0, __ErrMessagE__)
 
 #define DEFINE_CODE_ERROR(__ErrTypE__, __ErrCodE__, __ErrMessagE__)            \
-  class __ErrTypE__ : public ::gerr::details::IError {                         \
-   protected:                                                                  \
+  struct __ErrTypE__##_GErrTag {                                               \
+    static constexpr char const* StaticMessage() {                             \
+      return GERR_STATIC_MESSAGE(__ErrMessagE__);                              \
+    }                                                                          \
+  };                                                                           \
+  class __ErrTypE__ : public ::gerr::details::StaticDefinedError {             \
     struct __PrivateStruct__ {};                                               \
                                                                                \
    public:                                                                     \
-    __ErrTypE__(__PrivateStruct__ const&) {}                                   \
-    __ErrTypE__(::gerr::Error&& __c__, __PrivateStruct__ const&)               \
-        : __causE__{::std::move(__c__)} {}                                     \
-    __ErrTypE__(::gerr::Error const& __c__, __PrivateStruct__ const&)          \
-        : __causE__{__c__} {}                                                  \
-                                                                               \
-    static ::gerr::Error E() {                                                 \
-      static auto __valuE__ = ::gerr::Make<__ErrTypE__>(__PrivateStruct__{});  \
-      return __valuE__;                                                        \
-    }                                                                          \
+    __ErrTypE__(__PrivateStruct__, ::gerr::Error __c__)                        \
+        : StaticDefinedError{(__ErrCodE__),                                    \
+                             __ErrTypE__##_GErrTag::StaticMessage(),           \
+                             ::std::move(__c__)} {}                            \
                                                                                \
-    template <class ErrType,                                                   \
-              class = typename ::std::enable_if<                               \
-                  ::std::is_base_of<IError, ErrType>::value>::type>            \
-    static ::gerr::Error E(::std::shared_ptr<ErrType>&& __p__) {               \
-      return ::gerr::Make<__ErrTypE__>(std::move(__p__), __PrivateStruct__{}); \
+    static ::gerr::Error E() noexcept {                                        \
+      return ::gerr::details::DefinedE<__ErrTypE__, __ErrTypE__##_GErrTag>(    \
+          __PrivateStruct__{}, (__ErrCodE__));                                 \
     }                                                                          \
                                                                                \
-    template <class ErrType,                                                   \
-              class = typename ::std::enable_if<                               \
-                  ::std::is_base_of<IError, ErrType>::value>::type>            \
-    static ::gerr::Error E(::std::shared_ptr<ErrType> const& __p__) {          \
-      return ::gerr::Make<__ErrTypE__>(__p__, __PrivateStruct__{});            \
+    static ::gerr::Error E(::gerr::Error __c__) noexcept {                     \
+      return ::gerr::details::DefinedE<__ErrTypE__, __ErrTypE__##_GErrTag>(    \
+          __PrivateStruct__{}, (__ErrCodE__), ::std::move(__c__));             \
     }                                                                          \
-                                                                               \
-    int Code() const override { return __ErrCodE__; }                          \
-    char const* Message() const override { return __ErrMessagE__; }            \
-    ::gerr::Error const& Cause() const override { return __causE__; }          \
-                                                                               \
-   private:                                                                    \
-    ::gerr::Error __causE__{};                                                 \
   }
 
 #define DEFINE_CONTEXT_ERROR(__ErrTypE__, __ContextTypE__, __ErrFormaT__, ...) \
-  class __ErrTypE__ : public ::gerr::details::IError {                         \
-   protected:                                                                  \
-    struct __PrivateStruct__ {};                                               \
-                                                                               \
-   public:                                                                     \
-    using ContextType = __ContextTypE__;                                       \
-                                                                               \
-    __ErrTypE__(ContextType const& __ctX__, std::string&& __msG__,             \
-                __PrivateStruct__ const&)                                      \
-        : __contexT__{__ctX__}, __messagE__{std::move(__msG__)} {}             \
-                                                                               \
-    __ErrTypE__(ContextType&& __ctX__, std::string&& __msG__,                  \
-                __PrivateStruct__ const&)                                      \
-        : __contexT__{std::move(__ctX__)}, __messagE__{std::move(__msG__)} {}  \
-                                                                               \
-    __ErrTypE__(::gerr::Error&& __c__, ContextType const& __ctX__,             \
-                std::string&& __msG__, __PrivateStruct__ const&)               \
-        : __causE__{::std::move(__c__)},                                       \
-          __contexT__{__ctX__},                                                \
-          __messagE__{std::move(__msG__)} {}                                   \
-                                                                               \
-    __ErrTypE__(::gerr::Error const& __c__, ContextType const& __ctX__,        \
-                std::string&& __msG__, __PrivateStruct__ const&)               \
-        : __causE__{__c__},                                                    \
-          __contexT__{__ctX__},                                                \
-          __messagE__{std::move(__msG__)} {}                                   \
-                                                                               \
-    __ErrTypE__(::gerr::Error&& __c__, ContextType&& __ctX__,                  \
-                std::string&& __msG__, __PrivateStruct__ const&)               \
-        : __causE__{::std::move(__c__)},                                       \
-          __contexT__{std::move(__ctX__)},                                     \
-          __messagE__{std::move(__msG__)} {}                                   \
-                                                                               \
-    __ErrTypE__(::gerr::Error const& __c__, ContextType&& __ctX__,             \
-                std::string&& __msG__, __PrivateStruct__ const&)               \
-        : __causE__{__c__},                                                    \
-          __contexT__{std::move(__ctX__)},                                     \
-          __messagE__{std::move(__msG__)} {}                                   \
-                                                                               \
-    static ::gerr::Error E(ContextType const& context) {                       \
-      return ::gerr::Make<__ErrTypE__>(                                        \
-          context, fmt::format(__ErrFormaT__, __VA_ARGS__),                    \
-          __PrivateStruct__{});                                                \
-    }                                                                          \
-                                                                               \
-    static ::gerr::Error E(ContextType&& context) {                            \
-      auto __tempMsG__ = fmt::format(__ErrFormaT__, __VA_ARGS__);              \
-      return ::gerr::Make<__ErrTypE__>(context, std::move(__tempMsG__),        \
-                                       __PrivateStruct__{});                   \
-    }                                                                          \
-                                                                               \
-    template <class ErrType,                                                   \
-              class = typename ::std::enable_if<                               \
-                  ::std::is_base_of<IError, ErrType>::value>::type>            \
-    static ::gerr::Error E(::std::shared_ptr<ErrType>&& __p__,                 \
-                           ContextType const& context) {                       \
-      return ::gerr::Make<__ErrTypE__>(                                        \
-          ::std::move(__p__), fmt::format(__ErrFormaT__, __VA_ARGS__),         \
-          __PrivateStruct__{});                                                \
-    }                                                                          \
+  DEFINE_CODE_CONTEXT_ERROR(__ErrTypE__, 0, __ContextTypE__, __ErrFormaT__,    \
+                            __VA_ARGS__)
+
+#define DEFINE_CODE_CONTEXT_ERROR(__ErrTypE__, __ErrCodE__, __ContextTypE__,   \
+                                  __ErrFormaT__, ...)                          \
+  GERR_CONTEXT_ERROR_TAG(__ErrTypE__, __ContextTypE__, __ErrFormaT__,          \
+                         __VA_ARGS__);                                         \
+  class __ErrTypE__                                                            \
+      : public ::gerr::details::ContextDefinedError<__ContextTypE__> {         \
+    GERR_CONTEXT_ERROR_CONSTRUCTOR(__ErrTypE__, __ErrCodE__)                   \
                                                                                \
-    template <class ErrType,                                                   \
-              class = typename ::std::enable_if<                               \
-                  ::std::is_base_of<IError, ErrType>::value>::type>            \
-    static ::gerr::Error E(::std::shared_ptr<ErrType> const& __p__,            \
-                           ContextType const& context) {                       \
-      return ::gerr::Make<__ErrTypE__>(                                        \
-          __p__, fmt::format(__ErrFormaT__, __VA_ARGS__),                      \
-          __PrivateStruct__{});                                                \
+    static ::gerr::Error E(ContextType context) noexcept {                     \
+      return E(nullptr, ::std::move(context));                                 \
     }                                                                          \
+  }
+
+/**
+ * 同 DEFINE_CONTEXT_ERROR / DEFINE_CODE_CONTEXT_ERROR，但是 E(context) 会按环境信息
+ * 的值缓存错误节点：相同的环境信息再次调用 E(context) 时直接返回缓存中的常驻节点，
+ * 不再分配内存和格式化错误信息。适用于取值范围很小的环境信息（枚举、小整数组合等）。
+ * 环境信息类型需要支持 operator== 和 std::hash。每个错误类型最多缓存
+ * gerr::details::MemoTable 的容量个不同的值，缓存满之后的新值和普通的 E(context) 一样
+ * 每次创建新节点。缓存的节点永远不会释放，E(cause, context) 不使用缓存。
+ * 缓存的节点被所有调用方共享，因此只提供只读的 Context()。
+ *
+ * Example:
+ *   struct Pair { int a; int b; };
+ *   bool operator==(Pair const& l, Pair const& r) { ... }
+ *   namespace std { template <> struct hash<Pair> { ... }; }
+ *
+ *   DEFINE_MEMO_CONTEXT_ERROR(ErrBadPair, Pair, "bad pair: {}, {}",
+ *     context.a, context.b);
+ */
+#define DEFINE_MEMO_CONTEXT_ERROR(__ErrTypE__, __ContextTypE__, __ErrFormaT__, \
+                                  ...)                                         \
+  DEFINE_CODE_MEMO_CONTEXT_ERROR(__ErrTypE__, 0, __ContextTypE__,              \
+                                 __ErrFormaT__, __VA_ARGS__)
+
+#define DEFINE_CODE_MEMO_CONTEXT_ERROR(__ErrTypE__, __ErrCodE__,               \
+                                       __ContextTypE__, __ErrFormaT__, ...)    \
+  GERR_CONTEXT_ERROR_TAG(__ErrTypE__, __ContextTypE__, __ErrFormaT__,          \
+                         __VA_ARGS__);                                         \
+  class __ErrTypE__                                                            \
+      : public ::gerr::details::ContextDefinedError<__ContextTypE__> {         \
+    GERR_CONTEXT_ERROR_CONSTRUCTOR(__ErrTypE__, __ErrCodE__)                   \
                                                                                \
-    template <class ErrType,                                                   \
-              class = typename ::std::enable_if<                               \
-                  ::std::is_base_of<IError, ErrType>::value>::type>            \
-    static ::gerr::Error E(::std::shared_ptr<ErrType>&& __p__,                 \
-                           ContextType&& context) {                            \
-      auto __tempMsG__ = fmt::format(__ErrFormaT__, __VA_ARGS__);              \
-      return ::gerr::Make<__ErrTypE__>(                                        \
-          ::std::move(__p__), std::move(__tempMsG__), __PrivateStruct__{});    \
+    static ::gerr::Error E(ContextType context) noexcept {                     \
+      return ::gerr::details::MemoDefinedE<__ErrTypE__,                        \
+                                           __ErrTypE__##_GErrTag>(             \
+          __PrivateStruct__{}, (__ErrCodE__), ::std::move(context));           \
     }                                                                          \
                                                                                \
-    template <class ErrType,                                                   \
-              class = typename ::std::enable_if<                               \
-                  ::std::is_base_of<IError, ErrType>::value>::type>            \
-    static ::gerr::Error E(::std::shared_ptr<ErrType> const& __p__,            \
-                           ContextType&& context) {                            \
-      auto __tempMsG__ = fmt::format(__ErrFormaT__, __VA_ARGS__);              \
-      return ::gerr::Make<__ErrTypE__>(__p__, std::move(__tempMsG__),          \
-                                       __PrivateStruct__{});                   \
+    ContextType const& Context() const {                                       \
+      return ContextDefinedError::Context();                                   \
     }                                                                          \
-                                                                               \
-    char const* Message() const override { return __messagE__.c_str(); }       \
-    ::gerr::Error const& Cause() const override { return __causE__; }          \
-    ContextType& Context() { return __contexT__; }                             \
-                                                                               \
-   private:                                                                    \
-    ::gerr::Error __causE__{};                                                 \
-    ContextType __contexT__{};                                                 \
-    ::std::string __messagE__{};                                               \
   }
 
-#define DEFINE_CODE_CONTEXT_ERROR(__ErrTypE__, __ErrCodE__, __ContextTypE__,  \
-                                  __ErrFormaT__, ...)                         \
-  class __ErrTypE__ : public ::gerr::details::IError {                        \
-   protected:                                                                 \
-    struct __PrivateStruct__ {};                                              \
-                                                                              \
-   public:                                                                    \
-    using ContextType = __ContextTypE__;                                      \
-                                                                              \
-    __ErrTypE__(ContextType const& __ctX__, std::string&& __msG__,            \
-                __PrivateStruct__ const&)                                     \
-        : __contexT__{__ctX__}, __messagE__{std::move(__msG__)} {}            \
-                                                                              \
-    __ErrTypE__(ContextType&& __ctX__, std::string&& __msG__,                 \
-                __PrivateStruct__ const&)                                     \
-        : __contexT__{std::move(__ctX__)}, __messagE__{std::move(__msG__)} {} \
-                                                                              \
-    __ErrTypE__(::gerr::Error&& __c__, ContextType const& __ctX__,            \
-                std::string&& __msG__, __PrivateStruct__ const&)              \
-        : __causE__{::std::move(__c__)},                                      \
-          __contexT__{__ctX__},                                               \
-          __messagE__{std::move(__msG__)} {}                                  \
-                                                                              \
-    __ErrTypE__(::gerr::Error const& __c__, ContextType const& __ctX__,       \
-                std::string&& __msG__, __PrivateStruct__ const&)              \
-        : __causE__{__c__},                                                   \
-          __contexT__{__ctX__},                                               \
-          __messagE__{std::move(__msG__)} {}                                  \
-                                                                              \
-    __ErrTypE__(::gerr::Error&& __c__, ContextType&& __ctX__,                 \
-                std::string&& __msG__, __PrivateStruct__ const&)              \
-        : __causE__{::std::move(__c__)},                                      \
-          __contexT__{std::move(__ctX__)},                                    \
-          __messagE__{std::move(__msG__)} {}                                  \
-                                                                              \
-    __ErrTypE__(::gerr::Error const& __c__, ContextType&& __ctX__,            \
-                std::string&& __msG__, __PrivateStruct__ const&)              \
-        : __causE__{__c__},                                                   \
-          __contexT__{std::move(__ctX__)},                                    \
-          __messagE__{std::move(__msG__)} {}                                  \
-                                                                              \
-    static ::gerr::Error E(ContextType const& context) {                      \
-      return ::gerr::Make<__ErrTypE__>(                                       \
-          context, fmt::format(__ErrFormaT__, __VA_ARGS__),                   \
-          __PrivateStruct__{});                                               \
-    }                                                                         \
-                                                                              \
-    static ::gerr::Error E(ContextType&& context) {                           \
-      auto __tempMsG__ = fmt::format(__ErrFormaT__, __VA_ARGS__);             \
-      return ::gerr::Make<__ErrTypE__>(context, std::move(__tempMsG__),       \
-                                       __PrivateStruct__{});                  \
-    }                                                                         \
-                                                                              \
-    template <class ErrType,                                                  \
-              class = typename ::std::enable_if<::std::is_base_of<            \
-                  ::gerr::details::IError, ErrType>::value>::type>            \
-    static ::gerr::Error E(::std::shared_ptr<ErrType>&& __p__,                \
-                           ContextType const& context) {                      \
-      return ::gerr::Make<__ErrTypE__>(                                       \
-          ::std::move(__p__), fmt::format(__ErrFormaT__, __VA_ARGS__),        \
-          __PrivateStruct__{});                                               \
-    }                                                                         \
-                                                                              \
-    template <class ErrType,                                                  \
-              class = typename ::std::enable_if<::std::is_base_of<            \
-                  ::gerr::details::IError, ErrType>::value>::type>            \
-    static ::gerr::Error E(::std::shared_ptr<ErrType> const& __p__,           \
-                           ContextType const& context) {                      \
-      return ::gerr::Make<__ErrTypE__>(                                       \
-          __p__, fmt::format(__ErrFormaT__, __VA_ARGS__),                     \
-          __PrivateStruct__{});                                               \
-    }                                                                         \
-                                                                              \
-    template <class ErrType,                                                  \
-              class = typename ::std::enable_if<::std::is_base_of<            \
-                  ::gerr::details::IError, ErrType>::value>::type>            \
-    static ::gerr::Error E(::std::shared_ptr<ErrType>&& __p__,                \
-                           ContextType&& context) {                           \
-      auto __tempMsG__ = fmt::format(__ErrFormaT__, __VA_ARGS__);             \
-      return ::gerr::Make<__ErrTypE__>(                                       \
-          ::std::move(__p__), std::move(__tempMsG__), __PrivateStruct__{});   \
-    }                                                                         \
-                                                                              \
-    template <class ErrType,                                                  \
-              class = typename ::std::enable_if<::std::is_base_of<            \
-                  ::gerr::details::IError, ErrType>::value>::type>            \
-    static ::gerr::Error E(::std::shared_ptr<ErrType> const& __p__,           \
-                           ContextType&& context) {                           \
-      auto __tempMsG__ = fmt::format(__ErrFormaT__, __VA_ARGS__);             \
-      return ::gerr::Make<__ErrTypE__>(__p__, std::move(__tempMsG__),         \
-                                       __PrivateStruct__{});                  \
-    }                                                                         \
+// 带环境信息的错误类型的 Tag，提供静态的格式化字符串和格式化函数，
+// 并在编译期检查占位符和参数的个数（C++11 及以上，格式化字符串需要是字面量）。
+// Tag 定义在类外，错误信息中的表达式不会被基类的成员名遮挡
+#define GERR_CONTEXT_ERROR_TAG(__ErrTypE__, __ContextTypE__, __ErrFormaT__, \
+                               ...)                                         \
+  struct __ErrTypE__##_GErrTag {                                            \
+    static constexpr char const* StaticMessage() {                          \
+      return GERR_STATIC_MESSAGE(__ErrFormaT__);                            \
+    }                                                                       \
+    static ::std::string FormatMessage(__ContextTypE__ const& context) {    \
+      static_assert(                                                        \
+          ::gerr::details::ArgCountMatches(                                 \
+              ::gerr::details::FormatArgCount(__ErrFormaT__),               \
+              decltype(::gerr::details::CountArgs(__VA_ARGS__))::value),    \
+          "the number of format arguments does not match the format "       \
+          "string");                                                        \
+      return GERR_FORMAT_CONTEXT_MESSAGE(__ErrFormaT__, __VA_ARGS__);       \
+    }                                                                       \
+  }
+
+// 带环境信息的错误类型的构造函数和 E(cause, context)，之后的成员都是 public 的
+#define GERR_CONTEXT_ERROR_CONSTRUCTOR(__ErrTypE__, __ErrCodE__)              \
+  struct __PrivateStruct__ {};                                                \
                                                                               \
-    int Code() const override { return __ErrCodE__; }                         \
-    char const* Message() const override { return __messagE__.c_str(); }      \
-    ::gerr::Error const& Cause() const override { return __causE__; }         \
-    ContextType& Context() { return __contexT__; }                            \
+ public:                                                                      \
+  __ErrTypE__(__PrivateStruct__, ::gerr::Error __c__, ContextType __ctX__,    \
+              ::std::string __msG__)                                          \
+      : ContextDefinedError{(__ErrCodE__), ::std::move(__c__),                \
+                            ::std::move(__ctX__), ::std::move(__msG__)} {}    \
                                                                               \
-   private:                                                                   \
-    ::gerr::Error __causE__{};                                                \
-    ContextType __contexT__{};                                                \
-    ::std::string __messagE__{};                                              \
+  static ::gerr::Error E(::gerr::Error __c__, ContextType context) noexcept { \
+    return ::gerr::details::DefinedE<__ErrTypE__, __ErrTypE__##_GErrTag>(     \
+        __PrivateStruct__{}, (__ErrCodE__), ::std::move(__c__),               \
+        ::std::move(context));                                                \
   }
 
+/**
+ * 定义 GERR_STRIP_MESSAGES 后，所有的错误信息都会在编译期被去掉：
+ * DEFINE_* 宏的错误信息和格式化字符串会被替换为形如 "#1a2b3c4d" 的站点 ID
+ * （错误信息字面量的 FNV-1a 哈希），环境信息不再参与格式化；
+ * gerr::New / gerr::Wrap 的错误信息会被替换为空字符串，参数也不会被格式化。
+ * 错误码、错误类型和错误链条不受影响。
+ *
+ * 站点 ID 和原始错误信息的对应关系可以通过 gerr_sidecar 工具离线生成，
+ * 参考 CMakeLists.txt 中的 gerr_message_sidecar 函数。
+ */
+#ifdef GERR_STRIP_MESSAGES
+#define GERR_STATIC_MESSAGE(__ErrMessagE__) \
+  ::gerr::details::SiteId<::gerr::details::Fnv1a(__ErrMessagE__)>::value
+#define GERR_FORMAT_CONTEXT_MESSAGE(__ErrFormaT__, ...) \
+  ((void)context, ::std::string{GERR_STATIC_MESSAGE(__ErrFormaT__)})
+#else
+#define GERR_STATIC_MESSAGE(__ErrMessagE__) __ErrMessagE__
+#if FMT_USE_CONSTEXPR
+#define GERR_FORMAT_CONTEXT_MESSAGE(__ErrFormaT__, ...) \
+  ::fmt::format(FMT_STRING(__ErrFormaT__), __VA_ARGS__)
+#else
+// 编译器不支持 C++14 的 constexpr 时 FMT_STRING 无法在编译期检查，只会让每个
+// 错误类型各自实例化一份检查代码并在每次格式化时多解析一遍，因此直接运行期格式化
+#define GERR_FORMAT_CONTEXT_MESSAGE(__ErrFormaT__, ...) \
+  ::gerr::details::FormatRuntime(__ErrFormaT__, __VA_ARGS__)
+#endif
+#endif
+
+/**
+ * 和 FMT_STRING 一样把格式化字符串字面量包装为编译期格式化字符串，同时在类型中
+ * 记录它需要的参数个数，gerr::New / gerr::Wrap 在 C++11 下也能在编译期发现
+ * 参数过多或过少（FMT_STRING 在 C++11 下无法在编译期读取，只有 C++14 及以上才检查）。
+ * C++14 及以上 fmt 还会像 FMT_STRING 一样检查格式说明和参数类型。
+ * Example:
+ *   return gerr::New(GERR_FMT("fail to call: uin={}"), uin);
+ */
+#define GERR_FMT(__FormaT__)                                                  \
+  [] {                                                                        \
+    struct __FormatString__ : ::gerr::details::CompileStringBase {            \
+      using char_type = char;                                                 \
+      using ArgCount =                                                        \
+          ::std::integral_constant<::std::size_t,                             \
+                                   ::gerr::details::FormatArgCount(           \
+                                       __FormaT__)>;                          \
+      FMT_CONSTEXPR operator ::fmt::string_view() const {                     \
+        return {__FormaT__, sizeof(__FormaT__) - 1};                          \
+      }                                                                       \
+    };                                                                        \
+    return __FormatString__{};                                                \
+  }()
+
+// 标记不希望被内联的函数，用于把所有错误类型共享的逻辑收敛到一份代码里
+#if defined(_MSC_VER)
+#define GERR_NOINLINE __declspec(noinline)
+#else
+#define GERR_NOINLINE __attribute__((noinline))
+#endif
+
+/**
+ * 默认以 header-only 的方式使用，所有实现都在 gerr-inl.hpp 中以 inline 的形式提供。
+ * 定义 GERR_COMPILED_LIB 后（链接 CMake 中的 gerr 目标时会自动定义），
+ * 头文件只保留声明和模板，格式化、错误链条遍历等非模板代码编译到 gerr 库中。
+ * 以动态库形式构建时还需要定义 GERR_SHARED_LIB。
+ */
+#ifdef GERR_COMPILED_LIB
+#define GERR_INLINE
+#if defined(GERR_SHARED_LIB) && defined(_WIN32)
+#ifdef gerr_EXPORTS
+#define GERR_API __declspec(dllexport)
+#else
+#define GERR_API __declspec(dllimport)
+#endif
+#elif defined(GERR_SHARED_LIB)
+#define GERR_API __attribute__((visibility("default")))
+#else
+#define GERR_API
+#endif
+#else
+#define GERR_INLINE inline
+#define GERR_API
+#endif
+
 namespace gerr {
 
 namespace details {
@@ -379,10 +316,7 @@ using Error = std::shared_ptr<details::IError>;
 
 namespace details {
 
-Error const& NoError() {
-  static Error noError = nullptr;
-  return noError;
-}
+GERR_API GERR_INLINE Error const& NoError();
 
 /**
  * 错误的基础类型，所有的错误都应该继承自这个类型。
@@ -407,7 +341,7 @@ Error const& NoError() {
  *       return nullptr;
  *   }
  */
-struct IError : std::enable_shared_from_this<IError> {
+struct GERR_API IError : std::enable_shared_from_this<IError> {
   virtual ~IError() = 0;
   // override 此函数来返回错误码
   virtual int Code() const { return 0; }
@@ -415,36 +349,19 @@ struct IError : std::enable_shared_from_this<IError> {
   virtual char const* Message() const { return nullptr; }
   // override 此函数来返回父错误
   virtual Error const& Cause() const { return NoError(); }
+  // override 此函数来返回节点在自身之外持有的堆内存字节数（不包括父错误），
+  // 例如 std::string 成员在短字符串优化之外申请的内存，用于 gerr::MemoryUsage
+  virtual std::size_t HeapUsage() const { return 0; }
 
   Error AsError() { return shared_from_this(); }
-
-  friend std::ostream& operator<<(std::ostream& os, IError const& err) {
-    for (auto p = &err;;) {
-      auto const c = p->Code();
-      auto const msg = p->Message();
-      auto const hasMsg = msg != nullptr && msg[0] != '\0';
-      if (c != 0 && hasMsg) {
-        // 同时持有非 0 的 code 和 message，同时打印
-        os << c << ":" << msg;
-      } else if (c == 0) {
-        // 如果 code == 0，就只打印 message
-        os << msg;
-      } else {  // c != 0 && !hasMsg
-        // 如果 message 是空，就只打印 code
-        os << std::to_string(c);
-      }
-      auto const& next = p->Cause();
-      if (next != nullptr) {
-        os << ":";
-        p = next.get();
-      } else {
-        break;
-      }
-    }
-    return os;
-  }
 };
 
+/**
+ * 将整个错误链条格式化输出到 os 中，格式参考 gerr::String
+ */
+GERR_API GERR_INLINE std::ostream& operator<<(std::ostream& os,
+                                              IError const& err);
+
 inline IError::~IError() {}
 
 }  // namespace details
@@ -484,6 +401,15 @@ bool Is(std::shared_ptr<OriginErr> const& err) {
   return As<ExpectErr>(err) != nullptr;
 }
 
+namespace details {
+
+/** 非模板的错误链条遍历和格式化实现，gerr::AsCode / Code / String 均转发到这里 */
+GERR_API GERR_INLINE Error FindCode(int code, Error const& err);
+GERR_API GERR_INLINE int FirstCode(IError const& err, int defaultErrCode);
+GERR_API GERR_INLINE std::string ToString(IError const& err);
+
+}  // namespace details
+
 /**
  * 查找错误链条上是否存在带有指定错误码的错误，
  * 在错误链条上没有找到任何相同错误码时，返回 nullptr。
@@ -494,16 +420,10 @@ template <class ErrType, class = typename std::enable_if<std::is_base_of<
                              details::IError, ErrType>::value>::type>
 Error AsCode(int code, std::shared_ptr<ErrType> const& err) {
   if (err == nullptr) {
-    return 0;
-  }
-
-  for (auto p = std::static_pointer_cast<details::IError>(err); p != nullptr;
-       p = p->Cause()) {
-    if (p->Code() == code) {
-      return p;
-    }
+    return nullptr;
   }
-  return nullptr;
+  return details::FindCode(code,
+                           std::static_pointer_cast<details::IError>(err));
 }
 
 /**
@@ -532,9 +452,7 @@ std::string String(std::shared_ptr<ErrType> const& err) {
   if (err == nullptr) {
     return "<nil>";
   }
-  std::ostringstream oss{};
-  oss << *(static_cast<details::IError const*>(err.get()));
-  return oss.str();
+  return details::ToString(*err);
 }
 
 /**
@@ -547,23 +465,208 @@ int Code(std::shared_ptr<ErrType> const& err, int defaultErrCode = -1) {
   if (err == nullptr) {
     return 0;
   }
+  return details::FirstCode(*err, defaultErrCode);
+}
+
+namespace details {
+
+GERR_API GERR_INLINE std::size_t ChainMemoryUsage(Error const& err);
+
+}  // namespace details
+
+/**
+ * 统计错误链条持有的内存字节数，包括每个节点和它的控制块、节点在自身之外持有的
+ * 堆内存（错误信息字符串、环境信息等，参考 IError::HeapUsage）。
+ * 常驻的静态节点（静态的 E()、不带格式化参数的 New、FromErrno 等返回的节点）
+ * 不属于任何一条链条，遇到时停止统计；被多条链条共享的父错误在每条链条上都会计入。
+ * 只有通过 gerr::Make / New / Wrap / E 等接口创建的节点才能得知节点本身的大小，
+ * 其他方式创建的节点只计入 HeapUsage。统计的是向 operator new 申请的字节数，
+ * 不包括内存分配器自身的开销。
+ * 允许传入 nullptr，此时返回 0。
+ */
+template <class ErrType, class = typename std::enable_if<std::is_base_of<
+                             details::IError, ErrType>::value>::type>
+std::size_t MemoryUsage(std::shared_ptr<ErrType> const& err) {
+  return details::ChainMemoryUsage(
+      std::static_pointer_cast<details::IError>(err));
+}
+
+/**
+ * 对结构相等的错误去重：错误链条上每个节点的类型、错误码和错误信息都相同时，
+ * 返回之前已经登记过的那个错误，否则登记 err 并原样返回。适用于缓存、重试队列中
+ * 大量重复的 gerr::New / gerr::Wrap 错误，相等的错误因此共享同一个节点。
+ *
+ * 只有错误信息和错误码就能完整描述内容的节点才参与去重：New / Wrap 创建的节点、
+ * DEFINE_ERROR / DEFINE_CODE_ERROR 的 E(cause) 以及 FromErrno 的节点；
+ * 链条上有其他类型的节点（例如带环境信息的错误、自定义错误）时原样返回 err。
+ * 常驻节点和 nullptr 也原样返回。
+ *
+ * 登记表分片加锁，只持有弱引用，不会延长错误的对象生命周期。但节点和控制块是
+ * 同一次分配，失效的条目在被清理之前仍然占着整个节点的内存；每次登记都会顺带
+ * 清理所在分片中固定数量的桶，因此失效条目只会残留一小部分，但错误大多互不相同、
+ * 很快释放时，内存占用仍然会高于不去重。
+ *
+ * 每次 Intern 都要遍历整条链条计算哈希（在锁外），再在分片锁内和哈希相同的条目
+ * 比较，开销随链条深度线性增长。定义 GERR_INTERN_ERRORS 时，New / Wrap 创建的
+ * 每个错误都会自动经过 Intern，也就是每次 Wrap 都要付出一次 O(链条深度) 的哈希、
+ * 一次加锁和一个登记表条目，只适合大量保存重复错误的程序，不建议默认打开。
+ * Example:
+ *   retryQueue.push_back(gerr::Intern(gerr::Wrap(err, "send to {}", host)));
+ */
+GERR_API GERR_INLINE Error Intern(Error err) noexcept;
+
+/** 按错误类型和错误码汇总的存活错误节点 */
+struct LiveGroup {
+  std::string type;
+  int code;
+  std::size_t count;
+  std::size_t bytes;
+};
+
+/**
+ * 存活错误统计，用于排查被长期持有的错误。定义 GERR_TRACK_LIVE 后（CMake 选项
+ * GERR_TRACK_LIVE），通过 gerr::Make / New / Wrap / E 等接口在堆上创建的每个
+ * 错误节点都会挂在创建线程的链表上，记录类型、错误码、字节数和创建时间，
+ * 节点释放时摘除；常驻的静态节点不在统计范围内。登记不会因为内存不足而失败，
+ * 无法为线程分配链表时它创建的节点不参与统计。节点本身的布局不受影响，
+ * 登记信息放在节点所在内存块的前面。整个程序（以及 gerr 库）必须一致地定义或
+ * 不定义 GERR_TRACK_LIVE。
+ *
+ * LiveErrors 返回按类型和错误码汇总的节点数和字节数（计算方式同
+ * gerr::MemoryUsage，按字节数从大到小排序），未开启时返回空。
+ */
+GERR_API GERR_INLINE std::vector<LiveGroup> LiveErrors();
+
+/**
+ * 将存活错误的汇总，以及最早创建的 limit 个仍然存活的节点（类型、错误码、
+ * 存活时间和创建时记录下的调用栈）写入文件描述符 fd，未开启时只输出一行提示。
+ * 会加锁和分配内存，不能在信号处理函数中调用。
+ * Example:
+ *   if (gerr::LiveErrors().size() > kExpectedKinds) {
+ *       gerr::DumpLive(STDERR_FILENO);
+ *   }
+ */
+GERR_API GERR_INLINE void DumpLive(int fd, std::size_t limit = 16);
+
+/**
+ * 开启 GERR_TRACK_LIVE 时，每个线程每创建 every 个节点记录一次创建时的调用栈，
+ * 供 DumpLive 输出。默认为 0，不记录：::backtrace 的开销远大于登记本身。
+ * 排查时可以先设为 1 复现问题，或者设为 100 之类的值抽样。未开启时不做任何事。
+ */
+GERR_API GERR_INLINE void SetLiveBacktraceSampling(unsigned every) noexcept;
+
+/**
+ * 错误的只读视图，不持有错误对象，也不修改引用计数。
+ * gerr::Error 和 gerr::LocalError 都可以隐式转换为 ErrorView，
+ * 下面接受 ErrorView 的 As / Is / IsCode / Code / String 因此对两者都适用。
+ * ErrorView 不能比它引用的错误活得更久。
+ */
+class ErrorView {
+ public:
+  ErrorView(std::nullptr_t = nullptr) {}
+  ErrorView(details::IError const* err) : err_{err} {}
+
+  template <class ErrType, class = typename std::enable_if<std::is_base_of<
+                               details::IError, ErrType>::value>::type>
+  ErrorView(std::shared_ptr<ErrType> const& err) : err_{err.get()} {}
+
+  details::IError const* Get() const { return err_; }
+  details::IError const& operator*() const { return *err_; }
+  details::IError const* operator->() const { return err_; }
+
+  friend bool operator==(ErrorView err, std::nullptr_t) {
+    return err.err_ == nullptr;
+  }
+  friend bool operator!=(ErrorView err, std::nullptr_t) {
+    return err.err_ != nullptr;
+  }
 
-  for (auto p = std::static_pointer_cast<details::IError>(err); p != nullptr;
-       p = p->Cause()) {
-    auto const c = p->Code();
-    if (c != 0) {
-      return c;
+ private:
+  details::IError const* err_{};
+};
+
+/**
+ * 同 gerr::As，但是返回的是错误链条上对应节点的裸指针，不修改引用计数。
+ */
+template <class ExpectErr, class = typename std::enable_if<std::is_base_of<
+                               details::IError, ExpectErr>::value>::type>
+ExpectErr const* As(ErrorView err) {
+  for (auto p = err.Get(); p != nullptr; p = p->Cause().get()) {
+    auto p1 = dynamic_cast<ExpectErr const*>(p);
+    if (p1 != nullptr) {
+      return p1;
     }
   }
-  return defaultErrCode;
+  return nullptr;
 }
 
+template <class ExpectErr, class = typename std::enable_if<std::is_base_of<
+                               details::IError, ExpectErr>::value>::type>
+bool Is(ErrorView err) {
+  return As<ExpectErr>(err) != nullptr;
+}
+
+/** 同 gerr::IsCode / gerr::Code / gerr::String，作用于 ErrorView */
+GERR_API GERR_INLINE bool IsCode(int code, ErrorView err);
+GERR_API GERR_INLINE int Code(ErrorView err, int defaultErrCode = -1);
+GERR_API GERR_INLINE std::string String(ErrorView err);
+
+/**
+ * 错误链条的结构相等和哈希。gerr::Error 自带的 == 和 std::hash 只比较指针，
+ * 需要按内容比较时（以错误为键统计、对错误去重等）使用下面的函数。
+ *
+ * ShapeEqual / ShapeHash 只比较链条的形状：长度以及每个节点的类型和错误码，
+ * 不关心错误信息，"连接 a 超时" 和 "连接 b 超时" 被认为相同；New / Wrap 创建的
+ * 节点视为同一种类型，例如 New("x") 和 New("{}", "x") 相等；
+ * DeepEqual / DeepHash 还会比较每个节点的错误信息。带环境信息的错误只通过
+ * 格式化后的错误信息参与比较，自定义错误的其他成员不参与比较。
+ *
+ * 两条链条走到同一个节点（共享的父错误）时直接认为剩余部分相等；错误信息
+ * 先比较指针，静态错误信息因此不需要逐字节比较。两个 nullptr 相等。
+ */
+GERR_API GERR_INLINE bool ShapeEqual(ErrorView lhs, ErrorView rhs);
+GERR_API GERR_INLINE std::size_t ShapeHash(ErrorView err);
+GERR_API GERR_INLINE bool DeepEqual(ErrorView lhs, ErrorView rhs);
+GERR_API GERR_INLINE std::size_t DeepHash(ErrorView err);
+
+/**
+ * 用作 unordered_map / unordered_set 的 Hash 和 KeyEqual 模板参数。
+ * Example:
+ *   std::unordered_map<gerr::Error, int, gerr::DeepHasher, gerr::DeepEqualTo>
+ *       counts;
+ *   ++counts[err];
+ */
+struct ShapeHasher {
+  std::size_t operator()(ErrorView err) const { return ShapeHash(err); }
+};
+
+struct ShapeEqualTo {
+  bool operator()(ErrorView lhs, ErrorView rhs) const {
+    return ShapeEqual(lhs, rhs);
+  }
+};
+
+struct DeepHasher {
+  std::size_t operator()(ErrorView err) const { return DeepHash(err); }
+};
+
+struct DeepEqualTo {
+  bool operator()(ErrorView lhs, ErrorView rhs) const {
+    return DeepEqual(lhs, rhs);
+  }
+};
+
 /**
  * 这里定义了一堆错误类型，主要是为了实现上的高效，尽可能让错误类型占用的内存减少。
  * 一般使用的时候不需要关心。
  */
 namespace details {
 
+/** std::string 在短字符串优化之外申请的堆内存字节数 */
+inline std::size_t StringHeapUsage(std::string const& s) {
+  return s.capacity() > std::string{}.capacity() ? s.capacity() + 1 : 0;
+}
+
 /** 只包含一个 C 风格字符串的错误 */
 class RawStrMessageError : public IError {
  public:
@@ -583,6 +686,9 @@ class MessageError : public IError {
   int Code() const override { return 0; }
   char const* Message() const override { return errorMessage_.c_str(); }
   Error const& Cause() const override { return NoError(); }
+  std::size_t HeapUsage() const override {
+    return StringHeapUsage(errorMessage_);
+  }
 
  private:
   std::string errorMessage_{};
@@ -610,6 +716,9 @@ class CodeMessageError : public IError {
   int Code() const override { return errorCode_; }
   char const* Message() const override { return errorMessage_.c_str(); }
   Error const& Cause() const override { return NoError(); }
+  std::size_t HeapUsage() const override {
+    return StringHeapUsage(errorMessage_);
+  }
 
  private:
   int errorCode_{};
@@ -652,6 +761,9 @@ class MessageSubError : public IError {
   int Code() const override { return 0; }
   char const* Message() const override { return errorMessage_.c_str(); }
   Error const& Cause() const override { return causeError_; }
+  std::size_t HeapUsage() const override {
+    return StringHeapUsage(errorMessage_);
+  }
 
  private:
   std::string errorMessage_{};
@@ -685,6 +797,9 @@ class CodeMessageSubError : public IError {
   int Code() const override { return errorCode_; }
   char const* Message() const override { return errorMessage_.c_str(); }
   Error const& Cause() const override { return causeError_; }
+  std::size_t HeapUsage() const override {
+    return StringHeapUsage(errorMessage_);
+  }
 
  private:
   int errorCode_{};
@@ -710,114 +825,1023 @@ class CodeMessageSubError : public IError {
  *   if (ret != 0 || rsp.ret != 0) {
  *     return gerr::Make<MyErrType>(ret, rsp.ret, rsp.msg);
  *   }
+ *
+ * 不会抛出异常，内存不足时返回一个 gerr::details::OutOfMemoryError 后备错误；
+ * ErrType 的构造函数抛出其他异常时，返回错误信息为
+ * "exception thrown while creating error" 的普通错误。
  */
-template <class ErrType, class... Args>
-inline Error Make(Args&&... args) {
-  auto p = std::make_shared<ErrType>(std::forward<Args>(args)...);
-  return std::static_pointer_cast<details::IError>(p);
-}
+namespace details {
 
 /**
- * 新建一个 err 对象，附加额外的错误信息
- * Example:
- *   auto const ok = CallSomeFunction();
- *   if (!ok) {
- *       return gerr::New("error occurs !");
- *   }
+ * 创建错误的过程中内存不足时使用的后备错误，保留错误码、静态的错误信息和父错误。
+ * 节点连同控制块构造在预留的静态槽位上，获取时不会分配内存，节点释放时槽位归还，
+ * 父错误也随之释放。同时存活的后备错误超过 64 个时，返回一个只有通用错误信息、
+ * 没有父错误的共享节点。
+ * msg 为 nullptr 时错误信息为 "out of memory while creating error"。
  */
-inline Error New(char const* msg) {
-  return Make<details::RawStrMessageError>(msg);
-}
+class OutOfMemoryError : public IError {
+ public:
+  OutOfMemoryError(int code, char const* msg, Error cause) noexcept
+      : errorCode_{code},
+        errorMessage_{msg},
+        causeError_{std::move(cause)} {}
+
+  int Code() const override { return errorCode_; }
+  char const* Message() const override {
+    return errorMessage_ != nullptr ? errorMessage_
+                                    : "out of memory while creating error";
+  }
+  Error const& Cause() const override { return causeError_; }
+
+ private:
+  int errorCode_{};
+  char const* errorMessage_{};
+  Error causeError_{};
+};
+
+GERR_API GERR_INLINE Error OutOfMemory(int code, char const* msg,
+                                       Error cause) noexcept;
 
 /**
- * 新建一个 err 对象，附加额外的错误信息
- * Example:
- *   auto const ok = CallSomeFunction();
- *   if (!ok) {
- *       return gerr::New("fail to call: uin={}", uin);
- *   }
+ * 创建错误时抛出了 std::bad_alloc 以外的异常（例如自定义错误类型的构造函数），
+ * 返回保留错误码和父错误的普通错误，错误信息为 msg，msg 为 nullptr 时为
+ * "exception thrown while creating error"。创建这个错误时内存不足则返回 OutOfMemory。
  */
-template <class... Args>
-inline Error New(char const* formatStr, Args&&... args) {
-  return Make<details::MessageError>(
-      fmt::format(formatStr, std::forward<Args>(args)...));
-}
+GERR_API GERR_INLINE Error CreateFailed(int code, char const* msg,
+                                        Error cause) noexcept;
 
-template <class... Args>
-inline Error New(std::string const& formatStr, Args&&... args) {
-  return Make<details::MessageError>(
-      fmt::format(formatStr, std::forward<Args>(args)...));
-}
+/** 记录 / 查询 MakeShared 为错误类型 type 的节点（连同控制块）分配的字节数 */
+GERR_API GERR_INLINE void RegisterNodeSize(std::type_info const& type,
+                                           std::size_t bytes) noexcept;
+GERR_API GERR_INLINE std::size_t NodeSize(std::type_info const& type) noexcept;
+
+/** 将 text 完整写入文件描述符 fd，写入失败时放弃剩余部分 */
+GERR_API GERR_INLINE void WriteFd(int fd, std::string const& text);
 
+#ifdef GERR_TRACK_LIVE
 /**
- * 新建一个 err 对象，附加额外的错误码和错误信息
- * Example:
- *   auto const ok = CallSomeFunction();
- *   if (!ok) {
- *       return gerr::New(kMyErrorCode, "error occurs!");
- *   }
+ * 存活错误节点的登记信息，放在 MakeShared 分配的内存块（控制块和节点）之前，
+ * 不改变节点本身的布局。通过 prev / next 挂在创建线程的链表上，
+ * 节点释放时从链表上摘除；list 为 nullptr 表示这个块没有登记。
  */
-inline Error New(int code, char const* msg) {
-  return Make<details::CodeRawStrMessageError>(code, msg);
-}
+struct alignas(alignof(std::max_align_t)) LiveHeader {
+  static constexpr int kMaxFrames = 8;
+
+  LiveHeader* prev{};
+  LiveHeader* next{};
+  void* list{};
+  void const* node{};
+  std::type_info const* type{};
+  int code{};
+  std::size_t bytes{};
+  std::int64_t createdNs{};
+  int frameCount{};
+  void* frames[kMaxFrames]{};
+};
+
+/** 登记一个刚分配的内存块，此时节点还没有构造 */
+GERR_API GERR_INLINE void LiveLink(LiveHeader* header,
+                                   std::type_info const& type,
+                                   std::size_t bytes) noexcept;
+/** 节点构造完成后补充错误码和节点在自身之外持有的堆内存 */
+GERR_API GERR_INLINE void LiveFinish(LiveHeader* header,
+                                     IError const& node) noexcept;
+GERR_API GERR_INLINE void LiveUnlink(LiveHeader* header) noexcept;
+#endif
 
 /**
- * 新建一个 err 对象，附加额外的错误码和错误信息
- * Example:
- *   auto const ok = CallSomeFunction();
- *   if (!ok) {
- *       return gerr::New(kMyErrorCode, "fail to call: uin={}", uin);
- *   }
+ * MakeShared 使用的分配器，和 std::allocator 一样直接调用 operator new，
+ * 第一次为某个错误类型分配内存时通过 RegisterNodeSize 记录分配的字节数。
+ * 定义 GERR_TRACK_LIVE 时，每个内存块前面额外放置一个 LiveHeader：
+ * header 不为 nullptr 时登记这个块并通过 *header 交给调用方补充节点信息，
+ * 为 nullptr 时（将要成为常驻节点的块）不登记。
  */
-template <class... Args>
-inline Error New(int code, std::string const& formatStr, Args&&... args) {
-  return Make<details::CodeMessageError>(
-      code, fmt::format(formatStr, std::forward<Args>(args)...));
+template <class T, class ErrType>
+struct NodeAllocator {
+  using value_type = T;
+
+#ifdef GERR_TRACK_LIVE
+  explicit NodeAllocator(LiveHeader** out) : header{out} {}
+  template <class U>
+  NodeAllocator(NodeAllocator<U, ErrType> const& other)
+      : header{other.header} {}
+#else
+  NodeAllocator() = default;
+  template <class U>
+  NodeAllocator(NodeAllocator<U, ErrType> const&) {}
+#endif
+
+  T* allocate(std::size_t n) {
+    static bool const registered =
+        (RegisterNodeSize(typeid(ErrType), n * sizeof(T)), true);
+    (void)registered;
+#ifdef GERR_TRACK_LIVE
+    auto const raw =
+        static_cast<char*>(::operator new(sizeof(LiveHeader) + n * sizeof(T)));
+    auto const block = new (raw) LiveHeader{};
+    if (header != nullptr) {
+      LiveLink(block, typeid(ErrType), n * sizeof(T));
+      *header = block;
+    }
+    return reinterpret_cast<T*>(raw + sizeof(LiveHeader));
+#else
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+#endif
+  }
+  void deallocate(T* p, std::size_t) noexcept {
+#ifdef GERR_TRACK_LIVE
+    auto const raw = reinterpret_cast<char*>(p) - sizeof(LiveHeader);
+    LiveUnlink(reinterpret_cast<LiveHeader*>(raw));
+    ::operator delete(raw);
+#else
+    ::operator delete(p);
+#endif
+  }
+
+  template <class U>
+  bool operator==(NodeAllocator<U, ErrType> const&) const {
+    return true;
+  }
+  template <class U>
+  bool operator!=(NodeAllocator<U, ErrType> const&) const {
+    return false;
+  }
+
+#ifdef GERR_TRACK_LIVE
+  // 只在 allocate 中使用；控制块里保存的副本在 MakeShared 返回后不再读取它
+  LiveHeader** header{};
+#endif
+};
+
+#ifdef GERR_INTERN_ERRORS
+/**
+ * New / Wrap 创建的节点类型，GERR_INTERN_ERRORS 模式下创建后自动 Intern，
+ * 开销见 gerr::Intern 的说明
+ */
+template <class ErrType>
+struct IsMessageNode
+    : std::integral_constant<
+          bool, std::is_same<ErrType, RawStrMessageError>::value ||
+                    std::is_same<ErrType, MessageError>::value ||
+                    std::is_same<ErrType, CodeRawStrMessageError>::value ||
+                    std::is_same<ErrType, CodeMessageError>::value ||
+                    std::is_same<ErrType, CodeSubError>::value ||
+                    std::is_same<ErrType, RawStrMessageSubError>::value ||
+                    std::is_same<ErrType, MessageSubError>::value ||
+                    std::is_same<ErrType, CodeRawStrMessageSubError>::value ||
+                    std::is_same<ErrType, CodeMessageSubError>::value> {};
+#endif
+
+/** 用 NodeAllocator 创建节点，tracked 为 false 时不参与存活统计 */
+template <class ErrType, class... Args>
+inline std::shared_ptr<ErrType> AllocateNode(bool tracked, Args&&... args) {
+#ifdef GERR_TRACK_LIVE
+  LiveHeader* header = nullptr;
+  auto p = std::allocate_shared<ErrType>(
+      NodeAllocator<ErrType, ErrType>{tracked ? &header : nullptr},
+      std::forward<Args>(args)...);
+  if (header != nullptr) {
+    LiveFinish(header, *p);
+  }
+  return p;
+#else
+  (void)tracked;
+  return std::allocate_shared<ErrType>(NodeAllocator<ErrType, ErrType>{},
+                                       std::forward<Args>(args)...);
+#endif
 }
 
-template <class... Args>
-inline Error New(int code, char const* formatStr, Args&&... args) {
-  return Make<details::CodeMessageError>(
-      code, fmt::format(formatStr, std::forward<Args>(args)...));
+template <class ErrType, class... Args>
+inline Error MakeShared(Args&&... args) {
+  auto p = AllocateNode<ErrType>(true, std::forward<Args>(args)...);
+#ifdef GERR_INTERN_ERRORS
+  if (IsMessageNode<ErrType>::value) {
+    return Intern(std::static_pointer_cast<IError>(std::move(p)));
+  }
+#endif
+  return std::static_pointer_cast<IError>(p);
 }
 
 /**
- * 包装一个 err 对象，附加额外的错误信息
- * Example:
- *   auto const err = CallSomeFunction();
- *   if (err != nullptr) {
- *       return gerr::Wrap(err, "call some function fail");
- *   }
+ * 同 MakeShared，用于将要交给 MakeImmortal / PublishImmortal 成为常驻节点的
+ * 错误：节点从创建起就不参与存活统计，常驻之后也不需要再从统计中摘除。
  */
-template <class... Args>
-inline Error Wrap(Error err, char const* msg) {
-  auto ptr =
-      std::make_shared<details::RawStrMessageSubError>(msg, std::move(err));
-  return std::static_pointer_cast<details::IError>(ptr);
+template <class ErrType, class... Args>
+inline Error MakeResident(Args&&... args) {
+  return AllocateNode<ErrType>(false, std::forward<Args>(args)...);
 }
 
 /**
- * 包装一个 err 对象，附加额外的错误信息
- * Example:
- *   auto const err = CallSomeFunction();
- *   if (err != nullptr) {
- *       return gerr::Wrap(err, "addition info: uin={}, clienttype={}", uin,
- *       clienttype);
- *   }
+ * 调用 fn 创建错误，fn 抛出 std::bad_alloc 时改为返回 OutOfMemory(code, msg, cause)，
+ * 抛出其他异常时返回 CreateFailed(code, msg, cause)。
+ * fn 只有在成功时才会移走 cause。
  */
-template <class... Args>
-inline Error Wrap(Error err, std::string const& formatStr, Args&&... args) {
-  return Make<details::MessageSubError>(
-      fmt::format(formatStr, std::forward<Args>(args)...), std::move(err));
+template <class Fn>
+inline Error TryCreate(Fn fn, int code, char const* msg,
+                       Error& cause) noexcept {
+  try {
+    return fn();
+  } catch (std::bad_alloc const&) {
+    return OutOfMemory(code, msg, std::move(cause));
+  } catch (...) {
+    return CreateFailed(code, msg, std::move(cause));
+  }
 }
 
-template <class... Args>
-inline Error Wrap(Error err, char const* formatStr, Args&&... args) {
-  return Make<details::MessageSubError>(
-      fmt::format(formatStr, std::forward<Args>(args)...), std::move(err));
+template <class Fn>
+inline Error TryCreate(Fn fn, int code, char const* msg) noexcept {
+  try {
+    return fn();
+  } catch (std::bad_alloc const&) {
+    return OutOfMemory(code, msg, nullptr);
+  } catch (...) {
+    return CreateFailed(code, msg, nullptr);
+  }
 }
 
-/**
+}  // namespace details
+
+template <class ErrType, class... Args>
+inline Error Make(Args&&... args) noexcept {
+  return details::TryCreate(
+      [&] { return details::MakeShared<ErrType>(std::forward<Args>(args)...); },
+      0, nullptr);
+}
+
+namespace details {
+
+/**
+ * 让 owner 指向的错误节点永远存活，返回一个不持有所有权的 Error。
+ * 返回值和它的拷贝都不带控制块，拷贝和析构时不会修改引用计数。
+ * 内存不足时抛出 std::bad_alloc，此时节点不会常驻。
+ * owner 应当由 MakeResident 或 std::make_shared 创建，否则开启 GERR_TRACK_LIVE
+ * 时它会一直留在存活统计中。PublishImmortal 同理。
+ */
+GERR_API GERR_INLINE Error MakeImmortal(Error owner);
+
+/** 接管 new 出来的 holder，有意不释放它，使它指向的节点永远存活 */
+GERR_API GERR_INLINE void PinImmortal(Error* holder) noexcept;
+
+/**
+ * 把 owner 指向的节点发布到常驻节点表的空槽 slot 中并让它常驻，各个常驻节点表共用。
+ * 持有节点的引用在发布之前分配，分配失败时抛出 std::bad_alloc 并且 slot 保持不变，
+ * 因此其他线程从 slot 中读到的节点总是已经常驻。
+ * slot 已经被其他线程占用时返回 false，已有的节点写入 expected，owner 不受影响。
+ */
+template <class Node>
+bool PublishImmortal(std::atomic<Node*>& slot, Node*& expected,
+                     Error const& owner) {
+  std::unique_ptr<Error> holder{new Error{owner}};
+  expected = nullptr;
+  if (!slot.compare_exchange_strong(expected, static_cast<Node*>(owner.get()),
+                                    std::memory_order_acq_rel)) {
+    return false;
+  }
+  PinImmortal(holder.release());
+  return true;
+}
+
+/**
+ * 查找或创建一个只包含错误码和静态字符串的常驻错误节点，相同的 code 和 msg
+ * 指针总是返回同一个节点，因此除了第一次之外都不会分配内存。
+ * 表以指针为键且节点永不释放，msg 必须是字符串常量等静态存储期的字符串，
+ * 否则会留下悬空的键并占满表。
+ * 常驻节点保存在一张固定容量（1024 项）的无锁表中，表满之后退化为普通的堆上节点。
+ */
+GERR_API GERR_INLINE Error StaticCodeError(int code, char const* msg);
+
+/**
+ * gerr::DefineError 的公共基类，所有自定义错误类型共享同一份
+ * Code / Cause 的实现，避免每个错误类型都各自生成一份。
+ */
+class DefinedErrorBase : public IError {
+ public:
+  int Code() const override { return errorCode_; }
+  Error const& Cause() const override { return causeError_; }
+
+ protected:
+  GERR_NOINLINE DefinedErrorBase(int code, Error cause)
+      : errorCode_{code}, causeError_{std::move(cause)} {}
+  GERR_NOINLINE ~DefinedErrorBase() override {}
+
+ private:
+  int errorCode_{};
+  Error causeError_{};
+};
+
+/** 错误信息是一个 C 风格字符串常量的自定义错误 */
+class StaticDefinedError : public DefinedErrorBase {
+ public:
+  char const* Message() const override { return errorMessage_; }
+
+ protected:
+  GERR_NOINLINE StaticDefinedError(int code, char const* message, Error cause)
+      : DefinedErrorBase{code, std::move(cause)}, errorMessage_{message} {}
+
+ private:
+  char const* errorMessage_{};
+};
+
+/** 错误信息由环境信息格式化而来的自定义错误 */
+class FormattedDefinedError : public DefinedErrorBase {
+ public:
+  char const* Message() const override { return errorMessage_.c_str(); }
+  std::size_t HeapUsage() const override {
+    return StringHeapUsage(errorMessage_);
+  }
+
+ protected:
+  GERR_NOINLINE FormattedDefinedError(int code, std::string message,
+                                      Error cause)
+      : DefinedErrorBase{code, std::move(cause)},
+        errorMessage_{std::move(message)} {}
+  GERR_NOINLINE ~FormattedDefinedError() override {}
+
+ private:
+  std::string errorMessage_{};
+};
+
+/**
+ * 环境信息在自身之外持有的堆内存字节数：std::string 按实际容量计算；
+ * 其他类型可以在其所在的命名空间中提供 std::size_t HeapUsage(T const&)，
+ * 通过 ADL 找到，否则按 0 计算。
+ */
+inline std::size_t ContextHeapUsage(std::string const& context, int) {
+  return StringHeapUsage(context);
+}
+
+template <class T>
+auto ContextHeapUsage(T const& context, int)
+    -> decltype(static_cast<std::size_t>(HeapUsage(context))) {
+  return static_cast<std::size_t>(HeapUsage(context));
+}
+
+template <class T>
+std::size_t ContextHeapUsage(T const&, long) {
+  return 0;
+}
+
+/** 获取 Tag 的 StaticMessage()，没有时返回 nullptr */
+template <class Tag>
+constexpr auto TagStaticMessage(int) -> decltype(Tag::StaticMessage()) {
+  return Tag::StaticMessage();
+}
+
+template <class Tag>
+constexpr char const* TagStaticMessage(long) {
+  return nullptr;
+}
+
+/**
+ * 带环境信息的自定义错误的公共基类，按环境信息的类型共享，
+ * 不同的错误类型只要环境信息的类型相同，就共用同一份实现。
+ */
+template <class ContextT>
+class ContextDefinedError : public FormattedDefinedError {
+ public:
+  using ContextType = ContextT;
+
+  ContextType& Context() { return context_; }
+  ContextType const& Context() const { return context_; }
+
+  std::size_t HeapUsage() const override {
+    return FormattedDefinedError::HeapUsage() + ContextHeapUsage(context_, 0);
+  }
+
+ protected:
+  ContextDefinedError(int code, Error cause, ContextType context,
+                      std::string message)
+      : FormattedDefinedError{code, std::move(message), std::move(cause)},
+        context_{std::move(context)} {}
+
+ private:
+  ContextType context_{};
+};
+
+/**
+ * DEFINE_*_MEMO_CONTEXT_ERROR 按环境信息的值缓存错误节点的表，每个错误类型一张，
+ * 开放寻址，只插入不删除，插入的节点成为常驻节点，容量固定因此常驻节点的个数有上限。
+ */
+template <class Node>
+class MemoTable {
+ public:
+  static constexpr std::size_t kCapacity = 64;
+  static constexpr std::size_t kMaxProbe = 8;
+
+  static MemoTable& Instance() {
+    static MemoTable table{};
+    return table;
+  }
+
+  /**
+   * 查找环境信息等于 context 的节点，找不到时通过 create(true) 创建并尝试插入，
+   * 插入成功或者找到时返回常驻节点；表满，或者空槽被其他线程抢先插入了
+   * 不同的节点时，返回 create(false) 创建的普通节点。
+   */
+  template <class Context, class Create>
+  Error FindOrCreate(Context const& context, Create create) {
+    auto i = std::hash<Context>{}(context) * 0x9e3779b97f4a7c15ull >> 40;
+    for (std::size_t n = 0; n < kMaxProbe; ++n, ++i) {
+      auto& slot = slots_[i % kCapacity];
+      auto node = slot.load(std::memory_order_acquire);
+      if (node == nullptr) {
+        auto const owner = create(true);
+        if (PublishImmortal(slot, node, owner)) {
+          return Error{Error{}, owner.get()};
+        }
+        if (node->Context() == context) {
+          return Error{Error{}, node};
+        }
+        return create(false);
+      }
+      if (node->Context() == context) {
+        return Error{Error{}, node};
+      }
+    }
+    return create(false);
+  }
+
+ private:
+  std::atomic<Node*> slots_[kCapacity]{};
+};
+
+/**
+ * DEFINE_* 宏生成的错误类型和 gerr::DefineError 共用的 E 的实现。
+ * Node 是错误类型，Key 是 Node 构造函数的私有标记，Tag 提供错误信息
+ * （见 gerr::DefineError），code 是错误码，只用于内存不足时的后备错误，
+ * 节点本身的错误码由 Node 的构造函数设置。
+ * 内存不足时返回保留了错误码和静态错误信息的后备错误。
+ */
+template <class Node, class Tag, class Key>
+Error DefinedE(Key key, int code) noexcept {
+  // 静态变量初始化时抛出异常的话，下次调用会重新尝试初始化
+  return TryCreate(
+      [&] {
+        static auto const value =
+            MakeImmortal(MakeResident<Node>(key, Error{}));
+        return value;
+      },
+      code, Tag::StaticMessage());
+}
+
+template <class Node, class Tag, class Key>
+GERR_NOINLINE Error DefinedE(Key key, int code, Error cause) noexcept {
+  return TryCreate([&] { return MakeShared<Node>(key, std::move(cause)); },
+                   code, Tag::StaticMessage(), cause);
+}
+
+template <class Node, class Tag, class Key, class Context>
+GERR_NOINLINE Error DefinedE(Key key, int code, Error cause,
+                             Context context) noexcept {
+  return TryCreate(
+      [&] {
+        auto message = Tag::FormatMessage(context);
+        return MakeShared<Node>(key, std::move(cause), std::move(context),
+                                std::move(message));
+      },
+      code, TagStaticMessage<Tag>(0), cause);
+}
+
+/** 同 DefinedE(key, code, nullptr, context)，但是相同的环境信息复用 MemoTable 中的常驻节点 */
+template <class Node, class Tag, class Key, class Context>
+GERR_NOINLINE Error MemoDefinedE(Key key, int code, Context context) noexcept {
+  return TryCreate(
+      [&] {
+        // create 内存不足时抛出异常，缓存表不会登记后备错误
+        return MemoTable<Node>::Instance().FindOrCreate(
+            context, [&](bool resident) {
+              auto message = Tag::FormatMessage(context);
+              return resident ? MakeResident<Node>(key, Error{}, context,
+                                                   std::move(message))
+                              : MakeShared<Node>(key, Error{}, context,
+                                                 std::move(message));
+            });
+      },
+      code, TagStaticMessage<Tag>(0));
+}
+
+}  // namespace details
+
+/**
+ * 自定义错误类型的模板实现，和 DEFINE_* 系列宏生成的类共用同一套基类和 E 的实现，
+ * 适用于需要在模板中生成错误类型等不方便使用宏的场景。
+ * Tag 用于区分不同的错误类型并提供错误信息，ErrCode 是错误码，
+ * ContextT 是环境信息类型，为 void 时表示不携带环境信息。
+ *
+ * 不带环境信息时，Tag 需要提供 static char const* StaticMessage()；
+ * 带环境信息时，Tag 需要提供 static std::string FormatMessage(ContextT const&)，
+ * 可选地提供 StaticMessage()，作为内存不足时后备错误的错误信息。
+ *
+ * 所有的 E 都不会抛出异常，内存不足时返回保留了错误码和静态错误信息的
+ * gerr::details::OutOfMemoryError 后备错误。
+ *
+ * Example:
+ *   struct MyErrorTag {
+ *     static constexpr char const* StaticMessage() { return "my error"; }
+ *   };
+ *   using MyError = gerr::DefineError<MyErrorTag, 123>;
+ */
+template <class Tag, int ErrCode = 0, class ContextT = void>
+class DefineError : public details::ContextDefinedError<ContextT> {
+ protected:
+  struct Key {};
+
+ public:
+  DefineError(Key, Error cause, ContextT context, std::string message)
+      : details::ContextDefinedError<ContextT>{ErrCode, std::move(cause),
+                                               std::move(context),
+                                               std::move(message)} {}
+
+  static Error E(ContextT context) noexcept {
+    return E(nullptr, std::move(context));
+  }
+
+  static Error E(Error cause, ContextT context) noexcept {
+    return details::DefinedE<DefineError, Tag>(Key{}, ErrCode, std::move(cause),
+                                               std::move(context));
+  }
+};
+
+template <class Tag, int ErrCode>
+class DefineError<Tag, ErrCode, void> : public details::StaticDefinedError {
+ protected:
+  struct Key {};
+
+ public:
+  DefineError(Key, Error cause)
+      : StaticDefinedError{ErrCode, Tag::StaticMessage(), std::move(cause)} {}
+
+  static Error E() noexcept {
+    return details::DefinedE<DefineError, Tag>(Key{}, ErrCode);
+  }
+
+  static Error E(Error cause) noexcept {
+    return details::DefinedE<DefineError, Tag>(Key{}, ErrCode,
+                                               std::move(cause));
+  }
+};
+
+namespace details {
+
+/**
+ * 判断 S 是否是编译期格式化字符串，即 GERR_FMT / FMT_STRING / FMT_COMPILE 的结果。
+ * 占位符和参数个数的检查见 FormatArgsMatch。
+ */
+#if FMT_VERSION >= 80000
+using CompileStringBase = fmt::detail::compile_string;
+
+template <class S>
+struct IsCompileTimeFormat
+    : std::integral_constant<
+          bool, std::is_base_of<fmt::detail::compile_string, S>::value ||
+                    std::is_base_of<fmt::detail::compiled_string, S>::value> {
+};
+#else
+using CompileStringBase = fmt::compile_string;
+
+template <class S>
+struct IsCompileTimeFormat : fmt::is_compile_string<S> {};
+#endif
+
+/** 无法在编译期确定格式化字符串需要几个参数（手动编号、命名参数或者不是字面量）*/
+constexpr std::size_t kUnknownArgCount = static_cast<std::size_t>(-1);
+
+// s[i] 之前连续的 '{' 的个数
+constexpr std::size_t OpenBraceRun(char const* s, std::size_t i) {
+  return i > 0 && s[i - 1] == '{' ? 1 + OpenBraceRun(s, i - 1) : 0;
+}
+
+// s[i] 开始的替换字段需要的参数个数：不是替换字段（包括转义的 "{{"）时为 0，
+// 自动编号的字段（"{}"、"{:...}"，以及格式说明中嵌套的 "{}"）为 1
+constexpr std::size_t FieldArgCount(char const* s, std::size_t n,
+                                    std::size_t i) {
+  return s[i] != '{' || (i + 1 < n && s[i + 1] == '{') ||
+                 OpenBraceRun(s, i) % 2 != 0
+             ? 0
+         : i + 1 < n && (s[i + 1] == '}' || s[i + 1] == ':')
+             ? 1
+             : kUnknownArgCount;
+}
+
+constexpr std::size_t AddArgCount(std::size_t a, std::size_t b) {
+  return a == kUnknownArgCount || b == kUnknownArgCount ? kUnknownArgCount
+                                                        : a + b;
+}
+
+// 二分递归，C++11 的 constexpr 递归深度只和长度的对数有关，长字符串也不会超出限制
+constexpr std::size_t CountFormatArgs(char const* s, std::size_t n,
+                                      std::size_t lo, std::size_t hi) {
+  return hi - lo == 1
+             ? FieldArgCount(s, n, lo)
+             : AddArgCount(CountFormatArgs(s, n, lo, lo + (hi - lo) / 2),
+                           CountFormatArgs(s, n, lo + (hi - lo) / 2, hi));
+}
+
+/** 在编译期计算长度为 n 的格式化字符串 s 需要的参数个数 */
+constexpr std::size_t FormatArgCount(char const* s, std::size_t n) {
+  return n == 0 ? 0 : CountFormatArgs(s, n, 0, n);
+}
+
+template <std::size_t N>
+constexpr std::size_t FormatArgCount(char const (&s)[N]) {
+  return FormatArgCount(s, s[N - 1] == '\0' ? N - 1 : N);
+}
+
+template <class T>
+constexpr std::size_t FormatArgCount(T const&) {
+  return kUnknownArgCount;
+}
+
+constexpr bool ArgCountMatches(std::size_t placeholders, std::size_t args) {
+  return placeholders == kUnknownArgCount || placeholders == args;
+}
+
+/** 只用于在 decltype 中计算参数个数 */
+template <class... Args>
+std::integral_constant<std::size_t, sizeof...(Args)> CountArgs(Args const&...);
+
+template <class T>
+struct MakeVoid {
+  using type = void;
+};
+
+/**
+ * 编译期格式化字符串 S 需要的参数个数：GERR_FMT 的结果在类型中记录了个数，
+ * C++14 及以上可以在编译期读出 FMT_STRING / FMT_COMPILE 的内容，
+ * C++11 下 fmt 的格式化字符串无法在编译期读取，为 kUnknownArgCount。
+ */
+template <class S, class = void>
+struct FormatArgCountOf
+#if FMT_USE_CONSTEXPR
+    : std::integral_constant<
+          std::size_t,
+          FormatArgCount(static_cast<fmt::string_view>(S{}).data(),
+                         static_cast<fmt::string_view>(S{}).size())> {
+};
+#else
+    : std::integral_constant<std::size_t, kUnknownArgCount> {
+};
+#endif
+
+template <class S>
+struct FormatArgCountOf<S, typename MakeVoid<typename S::ArgCount>::type>
+    : S::ArgCount {};
+
+/**
+ * 编译期格式化字符串 S 的占位符个数是否和参数个数一致，无法确定个数时视为一致。
+ * 参数过多和过少都会被发现：GERR_FMT 在 C++11 及以上检查，
+ * FMT_STRING / FMT_COMPILE 在 C++14 及以上检查。
+ */
+template <class S, class... Args>
+constexpr bool FormatArgsMatch() {
+  return ArgCountMatches(FormatArgCountOf<S>::value, sizeof...(Args));
+}
+
+/** 计算字符串的 32 位 FNV-1a 哈希，用于生成错误信息的站点 ID */
+constexpr std::uint32_t Fnv1a(char const* s, std::uint32_t h = 2166136261u) {
+  return *s == '\0' ? h
+                    : Fnv1a(s + 1, (h ^ static_cast<unsigned char>(*s)) *
+                                       16777619u);
+}
+
+constexpr char HexDigit(std::uint32_t v) {
+  return "0123456789abcdef"[v & 0xf];
+}
+
+/** 站点 ID 的字符串形式 "#xxxxxxxx"，在编译期生成 */
+template <std::uint32_t Hash>
+struct SiteId {
+  static constexpr char value[] = {
+      '#',
+      HexDigit(Hash >> 28),
+      HexDigit(Hash >> 24),
+      HexDigit(Hash >> 20),
+      HexDigit(Hash >> 16),
+      HexDigit(Hash >> 12),
+      HexDigit(Hash >> 8),
+      HexDigit(Hash >> 4),
+      HexDigit(Hash),
+      '\0',
+  };
+};
+
+template <std::uint32_t Hash>
+constexpr char SiteId<Hash>::value[];
+
+template <class... Args>
+inline void Ignore(Args const&...) {}
+
+/** gerr::New / gerr::Wrap 中的 C 风格字符串错误信息 */
+constexpr char const* StaticMessage(char const* msg) {
+#ifdef GERR_STRIP_MESSAGES
+  return (void)msg, "";
+#else
+  return msg;
+#endif
+}
+
+/**
+ * 所有运行期格式化共享的非模板实现。格式化字符串和参数不匹配时不抛出
+ * fmt::format_error，而是原样返回格式化字符串，错误本身和它的父错误都会保留。
+ */
+GERR_API GERR_INLINE std::string VFormat(fmt::string_view formatStr,
+                                         fmt::format_args args);
+
+/** 运行期解析格式化字符串，所有调用共享同一份非模板的 VFormat */
+template <class... Args>
+inline std::string FormatRuntime(fmt::string_view formatStr,
+                                 Args const&... args) {
+#ifdef GERR_STRIP_MESSAGES
+  (void)formatStr;
+  Ignore(args...);
+  return {};
+#else
+  return VFormat(formatStr, fmt::make_format_args(args...));
+#endif
+}
+
+/**
+ * 使用编译期格式化字符串 S 格式化。fmt 只有在 C++14 及以上才能在编译期检查 S，
+ * C++11 下的检查发生在运行期，因此直接按运行期格式化处理，不匹配时的行为同 VFormat。
+ */
+template <class S, class... Args>
+inline std::string FormatCompileTime(Args&&... args) {
+#ifdef GERR_STRIP_MESSAGES
+  Ignore(args...);
+  return {};
+#elif FMT_USE_CONSTEXPR
+  return fmt::format(S{}, std::forward<Args>(args)...);
+#else
+  return FormatRuntime(static_cast<fmt::string_view>(S{}), args...);
+#endif
+}
+
+/** 编译期格式化字符串 S 的原始字符串，用作内存不足时后备错误的错误信息 */
+template <class S>
+inline char const* CompileTimeFormatStr() {
+  return StaticMessage(static_cast<fmt::string_view>(S{}).data());
+}
+
+}  // namespace details
+
+/**
+ * 下面所有的 gerr::New / gerr::Wrap 都不会抛出异常，内存不足时返回
+ * gerr::details::OutOfMemoryError 后备错误，保留错误码和静态的错误信息
+ * （带格式化参数时为格式化字符串本身）以及被包装的父错误。
+ */
+
+/**
+ * 新建一个 err 对象，附加额外的错误信息
+ * msg 为字符串常量时返回常驻节点，相同的字符串常量只在第一次调用时分配内存。
+ * 常驻节点的 Error 不带控制块，use_count() 为 0，从它构造的 std::weak_ptr
+ * 一开始就是 expired()，lock() 得到 nullptr，不能用 weak_ptr 观察它的生命周期。
+ * 只有 char const 数组（字符串常量或静态存储期的常量数组）会进入常驻节点表，
+ * 不要传入局部的 char const 数组。
+ * Example:
+ *   auto const ok = CallSomeFunction();
+ *   if (!ok) {
+ *       return gerr::New("error occurs !");
+ *   }
+ */
+template <std::size_t N>
+inline Error New(char const (&msg)[N]) noexcept {
+  return details::TryCreate(
+      [&] { return details::StaticCodeError(0, details::StaticMessage(msg)); },
+      0, details::StaticMessage(msg));
+}
+
+/** 可写的字符数组一般是临时缓冲区，复制一份错误信息，不进入常驻节点表 */
+template <std::size_t N>
+inline Error New(char (&msg)[N]) noexcept {
+  return details::TryCreate(
+      [&] {
+        return details::MakeShared<details::MessageError>(
+            std::string{details::StaticMessage(msg)});
+      },
+      0, nullptr);
+}
+
+/**
+ * msg 为字符指针时不复制也不缓存，只保存指针本身，
+ * 调用方需要保证 msg 指向的字符串比错误对象存活得更久。
+ */
+template <class T, class = typename std::enable_if<
+                       std::is_pointer<T>::value &&
+                       std::is_convertible<T, char const*>::value>::type>
+inline Error New(T msg) noexcept {
+  return details::TryCreate(
+      [&] {
+        return details::MakeShared<details::RawStrMessageError>(
+            details::StaticMessage(msg));
+      },
+      0, details::StaticMessage(msg));
+}
+
+/**
+ * 新建一个 err 对象，附加额外的错误信息
+ * Example:
+ *   auto const ok = CallSomeFunction();
+ *   if (!ok) {
+ *       return gerr::New("fail to call: uin={}", uin);
+ *   }
+ */
+template <class Arg, class... Args>
+inline Error New(char const* formatStr, Arg&& arg, Args&&... args) noexcept {
+  return details::TryCreate(
+      [&] {
+        return details::MakeShared<details::MessageError>(
+            details::FormatRuntime(formatStr, arg, args...));
+      },
+      0, details::StaticMessage(formatStr));
+}
+
+template <class... Args>
+inline Error New(std::string const& formatStr, Args&&... args) noexcept {
+  return details::TryCreate(
+      [&] {
+        return details::MakeShared<details::MessageError>(
+            details::FormatRuntime(formatStr, args...));
+      },
+      0, nullptr);
+}
+
+/**
+ * 使用编译期格式化字符串新建一个 err 对象。占位符和参数个数不一致时无法通过编译：
+ * GERR_FMT 在 C++11 及以上检查，FMT_STRING / FMT_COMPILE 在 C++14 及以上检查；
+ * C++14 及以上 fmt 还会检查格式说明和参数类型。
+ * 格式化字符串的内容保存在类型 S 中，因此这里直接使用 S{} 而不是参数本身，
+ * 以保证在 C++20 下也能作为常量表达式传给 fmt。
+ * Example:
+ *   auto const ok = CallSomeFunction();
+ *   if (!ok) {
+ *       return gerr::New(GERR_FMT("fail to call: uin={}"), uin);
+ *   }
+ */
+template <class S, class... Args,
+          class = typename std::enable_if<
+              details::IsCompileTimeFormat<S>::value>::type>
+inline Error New(S const&, Args&&... args) noexcept {
+  static_assert(details::FormatArgsMatch<S, Args...>(),
+                "the number of format arguments does not match the format "
+                "string");
+  return details::TryCreate(
+      [&] {
+        return details::MakeShared<details::MessageError>(
+            details::FormatCompileTime<S>(std::forward<Args>(args)...));
+      },
+      0, details::CompileTimeFormatStr<S>());
+}
+
+/**
+ * 新建一个 err 对象，附加额外的错误码和错误信息
+ * 和 New(msg) 一样，只有字符串常量会返回以 (code, msg) 为键的常驻节点。
+ * Example:
+ *   auto const ok = CallSomeFunction();
+ *   if (!ok) {
+ *       return gerr::New(kMyErrorCode, "error occurs!");
+ *   }
+ */
+template <std::size_t N>
+inline Error New(int code, char const (&msg)[N]) noexcept {
+  return details::TryCreate(
+      [&] {
+        return details::StaticCodeError(code, details::StaticMessage(msg));
+      },
+      code, details::StaticMessage(msg));
+}
+
+template <std::size_t N>
+inline Error New(int code, char (&msg)[N]) noexcept {
+  return details::TryCreate(
+      [&] {
+        return details::MakeShared<details::CodeMessageError>(
+            code, std::string{details::StaticMessage(msg)});
+      },
+      code, nullptr);
+}
+
+template <class T, class = typename std::enable_if<
+                       std::is_pointer<T>::value &&
+                       std::is_convertible<T, char const*>::value>::type>
+inline Error New(int code, T msg) noexcept {
+  return details::TryCreate(
+      [&] {
+        return details::MakeShared<details::CodeRawStrMessageError>(
+            code, details::StaticMessage(msg));
+      },
+      code, details::StaticMessage(msg));
+}
+
+/**
+ * 新建一个 err 对象，附加额外的错误码和错误信息
+ * Example:
+ *   auto const ok = CallSomeFunction();
+ *   if (!ok) {
+ *       return gerr::New(kMyErrorCode, "fail to call: uin={}", uin);
+ *   }
+ */
+template <class... Args>
+inline Error New(int code, std::string const& formatStr,
+                 Args&&... args) noexcept {
+  return details::TryCreate(
+      [&] {
+        return details::MakeShared<details::CodeMessageError>(
+            code, details::FormatRuntime(formatStr, args...));
+      },
+      code, nullptr);
+}
+
+template <class Arg, class... Args>
+inline Error New(int code, char const* formatStr, Arg&& arg,
+                 Args&&... args) noexcept {
+  return details::TryCreate(
+      [&] {
+        return details::MakeShared<details::CodeMessageError>(
+            code, details::FormatRuntime(formatStr, arg, args...));
+      },
+      code, details::StaticMessage(formatStr));
+}
+
+template <class S, class... Args,
+          class = typename std::enable_if<
+              details::IsCompileTimeFormat<S>::value>::type>
+inline Error New(int code, S const&, Args&&... args) noexcept {
+  static_assert(details::FormatArgsMatch<S, Args...>(),
+                "the number of format arguments does not match the format "
+                "string");
+  return details::TryCreate(
+      [&] {
+        return details::MakeShared<details::CodeMessageError>(
+            code, details::FormatCompileTime<S>(std::forward<Args>(args)...));
+      },
+      code, details::CompileTimeFormatStr<S>());
+}
+
+/**
+ * 包装一个 err 对象，附加额外的错误信息
+ * Example:
+ *   auto const err = CallSomeFunction();
+ *   if (err != nullptr) {
+ *       return gerr::Wrap(err, "call some function fail");
+ *   }
+ */
+template <class... Args>
+inline Error Wrap(Error err, char const* msg) noexcept {
+  return details::TryCreate(
+      [&] {
+        return details::MakeShared<details::RawStrMessageSubError>(
+            details::StaticMessage(msg), std::move(err));
+      },
+      0, details::StaticMessage(msg), err);
+}
+
+/**
+ * 包装一个 err 对象，附加额外的错误信息
+ * Example:
+ *   auto const err = CallSomeFunction();
+ *   if (err != nullptr) {
+ *       return gerr::Wrap(err, "addition info: uin={}, clienttype={}", uin,
+ *       clienttype);
+ *   }
+ */
+template <class... Args>
+inline Error Wrap(Error err, std::string const& formatStr,
+                  Args&&... args) noexcept {
+  return details::TryCreate(
+      [&] {
+        return details::MakeShared<details::MessageSubError>(
+            details::FormatRuntime(formatStr, args...), std::move(err));
+      },
+      0, nullptr, err);
+}
+
+template <class... Args>
+inline Error Wrap(Error err, char const* formatStr, Args&&... args) noexcept {
+  return details::TryCreate(
+      [&] {
+        return details::MakeShared<details::MessageSubError>(
+            details::FormatRuntime(formatStr, args...), std::move(err));
+      },
+      0, details::StaticMessage(formatStr), err);
+}
+
+template <class S, class... Args,
+          class = typename std::enable_if<
+              details::IsCompileTimeFormat<S>::value>::type>
+inline Error Wrap(Error err, S const&, Args&&... args) noexcept {
+  static_assert(details::FormatArgsMatch<S, Args...>(),
+                "the number of format arguments does not match the format "
+                "string");
+  return details::TryCreate(
+      [&] {
+        return details::MakeShared<details::MessageSubError>(
+            details::FormatCompileTime<S>(std::forward<Args>(args)...),
+            std::move(err));
+      },
+      0, details::CompileTimeFormatStr<S>(), err);
+}
+
+/**
  * 包装一个 err 对象，附加一个错误码
  * Example:
  *   auto const err = CallSomeFunction();
@@ -826,8 +1850,12 @@ inline Error Wrap(Error err, char const* formatStr, Args&&... args) {
  *   }
  */
 template <class... Args>
-inline Error Wrap(Error err, int code) {
-  return Make<details::CodeSubError>(code, std::move(err));
+inline Error Wrap(Error err, int code) noexcept {
+  return details::TryCreate(
+      [&] {
+        return details::MakeShared<details::CodeSubError>(code, std::move(err));
+      },
+      code, nullptr, err);
 }
 
 /**
@@ -839,8 +1867,13 @@ inline Error Wrap(Error err, int code) {
  *   }
  */
 template <class... Args>
-inline Error Wrap(Error err, int code, char const* msg) {
-  return Make<details::CodeRawStrMessageSubError>(code, msg, std::move(err));
+inline Error Wrap(Error err, int code, char const* msg) noexcept {
+  return details::TryCreate(
+      [&] {
+        return details::MakeShared<details::CodeRawStrMessageSubError>(
+            code, details::StaticMessage(msg), std::move(err));
+      },
+      code, details::StaticMessage(msg), err);
 }
 
 /**
@@ -853,17 +1886,281 @@ inline Error Wrap(Error err, int code, char const* msg) {
  */
 template <class... Args>
 inline Error Wrap(Error err, int code, std::string const& formatStr,
-                  Args&&... args) {
-  return Make<details::CodeMessageSubError>(
-      code, fmt::format(formatStr, std::forward<Args>(args)...),
-      std::move(err));
+                  Args&&... args) noexcept {
+  return details::TryCreate(
+      [&] {
+        return details::MakeShared<details::CodeMessageSubError>(
+            code, details::FormatRuntime(formatStr, args...), std::move(err));
+      },
+      code, nullptr, err);
 }
 
 template <class... Args>
-inline Error Wrap(Error err, int code, char const* formatStr, Args&&... args) {
-  return Make<details::CodeMessageSubError>(
-      code, fmt::format(formatStr, std::forward<Args>(args)...),
-      std::move(err));
+inline Error Wrap(Error err, int code, char const* formatStr,
+                  Args&&... args) noexcept {
+  return details::TryCreate(
+      [&] {
+        return details::MakeShared<details::CodeMessageSubError>(
+            code, details::FormatRuntime(formatStr, args...), std::move(err));
+      },
+      code, details::StaticMessage(formatStr), err);
+}
+
+template <class S, class... Args,
+          class = typename std::enable_if<
+              details::IsCompileTimeFormat<S>::value>::type>
+inline Error Wrap(Error err, int code, S const&, Args&&... args) noexcept {
+  static_assert(details::FormatArgsMatch<S, Args...>(),
+                "the number of format arguments does not match the format "
+                "string");
+  return details::TryCreate(
+      [&] {
+        return details::MakeShared<details::CodeMessageSubError>(
+            code, details::FormatCompileTime<S>(std::forward<Args>(args)...),
+            std::move(err));
+      },
+      code, details::CompileTimeFormatStr<S>(), err);
 }
 
+namespace details {
+
+/** 把格式化结果写入定长缓冲区，超出部分被截断，返回写入的长度 */
+GERR_API GERR_INLINE std::size_t VFormatTo(char* buffer, std::size_t size,
+                                           fmt::string_view formatStr,
+                                           fmt::format_args args);
+
+/** gerr::LocalError 内联持有的错误节点 */
+class LocalNode : public IError {
+ public:
+  static constexpr std::size_t kBufferSize = 64;
+
+  LocalNode(int code, char const* message)
+      : errorCode_{code}, errorMessage_{message} {}
+
+  template <class... Args>
+  LocalNode(int code, fmt::string_view formatStr, Args const&... args)
+      : errorCode_{code}, formatted_{true} {
+#ifdef GERR_STRIP_MESSAGES
+    (void)formatStr;
+    Ignore(args...);
+#else
+    VFormatTo(buffer_, kBufferSize, formatStr, fmt::make_format_args(args...));
+#endif
+  }
+
+  int Code() const override { return errorCode_; }
+  char const* Message() const override {
+    return formatted_ ? buffer_ : errorMessage_;
+  }
+
+  bool Formatted() const { return formatted_; }
+
+ private:
+  int errorCode_{};
+  bool formatted_{};
+  char const* errorMessage_{};
+  char buffer_[kBufferSize]{};
+};
+
+}  // namespace details
+
+/**
+ * 完全存放在栈上的错误，用于不会传递到调用方之外的错误路径：
+ * 创建、判定和打印都不会分配内存，只有调用 Escape 的时候才会转换为堆上的
+ * gerr::Error。可以通过 ErrorView 使用 gerr::Is / IsCode / Code / String。
+ * 格式化后的错误信息最多保留 LocalNode::kBufferSize - 1 个字符，超出部分被截断。
+ * Example:
+ *   gerr::LocalError ParseDigit(char c, int* out) {
+ *       if (c < '0' || c > '9') {
+ *           return {kBadDigit, "bad digit: {}", c};
+ *       }
+ *       *out = c - '0';
+ *       return nullptr;
+ *   }
+ *
+ *   auto err = ParseDigit(c, &d);
+ *   if (gerr::IsCode(kBadDigit, err)) {
+ *       return gerr::Wrap(err.Escape(), "parse fail"); // 只在这里分配内存
+ *   }
+ */
+class LocalError {
+ public:
+  LocalError(std::nullptr_t = nullptr) {}
+
+  LocalError(char const* msg)
+      : hasError_{true}, node_{0, details::StaticMessage(msg)} {}
+
+  LocalError(int code, char const* msg)
+      : hasError_{true}, node_{code, details::StaticMessage(msg)} {}
+
+  template <class Arg, class... Args>
+  LocalError(int code, char const* formatStr, Arg const& arg,
+             Args const&... args)
+      : hasError_{true}, node_{code, formatStr, arg, args...} {}
+
+  operator ErrorView() const {
+    return hasError_ ? ErrorView{&node_} : ErrorView{};
+  }
+
+  /** 转换为堆上的 gerr::Error，没有错误时返回 nullptr */
+  Error Escape() const noexcept {
+    if (!hasError_) {
+      return nullptr;
+    }
+    if (node_.Formatted()) {
+      return details::TryCreate(
+          [&] {
+            return details::MakeShared<details::CodeMessageError>(
+                node_.Code(), node_.Message());
+          },
+          node_.Code(), nullptr);
+    }
+    return New(node_.Code(), node_.Message());
+  }
+
+  friend bool operator==(LocalError const& err, std::nullptr_t) {
+    return !err.hasError_;
+  }
+  friend bool operator!=(LocalError const& err, std::nullptr_t) {
+    return err.hasError_;
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, LocalError const& err) {
+    return details::operator<<(os, err.node_);
+  }
+
+ private:
+  bool hasError_{};
+  details::LocalNode node_{0, static_cast<char const*>(nullptr)};
+};
+
+namespace details {
+
+/** 保证渲染函数只被执行一次，其他线程等待渲染完成，用于延迟生成错误信息 */
+class RenderOnce {
+ public:
+  template <class Fn>
+  void Call(Fn fn) const {
+    if (state_.load(std::memory_order_acquire) == kDone) {
+      return;
+    }
+    int expected = kIdle;
+    if (state_.compare_exchange_strong(expected, kBusy,
+                                       std::memory_order_acquire)) {
+      fn();
+      state_.store(kDone, std::memory_order_release);
+      return;
+    }
+    while (state_.load(std::memory_order_acquire) != kDone) {
+    }
+  }
+
+  bool Done() const { return state_.load(std::memory_order_acquire) == kDone; }
+
+ private:
+  enum { kIdle, kBusy, kDone };
+  mutable std::atomic<int> state_{kIdle};
+};
+
+/**
+ * 来自 errno 的错误，只保存 errno 的值，错误信息在第一次被读取时才通过
+ * strerror_r 生成，保存在节点内部。常见的 errno 有预先分配的常驻节点。
+ */
+class GERR_API ErrnoError : public IError {
+ public:
+  static constexpr std::size_t kBufferSize = 64;
+
+  explicit ErrnoError(int value) : value_{value} {}
+
+  int Code() const override { return value_; }
+  char const* Message() const override {
+    once_.Call([this] { Render(); });
+    return buffer_;
+  }
+
+  int Value() const { return value_; }
+
+ private:
+  GERR_INLINE void Render() const;
+
+  int value_{};
+  RenderOnce once_{};
+  mutable char buffer_[kBufferSize]{};
+};
+
+/**
+ * 能还原出原始 std::error_code 的错误节点，gerr::ToErrorCode 通过它取回
+ * 错误码的类别，而不要求节点是某个具体的错误类型。
+ */
+class ErrorCodeSource {
+ public:
+  virtual std::error_code ErrorCode() const = 0;
+
+ protected:
+  ~ErrorCodeSource() = default;
+};
+
+/**
+ * 来自 std::error_code 的错误，保存错误码的值和错误类别的指针，
+ * 错误信息在第一次被读取时才通过 std::error_category::message 生成。
+ */
+class GERR_API ErrorCodeError : public IError, public ErrorCodeSource {
+ public:
+  explicit ErrorCodeError(std::error_code const& ec)
+      : value_{ec.value()}, category_{&ec.category()} {}
+
+  int Code() const override { return value_; }
+  char const* Message() const override {
+    once_.Call([this] { errorMessage_ = category_->message(value_); });
+    return errorMessage_.c_str();
+  }
+
+  std::error_code ErrorCode() const override { return {value_, *category_}; }
+
+  std::size_t HeapUsage() const override {
+    // 错误信息还没有生成时不能读取，此时也没有持有堆内存
+    return once_.Done() ? StringHeapUsage(errorMessage_) : 0;
+  }
+
+ private:
+  int value_{};
+  std::error_category const* category_{};
+  RenderOnce once_{};
+  mutable std::string errorMessage_{};
+};
+
+}  // namespace details
+
+/**
+ * 从 errno 构建一个错误，不会立即生成错误信息，errno 为 0 时返回 nullptr。
+ * 小于 160 的 errno（Linux / macOS 上定义的全部 errno）对应程序启动时预先分配的
+ * 常驻错误对象，不会分配内存。
+ * Example:
+ *   if (::open(path, O_RDONLY) < 0) {
+ *       return gerr::Wrap(gerr::FromErrno(errno), "open {}", path);
+ *   }
+ */
+GERR_API GERR_INLINE Error FromErrno(int value) noexcept;
+
+/**
+ * 从 std::error_code 构建一个错误，不会立即生成错误信息，ec 为空时返回 nullptr。
+ * generic_category 的错误码等同于 gerr::FromErrno。
+ */
+GERR_API GERR_INLINE Error FromErrorCode(std::error_code const& ec) noexcept;
+
+/** 不是来自 errno 或 std::error_code 的错误转换为 std::error_code 时使用的类别 */
+GERR_API GERR_INLINE std::error_category const& ErrorCategory();
+
+/**
+ * 将错误转换为 std::error_code，用于需要 std::error_code 的接口。
+ * 错误链条上第一个来自 errno 或 std::error_code 的错误会被还原为原来的
+ * std::error_code，否则返回 gerr::Code(err) 和 gerr::ErrorCategory()。
+ * 传入 nullptr 时返回空的 std::error_code。
+ */
+GERR_API GERR_INLINE std::error_code ToErrorCode(ErrorView err);
+
 }  // namespace gerr
+
+#ifndef GERR_COMPILED_LIB
+#include "gerr-inl.hpp"
+#endif
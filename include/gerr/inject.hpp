@@ -0,0 +1,301 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <gerr/gerr.hpp>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * 故障注入点，用于在接近线上的构建中压测错误处理路径。
+ * 命中注入规则时，从当前函数返回 ErrType::E()，因此 ErrType 必须是
+ * DEFINE_ERROR / DEFINE_CODE_ERROR 定义的不带环境信息的错误类型，
+ * 所在函数的返回值要能由 gerr::Error 构造（如 gerr::Error、gerr::Result<T>）。
+ * site 是字符串字面量，和 ErrType 的名字（按注入点处书写的原样）一起
+ * 作为匹配注入规则的键，规则见 gerr::SetInjectConfig。
+ * 没有生效的注入配置时，每个注入点只有一次 relaxed 原子读和一次分支。
+ * Example:
+ *   gerr::Error Query(Request const& req) {
+ *       GERR_INJECT("db.query", ErrTimeout);
+ *       ...
+ *   }
+ */
+#define GERR_INJECT(__SitE__, __ErrTypE__)                                  \
+  do {                                                                      \
+    if (::gerr::details::InjectConfigSlot().load(                           \
+            ::std::memory_order_relaxed) != nullptr) {                      \
+      static ::gerr::details::InjectPoint __gerrInjectPoinT__{__SitE__,     \
+                                                              #__ErrTypE__}; \
+      if (__gerrInjectPoinT__.Fire()) {                                     \
+        return ::gerr::details::InjectedError<__ErrTypE__>();               \
+      }                                                                     \
+    }                                                                       \
+  } while (false)
+
+namespace gerr {
+
+namespace details {
+
+/** 一条注入规则，按概率或者每 N 次调用注入一次 */
+struct InjectRule {
+  std::string site;  // "*" 匹配任意站点，以 '*' 结尾时按前缀匹配
+  std::string type;  // 为空时匹配任意错误类型
+  std::uint64_t threshold{};  // 随机数小于该值时注入，按概率换算而来
+  std::uint64_t every{};      // 非 0 时每 every 次调用注入一次
+
+  bool Match(char const* pointSite, char const* pointType) const {
+    if (!type.empty() && type != pointType) {
+      return false;
+    }
+    if (!site.empty() && site.back() == '*') {
+      return std::strncmp(pointSite, site.c_str(), site.size() - 1) == 0;
+    }
+    return site == pointSite;
+  }
+};
+
+/** 解析后的注入配置，发布之后不再修改 */
+struct InjectConfig {
+  std::vector<InjectRule> rules;
+};
+
+/** 当前生效的注入配置，为 nullptr 时所有注入点都不生效 */
+inline std::atomic<InjectConfig const*>& InjectConfigSlot() noexcept {
+  static std::atomic<InjectConfig const*> slot{nullptr};
+  return slot;
+}
+
+/**
+ * 发布新的注入配置。注入点可能仍在读取旧的配置，因此被替换的配置不会释放，
+ * 重新加载配置应当是低频操作。
+ */
+inline void PublishInjectConfig(std::unique_ptr<InjectConfig> config) {
+  static std::mutex mu;
+  static auto const retired = new std::vector<std::unique_ptr<InjectConfig>>{};
+  std::lock_guard<std::mutex> lock{mu};
+  if (config != nullptr && config->rules.empty()) {
+    config.reset();
+  }
+  InjectConfigSlot().store(config.get(), std::memory_order_release);
+  if (config != nullptr) {
+    retired->push_back(std::move(config));
+  }
+}
+
+/** 注入概率使用的线程局部随机数（xorshift64*） */
+inline std::uint64_t InjectRandom() noexcept {
+  static thread_local std::uint64_t state = [] {
+    auto seed = static_cast<std::uint64_t>(
+        std::chrono::steady_clock::now().time_since_epoch().count());
+    seed ^= reinterpret_cast<std::uintptr_t>(&seed);
+    return seed == 0 ? 0x9e3779b97f4a7c15ull : seed;
+  }();
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+  return state * 0x2545f4914f6cdd1dull;
+}
+
+/** 一个注入点的状态，缓存当前配置下匹配到的规则 */
+class InjectPoint {
+ public:
+  constexpr InjectPoint(char const* site, char const* type) noexcept
+      : site_{site}, type_{type} {}
+
+  // 命中注入配置后的路径放在注入点之外，不影响所在函数的代码生成
+  GERR_NOINLINE bool Fire() noexcept {
+    auto const config = InjectConfigSlot().load(std::memory_order_acquire);
+    if (config == nullptr) {
+      return false;
+    }
+    auto const rule = Match(config);
+    if (rule == nullptr) {
+      return false;
+    }
+    if (rule->every != 0) {
+      return calls_.fetch_add(1, std::memory_order_relaxed) % rule->every ==
+             rule->every - 1;
+    }
+    return InjectRandom() < rule->threshold;
+  }
+
+ private:
+  InjectRule const* Match(InjectConfig const* config) noexcept {
+    if (seen_.load(std::memory_order_acquire) == config) {
+      return rule_.load(std::memory_order_acquire);
+    }
+    // 多个线程可能同时重新匹配，它们得到的结果相同；
+    // 配置切换的瞬间可能用新规则处理了少量仍在读旧配置的调用，对注入而言无关紧要
+    InjectRule const* matched = nullptr;
+    for (auto const& rule : config->rules) {
+      if (rule.Match(site_, type_)) {
+        matched = &rule;
+        break;
+      }
+    }
+    calls_.store(0, std::memory_order_relaxed);
+    rule_.store(matched, std::memory_order_release);
+    seen_.store(config, std::memory_order_release);
+    return matched;
+  }
+
+  char const* site_;
+  char const* type_;
+  std::atomic<InjectConfig const*> seen_{nullptr};
+  std::atomic<InjectRule const*> rule_{nullptr};
+  std::atomic<std::uint64_t> calls_{0};
+};
+
+template <class ErrType>
+GERR_NOINLINE Error InjectedError() noexcept {
+  return ErrType::E();
+}
+
+inline Error ParseInjectRule(std::string const& line, int lineNo,
+                             InjectRule* rule) {
+  std::istringstream in{line};
+  std::string key, value;
+  if (!(in >> key >> value)) {
+    return New("inject config line {}: expect '<site>[:<ErrType>] <rate>' "
+               "or '<site>[:<ErrType>] every <n>'",
+               lineNo);
+  }
+  auto const colon = key.find(':');
+  rule->site = key.substr(0, colon);
+  if (colon != std::string::npos) {
+    rule->type = key.substr(colon + 1);
+  }
+  if (value == "every") {
+    long long n = 0;
+    if (!(in >> n) || n <= 0) {
+      return New("inject config line {}: 'every' needs a positive count",
+                 lineNo);
+    }
+    rule->every = static_cast<std::uint64_t>(n);
+  } else {
+    char* end = nullptr;
+    auto const rate = std::strtod(value.c_str(), &end);
+    if (end == value.c_str() || *end != '\0' || !(rate >= 0 && rate <= 1)) {
+      return New("inject config line {}: rate '{}' is not in [0, 1]", lineNo,
+                 value);
+    }
+    if (rate >= 1) {
+      rule->every = 1;
+    } else {
+      rule->threshold = static_cast<std::uint64_t>(rate * 18446744073709551616.0);
+    }
+  }
+  std::string extra;
+  if (in >> extra) {
+    return New("inject config line {}: unexpected '{}'", lineNo, extra);
+  }
+  return nullptr;
+}
+
+}  // namespace details
+
+/**
+ * 替换当前的注入配置，成功后对所有注入点立即生效，可以在运行时反复调用。
+ * 配置由换行或分号分隔的规则组成，'#' 开头的行是注释，每条规则是：
+ *   <site>[:<ErrType>] <rate>        以 rate（0 到 1）的概率注入
+ *   <site>[:<ErrType>] every <n>     每 n 次调用注入一次
+ * site 为 "*" 时匹配所有站点，以 '*' 结尾时按前缀匹配；省略 ErrType 时匹配
+ * 该站点的所有错误类型。每个注入点使用第一条匹配的规则。
+ * 解析失败时返回错误，并保持原有配置不变；text 中没有规则时关闭注入。
+ * Example:
+ *   gerr::SetInjectConfig("db.query 0.01; cache.*:ErrTimeout every 100");
+ */
+inline Error SetInjectConfig(std::string const& text) {
+  std::unique_ptr<details::InjectConfig> config{new details::InjectConfig{}};
+  std::size_t begin = 0;
+  for (int lineNo = 1; begin <= text.size(); ++lineNo) {
+    auto end = text.find_first_of(";\n", begin);
+    if (end == std::string::npos) {
+      end = text.size();
+    }
+    auto const line = text.substr(begin, end - begin);
+    begin = end + 1;
+    auto const first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#') {
+      continue;
+    }
+    details::InjectRule rule;
+    auto err = details::ParseInjectRule(line, lineNo, &rule);
+    if (err != nullptr) {
+      return err;
+    }
+    config->rules.push_back(std::move(rule));
+  }
+  details::PublishInjectConfig(std::move(config));
+  return nullptr;
+}
+
+/** 从文件读取注入配置，格式同 gerr::SetInjectConfig */
+inline Error LoadInjectConfig(std::string const& path) {
+  std::ifstream in{path};
+  if (!in) {
+    return New("open inject config {}", path);
+  }
+  std::ostringstream text;
+  text << in.rdbuf();
+  auto err = SetInjectConfig(text.str());
+  if (err != nullptr) {
+    return Wrap(err, "load inject config {}", path);
+  }
+  return nullptr;
+}
+
+/**
+ * 从环境变量读取注入配置：值以 '@' 开头时表示配置文件的路径，否则就是配置本身。
+ * 环境变量不存在时关闭注入。通常在启动时调用一次，需要重新加载时
+ * （例如收到 SIGHUP 后在普通线程中）再次调用即可。
+ */
+inline Error LoadInjectConfigFromEnv(char const* name = "GERR_INJECT") {
+  auto const value = std::getenv(name);
+  if (value == nullptr) {
+    details::PublishInjectConfig(nullptr);
+    return nullptr;
+  }
+  if (value[0] == '@') {
+    return LoadInjectConfig(value + 1);
+  }
+  auto err = SetInjectConfig(value);
+  if (err != nullptr) {
+    return Wrap(err, "load inject config from ${}", name);
+  }
+  return nullptr;
+}
+
+/** 关闭所有注入点 */
+inline void DisableInject() { details::PublishInjectConfig(nullptr); }
+
+}  // namespace gerr
@@ -0,0 +1,468 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <gerr/gerr.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace gerr {
+
+/** 一个时间窗口内某个错误码的错误数和错误率 */
+struct RateSample {
+  int code;
+  std::uint64_t errors;
+  double rate;  // errors / 窗口内的总调用数
+};
+
+/** 一个时间窗口内的统计结果，codes 按错误码排序 */
+struct RateSnapshot {
+  int seconds;
+  std::uint64_t calls;
+  std::vector<RateSample> codes;
+};
+
+namespace details {
+
+/**
+ * 一个线程的计数器，只有所属线程写入，读取方用 relaxed 原子操作读取后合并。
+ * 每秒一行，每行中每个错误码一列，行数和列数固定，内存有上界。
+ */
+struct RateSlot {
+  static constexpr int kRows = 64;     // 覆盖 60 秒窗口加上当前这一秒
+  static constexpr int kColumns = 64;  // 最后一列用于容纳超出的错误码
+
+  struct Row {
+    std::atomic<std::uint32_t> second{0};
+    std::atomic<std::uint32_t> calls{0};
+    std::atomic<std::uint32_t> errors[kColumns];
+  };
+
+  std::atomic<bool> owned{false};
+  std::atomic<bool> used[kColumns];
+  std::atomic<int> codes[kColumns];
+  Row rows[kRows];
+
+  RateSlot() {
+    for (int i = 0; i < kColumns; ++i) {
+      used[i].store(false, std::memory_order_relaxed);
+      codes[i].store(0, std::memory_order_relaxed);
+    }
+    for (auto& row : rows) {
+      for (auto& errors : row.errors) {
+        errors.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /** 只由所属线程调用 */
+  int Column(int code) noexcept {
+    auto const n = kColumns - 1;
+    auto i = static_cast<int>(static_cast<unsigned>(code) * 2654435761u %
+                              static_cast<unsigned>(n));
+    for (int probe = 0; probe < n; ++probe, i = (i + 1) % n) {
+      if (!used[i].load(std::memory_order_relaxed)) {
+        codes[i].store(code, std::memory_order_relaxed);
+        used[i].store(true, std::memory_order_release);
+        return i;
+      }
+      if (codes[i].load(std::memory_order_relaxed) == code) {
+        return i;
+      }
+    }
+    return n;
+  }
+
+  /** 只由所属线程调用，进入新的一秒时先清空这一行 */
+  Row& RowAt(std::uint32_t second) noexcept {
+    auto& row = rows[second % kRows];
+    if (row.second.load(std::memory_order_relaxed) != second) {
+      row.calls.store(0, std::memory_order_relaxed);
+      for (auto& errors : row.errors) {
+        errors.store(0, std::memory_order_relaxed);
+      }
+      row.second.store(second, std::memory_order_release);
+    }
+    return row;
+  }
+};
+
+/** 所属线程对计数器的单调递增，不需要读-改-写原子操作 */
+inline void RateBump(std::atomic<std::uint32_t>& counter) noexcept {
+  counter.store(counter.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+}
+
+/** RateTracker 的共享状态，线程退出时通过 weak_ptr 归还自己的计数器 */
+struct RateState {
+  std::uint64_t id;
+  std::mutex mu;
+  std::vector<std::unique_ptr<RateSlot>> slots;
+
+  RateSlot* Acquire() {
+    std::lock_guard<std::mutex> lock{mu};
+    for (auto& slot : slots) {
+      if (!slot->owned.load(std::memory_order_relaxed)) {
+        slot->owned.store(true, std::memory_order_relaxed);
+        return slot.get();
+      }
+    }
+    slots.emplace_back(new RateSlot{});
+    slots.back()->owned.store(true, std::memory_order_relaxed);
+    return slots.back().get();
+  }
+};
+
+/** 当前线程在各个 RateTracker 中的计数器 */
+class RateThreadSlots {
+ public:
+  ~RateThreadSlots() {
+    for (auto& entry : entries_) {
+      if (auto state = entry.state.lock()) {
+        std::lock_guard<std::mutex> lock{state->mu};
+        entry.slot->owned.store(false, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  RateSlot* Find(std::shared_ptr<RateState> const& state) {
+    for (auto const& entry : entries_) {
+      if (entry.id == state->id) {
+        return entry.slot;
+      }
+    }
+    auto const slot = state->Acquire();
+    // 顺便清理已经析构的 RateTracker 留下的条目
+    entries_.erase(std::remove_if(entries_.begin(), entries_.end(),
+                                  [](Entry const& entry) {
+                                    return entry.state.expired();
+                                  }),
+                   entries_.end());
+    entries_.push_back({state->id, state, slot});
+    return slot;
+  }
+
+ private:
+  struct Entry {
+    std::uint64_t id;
+    std::weak_ptr<RateState> state;
+    RateSlot* slot;
+  };
+  std::vector<Entry> entries_;
+};
+
+inline std::uint32_t RateNowSecond() {
+  // 加 1 保证不为 0，0 表示还没有使用过的行
+  return static_cast<std::uint32_t>(
+             std::chrono::duration_cast<std::chrono::seconds>(
+                 std::chrono::steady_clock::now().time_since_epoch())
+                 .count()) +
+         1;
+}
+
+}  // namespace details
+
+/**
+ * 按错误码统计错误率，用于 SLO 告警。每次调用的结果通过 Record 记录到当前线程
+ * 自己的按秒分桶的计数器中，读取时合并所有线程的计数器。
+ * 记录是 O(1) 的，不加锁，也不使用读-改-写原子操作；每个线程的计数器大小固定
+ * （最多 63 个不同的错误码，超出的计入 kOtherCode），线程退出后留给之后的线程复用。
+ *
+ * 窗口按整秒计算，不包含正在进行中的这一秒，因此统计结果最多滞后 1 秒。
+ * Example:
+ *   static gerr::RateTracker rpcErrors;
+ *
+ *   auto err = Handle(req);
+ *   rpcErrors.Record(err);
+ *
+ *   // 启动时
+ *   rpcErrors.ServeUnixSocket("/run/myserver/metrics.sock");
+ */
+class RateTracker {
+ public:
+  /** 超出每个线程错误码上限的错误都计入这个错误码 */
+  static constexpr int kOtherCode = INT_MIN;
+
+  RateTracker() : state_{std::make_shared<details::RateState>()} {
+    static std::atomic<std::uint64_t> nextId{1};
+    state_->id = nextId.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  ~RateTracker() { StopServing(); }
+
+  RateTracker(RateTracker const&) = delete;
+  RateTracker& operator=(RateTracker const&) = delete;
+
+  /** 记录一次调用，err 为 nullptr 表示成功，否则按 gerr::Code(err) 计数 */
+  void Record(ErrorView err) noexcept {
+    RecordCode(err == nullptr ? 0 : Code(err));
+  }
+
+  /** 记录一次调用，code 为 0 表示成功 */
+  void RecordCode(int code) noexcept {
+    RecordCodeAt(code, details::RateNowSecond());
+  }
+
+  /**
+   * 同 RecordCode，但是记在指定的秒上，second 的取值同 details::RateNowSecond()。
+   * 用于回放记录和检查窗口的滚动，second 应当单调不减。
+   */
+  void RecordCodeAt(int code, std::uint32_t second) noexcept {
+    auto const slot = ThreadSlot();
+    if (slot == nullptr) {
+      return;
+    }
+    auto& row = slot->RowAt(second);
+    details::RateBump(row.calls);
+    if (code != 0) {
+      details::RateBump(row.errors[slot->Column(code)]);
+    }
+  }
+
+  /** 最近 seconds 秒（1 到 60）的统计结果 */
+  RateSnapshot Snapshot(int seconds) const {
+    return SnapshotAt(seconds, details::RateNowSecond());
+  }
+
+  /** 同 Snapshot，但是以 now 作为当前的秒，配合 RecordCodeAt 使用 */
+  RateSnapshot SnapshotAt(int seconds, std::uint32_t now) const {
+    using Slot = details::RateSlot;
+    seconds = seconds < 1 ? 1 : seconds > 60 ? 60 : seconds;
+    RateSnapshot snapshot{seconds, 0, {}};
+    std::map<int, std::uint64_t> errors;
+    std::lock_guard<std::mutex> lock{state_->mu};
+    for (auto const& slot : state_->slots) {
+      int codes[Slot::kColumns];
+      for (int i = 0; i < Slot::kColumns - 1; ++i) {
+        codes[i] = slot->used[i].load(std::memory_order_acquire)
+                       ? slot->codes[i].load(std::memory_order_relaxed)
+                       : 0;
+      }
+      codes[Slot::kColumns - 1] = kOtherCode;
+      for (auto const& row : slot->rows) {
+        auto const second = row.second.load(std::memory_order_acquire);
+        if (second == 0 || now - second == 0 ||
+            now - second > static_cast<std::uint32_t>(seconds)) {
+          continue;
+        }
+        std::uint64_t calls = row.calls.load(std::memory_order_relaxed);
+        std::uint64_t counts[Slot::kColumns];
+        for (int i = 0; i < Slot::kColumns; ++i) {
+          counts[i] = row.errors[i].load(std::memory_order_relaxed);
+        }
+        // 读取期间这一行被所属线程重置时跳过
+        if (row.second.load(std::memory_order_acquire) != second) {
+          continue;
+        }
+        snapshot.calls += calls;
+        for (int i = 0; i < Slot::kColumns; ++i) {
+          if (counts[i] != 0 && codes[i] != 0) {
+            errors[codes[i]] += counts[i];
+          }
+        }
+      }
+    }
+    for (auto const& kv : errors) {
+      auto const rate = snapshot.calls == 0
+                            ? 0.0
+                            : static_cast<double>(kv.second) /
+                                  static_cast<double>(snapshot.calls);
+      snapshot.codes.push_back({kv.first, kv.second, rate});
+    }
+    return snapshot;
+  }
+
+  /**
+   * Prometheus 文本格式的 1s、10s、60s 窗口统计，指标名以 prefix 开头：
+   *   <prefix>_calls{window="10s"}
+   *   <prefix>_errors{window="10s",code="1001"}
+   *   <prefix>_error_ratio{window="10s",code="1001"}
+   * 指标是数据而不是错误消息，直接用 fmt::format，GERR_STRIP_MESSAGES 下照常输出。
+   */
+  std::string PrometheusText(std::string const& prefix = "gerr") const {
+    RateSnapshot const snapshots[] = {Snapshot(1), Snapshot(10), Snapshot(60)};
+    std::string calls, errors, ratios;
+    for (auto const& s : snapshots) {
+      calls += fmt::format("{}_calls{{window=\"{}s\"}} {}\n", prefix,
+                           s.seconds, s.calls);
+      for (auto const& c : s.codes) {
+        auto const code =
+            c.code == kOtherCode ? std::string{"other"} : std::to_string(c.code);
+        errors += fmt::format("{}_errors{{window=\"{}s\",code=\"{}\"}} {}\n",
+                              prefix, s.seconds, code, c.errors);
+        ratios += fmt::format(
+            "{}_error_ratio{{window=\"{}s\",code=\"{}\"}} {}\n", prefix,
+            s.seconds, code, c.rate);
+      }
+    }
+    return fmt::format(
+        "# TYPE {0}_calls gauge\n{1}# TYPE {0}_errors gauge\n{2}"
+        "# TYPE {0}_error_ratio gauge\n{3}",
+        prefix, calls, errors, ratios);
+  }
+
+  /**
+   * 将 PrometheusText 写入文件，先写临时文件再重命名，读取方不会读到写了一半的文件，
+   * 可以配合 node_exporter 的 textfile collector 使用。
+   */
+  Error ExportFile(std::string const& path,
+                   std::string const& prefix = "gerr") const {
+    auto const text = PrometheusText(prefix);
+    auto const tmp = path + ".tmp";
+    auto const file = std::fopen(tmp.c_str(), "w");
+    if (file == nullptr) {
+      return Wrap(FromErrno(errno), "open {}", tmp);
+    }
+    auto const written = std::fwrite(text.data(), 1, text.size(), file);
+    auto const closed = std::fclose(file);
+    if (written != text.size() || closed != 0) {
+      return Wrap(FromErrno(errno), "write {}", tmp);
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+      return Wrap(FromErrno(errno), "rename {} to {}", tmp, path);
+    }
+    return nullptr;
+  }
+
+  /**
+   * 在 unix socket 上启动一个后台线程，对每个连接返回一个 HTTP 响应，
+   * 内容是 PrometheusText。同一个 RateTracker 只能启动一次，
+   * 析构或 StopServing 时停止。Windows 上不支持。
+   */
+  Error ServeUnixSocket(std::string const& path,
+                        std::string const& prefix = "gerr") {
+#ifdef _WIN32
+    (void)path;
+    (void)prefix;
+    return New("gerr::RateTracker::ServeUnixSocket is not supported on Windows");
+#else
+    if (server_.joinable()) {
+      return New("gerr::RateTracker is already serving");
+    }
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+      return New("unix socket path too long: {}", path);
+    }
+    path.copy(addr.sun_path, path.size());
+    auto const fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+      return Wrap(FromErrno(errno), "socket");
+    }
+    ::unlink(path.c_str());
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(fd, 16) != 0) {
+      auto err = Wrap(FromErrno(errno), "listen on {}", path);
+      ::close(fd);
+      return err;
+    }
+    stop_.store(false);
+    server_ = std::thread{[this, fd, path, prefix] {
+      Serve(fd, prefix);
+      ::close(fd);
+      ::unlink(path.c_str());
+    }};
+    return nullptr;
+#endif
+  }
+
+  void StopServing() {
+    stop_.store(true);
+    if (server_.joinable()) {
+      server_.join();
+    }
+  }
+
+ private:
+  details::RateSlot* ThreadSlot() noexcept {
+    try {
+      static thread_local details::RateThreadSlots slots;
+      return slots.Find(state_);
+    } catch (...) {
+      return nullptr;
+    }
+  }
+
+#ifndef _WIN32
+  void Serve(int fd, std::string const& prefix) {
+    while (!stop_.load()) {
+      pollfd pfd{fd, POLLIN, 0};
+      if (::poll(&pfd, 1, 100) <= 0) {
+        continue;
+      }
+      auto const conn = ::accept(fd, nullptr, nullptr);
+      if (conn < 0) {
+        continue;
+      }
+      // 请求内容不重要，读到请求头结束或者对端停止发送即可
+      std::string request;
+      char buf[512];
+      while (request.find("\r\n\r\n") == std::string::npos &&
+             request.size() < 8192) {
+        pollfd cfd{conn, POLLIN, 0};
+        if (::poll(&cfd, 1, 1000) <= 0) {
+          break;
+        }
+        auto const n = ::read(conn, buf, sizeof(buf));
+        if (n <= 0) {
+          break;
+        }
+        request.append(buf, static_cast<std::size_t>(n));
+      }
+      try {
+        auto const body = PrometheusText(prefix);
+        details::WriteFd(
+            conn, fmt::format("HTTP/1.0 200 OK\r\nContent-Type: text/plain; "
+                              "version=0.0.4\r\nContent-Length: {}\r\n\r\n{}",
+                              body.size(), body));
+      } catch (...) {
+      }
+      ::close(conn);
+    }
+  }
+#endif
+
+  std::shared_ptr<details::RateState> state_;
+  std::atomic<bool> stop_{false};
+  std::thread server_;
+};
+
+}  // namespace gerr
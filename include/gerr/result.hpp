@@ -0,0 +1,151 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#pragma once
+
+#include <gerr/gerr.hpp>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace gerr {
+
+/**
+ * 一个可能成功可能出错的返回值，成功时持有 ValueType 类型的值，失败时持有
+ * gerr::Error（此时的 Error 不应为 nullptr）。和 examples/simpletry 中的
+ * mylib::Try 类似，但是不会在失败时默认构造一个 ValueType。
+ * Example:
+ *   gerr::Result<double> SafeDiv(int i, int j) {
+ *       if (j == 0) {
+ *           return gerr::New("can't div 0");
+ *       }
+ *       return (double)i / (double)j;
+ *   }
+ *
+ *   auto res = SafeDiv(1, i);
+ *   if (!res) {
+ *       return gerr::Wrap(res.Error(), "1/{}", i);
+ *   }
+ *   std::cout << res.Value();
+ */
+template <class ValueType>
+class Result {
+ public:
+  static_assert(!std::is_reference<ValueType>::value,
+                "Result may not be used with reference types");
+
+  Result(::gerr::Error err) : error_{std::move(err)} {}
+
+  template <class ErrType, class = typename std::enable_if<std::is_base_of<
+                               details::IError, ErrType>::value>::type>
+  Result(std::shared_ptr<ErrType> err)
+      : error_{std::static_pointer_cast<details::IError>(std::move(err))} {}
+
+  Result(ValueType const& val) { Emplace(val); }
+  Result(ValueType&& val) { Emplace(std::move(val)); }
+
+  Result(Result const& src) : error_{src.error_} {
+    if (src.hasValue_) {
+      Emplace(src.Value());
+    }
+  }
+
+  Result(Result&& src) noexcept(
+      std::is_nothrow_move_constructible<ValueType>::value)
+      : error_{std::move(src.error_)} {
+    if (src.hasValue_) {
+      Emplace(std::move(src.Value()));
+    }
+  }
+
+  Result& operator=(Result const& src) {
+    if (this != &src) {
+      Reset();
+      error_ = src.error_;
+      if (src.hasValue_) {
+        Emplace(src.Value());
+      }
+    }
+    return *this;
+  }
+
+  Result& operator=(Result&& src) noexcept(
+      std::is_nothrow_move_constructible<ValueType>::value) {
+    if (this != &src) {
+      Reset();
+      error_ = std::move(src.error_);
+      if (src.hasValue_) {
+        Emplace(std::move(src.Value()));
+      }
+    }
+    return *this;
+  }
+
+  ~Result() { Reset(); }
+
+  explicit operator bool() const noexcept { return IsSuccess(); }
+
+  bool IsSuccess() const noexcept { return hasValue_; }
+  bool IsFailure() const noexcept { return !hasValue_; }
+
+  /** 只能在 IsSuccess() 时调用 */
+  ValueType const& Value() const {
+    return *reinterpret_cast<ValueType const*>(&storage_);
+  }
+  ValueType& Value() { return *reinterpret_cast<ValueType*>(&storage_); }
+
+  /** 成功时返回 nullptr */
+  ::gerr::Error const& Error() const noexcept { return error_; }
+
+ private:
+  template <class... Args>
+  void Emplace(Args&&... args) {
+    new (&storage_) ValueType(std::forward<Args>(args)...);
+    hasValue_ = true;
+  }
+
+  void Reset() {
+    if (hasValue_) {
+      Value().~ValueType();
+      hasValue_ = false;
+    }
+  }
+
+  bool hasValue_{};
+  typename std::aligned_storage<sizeof(ValueType), alignof(ValueType)>::type
+      storage_;
+  ::gerr::Error error_{};
+};
+
+namespace details {
+
+/** 取出一次调用结果中的错误，用于同时接受 gerr::Error 和 gerr::Result<T> 的工具 */
+inline ::gerr::Error const& ErrorOf(::gerr::Error const& err) { return err; }
+
+template <class ValueType>
+::gerr::Error const& ErrorOf(Result<ValueType> const& res) {
+  return res.Error();
+}
+
+}  // namespace details
+
+}  // namespace gerr
@@ -0,0 +1,489 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <gerr/gerr.hpp>
+#include <gerr/result.hpp>
+#include <gerr/status.hpp>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace gerr {
+
+/** 错误的重试分类 */
+enum class RetryClass { kUnknown, kRetryable, kPermanent };
+
+/** gerr::RetryPolicy::Run 放弃重试的原因 */
+enum class RetryStop { kPermanent, kMaxAttempts, kDeadline, kBudget };
+
+inline char const* RetryStopName(RetryStop stop) {
+  switch (stop) {
+    case RetryStop::kPermanent:
+      return "permanent error";
+    case RetryStop::kMaxAttempts:
+      return "max attempts reached";
+    case RetryStop::kDeadline:
+      return "deadline exceeded";
+    case RetryStop::kBudget:
+      return "retry budget exhausted";
+  }
+  return "";
+}
+
+/**
+ * 多次尝试之后仍然失败时返回的错误节点。最后一次尝试的错误作为 Cause，
+ * 因此 gerr::Is / gerr::IsCode 等仍然能在其上生效；之前的尝试只保留最近的
+ * kMaxKept 个，错误链条的长度不会随尝试次数增长。
+ * 错误信息在第一次被读取时才生成。
+ */
+class RetryError : public details::IError {
+ public:
+  static constexpr int kMaxKept = 4;
+
+  RetryError(int attempts, RetryStop stop, std::vector<Error> earlier,
+             Error last)
+      : attempts_{attempts},
+        stop_{stop},
+        earlier_{std::move(earlier)},
+        cause_{std::move(last)} {}
+
+  int Code() const override { return 0; }
+  char const* Message() const override {
+    once_.Call([this] {
+      try {
+        errorMessage_ = details::FormatRuntime("gave up after {} attempts ({})",
+                                               attempts_, RetryStopName(stop_));
+        auto attempt = attempts_ - static_cast<int>(earlier_.size());
+        for (auto const& err : earlier_) {
+          errorMessage_ += details::FormatRuntime("; attempt {}: {}", attempt++,
+                                                  String(err));
+        }
+      } catch (...) {
+      }
+    });
+    return errorMessage_.c_str();
+  }
+  Error const& Cause() const override { return cause_; }
+  std::size_t HeapUsage() const override {
+    return earlier_.capacity() * sizeof(Error) +
+           (once_.Done() ? details::StringHeapUsage(errorMessage_) : 0);
+  }
+
+  /** 总的尝试次数，包括最后一次 */
+  int Attempts() const { return attempts_; }
+  RetryStop Stop() const { return stop_; }
+  /** 最后一次之前的最近几次尝试的错误，按时间顺序排列 */
+  std::vector<Error> const& Earlier() const { return earlier_; }
+
+ private:
+  int attempts_{};
+  RetryStop stop_{};
+  std::vector<Error> earlier_{};
+  Error cause_{};
+  details::RenderOnce once_{};
+  mutable std::string errorMessage_{};
+};
+
+/**
+ * 多个调用共享的重试预算，限制重试占总请求数的比例，避免下游故障时
+ * 重试把流量放大数倍。每次调用存入 ratio 个令牌，每次重试取出一个，
+ * 余额不超过 maxTokens；初始时有 maxTokens 个令牌。线程安全。
+ */
+class RetryBudget {
+ public:
+  explicit RetryBudget(double ratio = 0.1, int maxTokens = 100)
+      : deposit_{static_cast<std::int64_t>(ratio * kScale)},
+        max_{static_cast<std::int64_t>(maxTokens) * kScale},
+        balance_{max_} {}
+
+  void Deposit() noexcept {
+    auto balance = balance_.load(std::memory_order_relaxed);
+    while (balance < max_ &&
+           !balance_.compare_exchange_weak(balance,
+                                           std::min(max_, balance + deposit_),
+                                           std::memory_order_relaxed)) {
+    }
+  }
+
+  bool TryWithdraw() noexcept {
+    auto balance = balance_.load(std::memory_order_relaxed);
+    while (balance >= kScale) {
+      if (balance_.compare_exchange_weak(balance, balance - kScale,
+                                         std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  double Tokens() const noexcept {
+    return static_cast<double>(balance_.load(std::memory_order_relaxed)) /
+           kScale;
+  }
+
+ private:
+  static constexpr std::int64_t kScale = 1000;
+
+  std::int64_t deposit_;
+  std::int64_t max_;
+  std::atomic<std::int64_t> balance_;
+};
+
+namespace details {
+
+/** 错误节点所属的错误域：gerr::Status 的错误域，或者 std::error_code 的类别名 */
+inline char const* RetryDomain(IError const& node) {
+  if (auto e = dynamic_cast<DomainError const*>(&node)) {
+    return e->Domain();
+  }
+  if (auto e = dynamic_cast<ErrorCodeSource const*>(&node)) {
+    auto const ec = e->ErrorCode();
+    if (ec) {
+      return ec.category().name();
+    }
+  }
+  if (dynamic_cast<ErrnoError const*>(&node) != nullptr) {
+    return std::generic_category().name();
+  }
+  return nullptr;
+}
+
+}  // namespace details
+
+/**
+ * 按错误分类决定是否重试的重试策略，以及执行重试的循环。
+ *
+ * 分类规则按错误码、错误码区间、错误类型和错误域声明，Stop* 规则优先于
+ * Retry* 规则。添加规则时错误码规则被预先编译为有序且互不重叠的区间，
+ * 分类时只遍历一次错误链条，从外到内第一个命中规则的节点决定分类，
+ * 因此外层可以覆盖内层的分类；错误码为 0 的节点不参与错误码规则。
+ * 没有命中任何规则的错误默认不重试，可以通过 RetryUnknown(true) 修改。
+ *
+ * 退避时间为 initial * multiplier^(n-1)，不超过 max，再按 jitter 的比例随机缩短。
+ * 达到最大尝试次数、下一次重试会超过截止时间或者重试预算不足时停止。
+ * 规则应当在开始使用前配置好，配置完成后的 RetryPolicy 可以在多个线程中共享。
+ * Example:
+ *   static auto const policy = gerr::RetryPolicy{}
+ *       .RetryOn<ErrTimeout>()
+ *       .RetryOnCodes(5000, 5999)
+ *       .StopOnCode(5003)
+ *       .RetryOnDomain("generic")
+ *       .Backoff(std::chrono::milliseconds{10}, std::chrono::seconds{1})
+ *       .MaxAttempts(5)
+ *       .Deadline(std::chrono::seconds{3});
+ *
+ *   auto err = policy.Run([&] { return client.Call(req); });
+ */
+class RetryPolicy {
+ public:
+  using Duration = std::chrono::nanoseconds;
+
+  RetryPolicy& RetryOnCode(int code) { return AddCodes(code, code, true); }
+  RetryPolicy& RetryOnCodes(int first, int last) {
+    return AddCodes(first, last, true);
+  }
+  RetryPolicy& StopOnCode(int code) { return AddCodes(code, code, false); }
+  RetryPolicy& StopOnCodes(int first, int last) {
+    return AddCodes(first, last, false);
+  }
+
+  template <class ErrType>
+  RetryPolicy& RetryOn() {
+    types_.push_back({&IsType<ErrType>, RetryClass::kRetryable});
+    return *this;
+  }
+  template <class ErrType>
+  RetryPolicy& StopOn() {
+    types_.push_back({&IsType<ErrType>, RetryClass::kPermanent});
+    return *this;
+  }
+
+  /** 错误域是 gerr::StatusDomain<E>::Name() 或 std::error_category::name() */
+  RetryPolicy& RetryOnDomain(std::string domain) {
+    domains_.push_back({std::move(domain), RetryClass::kRetryable});
+    return *this;
+  }
+  RetryPolicy& StopOnDomain(std::string domain) {
+    domains_.push_back({std::move(domain), RetryClass::kPermanent});
+    return *this;
+  }
+
+  RetryPolicy& RetryUnknown(bool retry) {
+    retryUnknown_ = retry;
+    return *this;
+  }
+
+  RetryPolicy& Backoff(Duration initial, Duration max,
+                       double multiplier = 2.0) {
+    initial_ = initial;
+    maxDelay_ = max;
+    multiplier_ = multiplier;
+    return *this;
+  }
+
+  /** 每次退避时间随机缩短 [0, fraction) 的比例，0 表示不加随机，默认 0.5 */
+  RetryPolicy& Jitter(double fraction) {
+    jitter_ = fraction;
+    return *this;
+  }
+
+  /** 总的尝试次数，包括第一次，默认 3 */
+  RetryPolicy& MaxAttempts(int attempts) {
+    maxAttempts_ = attempts;
+    return *this;
+  }
+
+  /** 从第一次尝试开始计算的截止时间，0 表示不限制 */
+  RetryPolicy& Deadline(Duration total) {
+    deadline_ = total;
+    return *this;
+  }
+
+  RetryPolicy& Budget(std::shared_ptr<RetryBudget> budget) {
+    budget_ = std::move(budget);
+    return *this;
+  }
+
+  /** 替换退避时的等待方式，默认是 std::this_thread::sleep_for */
+  RetryPolicy& Sleeper(std::function<void(Duration)> sleeper) {
+    sleeper_ = std::move(sleeper);
+    return *this;
+  }
+
+  RetryClass Classify(ErrorView err) const {
+    for (auto p = err.Get(); p != nullptr; p = p->Cause().get()) {
+      auto const cls = ClassifyNode(*p);
+      if (cls != RetryClass::kUnknown) {
+        return cls;
+      }
+    }
+    return RetryClass::kUnknown;
+  }
+
+  bool Retryable(ErrorView err) const {
+    auto const cls = Classify(err);
+    return cls == RetryClass::kRetryable ||
+           (cls == RetryClass::kUnknown && retryUnknown_);
+  }
+
+  /** 第 retry 次重试（从 1 开始）之前的退避时间 */
+  Duration Delay(int retry) const {
+    auto delay = static_cast<double>(initial_.count());
+    for (int i = 1; i < retry && delay < maxDelay_.count(); ++i) {
+      delay *= multiplier_;
+    }
+    delay = std::min(delay, static_cast<double>(maxDelay_.count()));
+    if (jitter_ > 0) {
+      static thread_local std::minstd_rand rng{std::random_device{}()};
+      std::uniform_real_distribution<double> dist{0, jitter_};
+      delay *= 1 - dist(rng);
+    }
+    return Duration{static_cast<Duration::rep>(delay)};
+  }
+
+  /**
+   * 调用 fn 直到成功或者决定放弃，fn 返回 gerr::Error 或者 gerr::Result<T>，
+   * Run 返回相同的类型。第一次尝试就放弃时原样返回其结果，
+   * 否则失败的结果中是一个 gerr::RetryError。
+   */
+  template <class Fn>
+  auto Run(Fn&& fn) const -> decltype(fn()) {
+    using Clock = std::chrono::steady_clock;
+    auto const start = Clock::now();
+    if (budget_ != nullptr) {
+      budget_->Deposit();
+    }
+    std::vector<Error> earlier;
+    for (int attempt = 1;; ++attempt) {
+      auto result = fn();
+      auto const& err = details::ErrorOf(result);
+      if (err == nullptr) {
+        return result;
+      }
+
+      auto const delay = Delay(attempt);
+      auto retry = false;
+      auto stop = RetryStop::kPermanent;
+      if (!Retryable(err)) {
+        stop = RetryStop::kPermanent;
+      } else if (attempt >= maxAttempts_) {
+        stop = RetryStop::kMaxAttempts;
+      } else if (deadline_.count() > 0 &&
+                 Clock::now() + delay > start + deadline_) {
+        stop = RetryStop::kDeadline;
+      } else if (budget_ != nullptr && !budget_->TryWithdraw()) {
+        stop = RetryStop::kBudget;
+      } else {
+        retry = true;
+      }
+
+      if (!retry) {
+        if (attempt == 1) {
+          return result;
+        }
+        Error last = err;
+        return decltype(fn()){details::TryCreate(
+            [&] {
+              return details::MakeShared<RetryError>(attempt, stop,
+                                                     std::move(earlier), last);
+            },
+            0, nullptr, last)};
+      }
+
+      if (static_cast<int>(earlier.size()) == RetryError::kMaxKept) {
+        earlier.erase(earlier.begin());
+      }
+      earlier.push_back(err);
+      if (sleeper_) {
+        sleeper_(delay);
+      } else {
+        std::this_thread::sleep_for(delay);
+      }
+    }
+  }
+
+ private:
+  struct CodeRule {
+    int first;
+    int last;
+    bool retry;
+  };
+  struct CodeRange {
+    int first;
+    int last;
+    RetryClass cls;
+  };
+  struct TypeRule {
+    bool (*match)(details::IError const&);
+    RetryClass cls;
+  };
+  struct DomainRule {
+    std::string domain;
+    RetryClass cls;
+  };
+
+  template <class ErrType>
+  static bool IsType(details::IError const& node) {
+    return dynamic_cast<ErrType const*>(&node) != nullptr;
+  }
+
+  RetryPolicy& AddCodes(int first, int last, bool retry) {
+    codeRules_.push_back({first, last, retry});
+    CompileCodes();
+    return *this;
+  }
+
+  /** 把所有错误码规则编译为有序、互不重叠的区间，重叠部分 Stop 优先 */
+  void CompileCodes() {
+    std::vector<std::int64_t> bounds;
+    for (auto const& rule : codeRules_) {
+      bounds.push_back(rule.first);
+      bounds.push_back(static_cast<std::int64_t>(rule.last) + 1);
+    }
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+    codes_.clear();
+    for (std::size_t i = 0; i + 1 < bounds.size(); ++i) {
+      auto const first = bounds[i];
+      auto const last = bounds[i + 1] - 1;
+      auto cls = RetryClass::kUnknown;
+      for (auto const& rule : codeRules_) {
+        if (rule.first <= first && last <= rule.last) {
+          cls = rule.retry && cls != RetryClass::kPermanent
+                    ? RetryClass::kRetryable
+                    : RetryClass::kPermanent;
+        }
+      }
+      if (cls == RetryClass::kUnknown) {
+        continue;
+      }
+      if (!codes_.empty() && codes_.back().cls == cls &&
+          codes_.back().last + static_cast<std::int64_t>(1) == first) {
+        codes_.back().last = static_cast<int>(last);
+      } else {
+        codes_.push_back(
+            {static_cast<int>(first), static_cast<int>(last), cls});
+      }
+    }
+  }
+
+  RetryClass ClassifyNode(details::IError const& node) const {
+    auto cls = RetryClass::kUnknown;
+    auto const merge = [&cls](RetryClass c) {
+      if (c == RetryClass::kPermanent || cls == RetryClass::kUnknown) {
+        cls = c;
+      }
+    };
+    auto const code = node.Code();
+    if (code != 0 && !codes_.empty()) {
+      auto it = std::upper_bound(
+          codes_.begin(), codes_.end(), code,
+          [](int c, CodeRange const& range) { return c < range.first; });
+      if (it != codes_.begin() && code <= (--it)->last) {
+        merge(it->cls);
+      }
+    }
+    for (auto const& rule : types_) {
+      if (rule.match(node)) {
+        merge(rule.cls);
+      }
+    }
+    if (!domains_.empty()) {
+      auto const domain = details::RetryDomain(node);
+      if (domain != nullptr) {
+        for (auto const& rule : domains_) {
+          if (rule.domain == domain) {
+            merge(rule.cls);
+          }
+        }
+      }
+    }
+    return cls;
+  }
+
+  std::vector<CodeRule> codeRules_{};
+  std::vector<CodeRange> codes_{};
+  std::vector<TypeRule> types_{};
+  std::vector<DomainRule> domains_{};
+  bool retryUnknown_{};
+
+  Duration initial_{std::chrono::milliseconds{10}};
+  Duration maxDelay_{std::chrono::seconds{1}};
+  double multiplier_{2.0};
+  double jitter_{0.5};
+  int maxAttempts_{3};
+  Duration deadline_{};
+  std::shared_ptr<RetryBudget> budget_{};
+  std::function<void(Duration)> sleeper_{};
+};
+
+}  // namespace gerr
@@ -0,0 +1,166 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#pragma once
+
+#include <gerr/gerr.hpp>
+#include <type_traits>
+
+namespace gerr {
+
+/**
+ * gerr::Status<E> 的错误域，需要为每个用作 Status 的枚举类型特化，提供：
+ *   static constexpr char const* Name();  // 错误域的名字
+ *   static char const* Message(E code);   // 每个错误码对应的错误信息
+ * 枚举值 E{}（即 0）表示成功。
+ *
+ * Example:
+ *   enum class ParseCode { kOk, kBadDigit, kOverflow };
+ *
+ *   namespace gerr {
+ *   template <>
+ *   struct StatusDomain<ParseCode> {
+ *     static constexpr char const* Name() { return "parse"; }
+ *     static char const* Message(ParseCode code) {
+ *       switch (code) {
+ *         case ParseCode::kBadDigit: return "bad digit";
+ *         case ParseCode::kOverflow: return "overflow";
+ *         default: return "";
+ *       }
+ *     }
+ *   };
+ *   }  // namespace gerr
+ */
+template <class E>
+struct StatusDomain;
+
+namespace details {
+
+/** 带有错误域的错误，由 gerr::Status 转换而来 */
+class DomainError : public IError {
+ public:
+  virtual char const* Domain() const = 0;
+};
+
+/** gerr::Status<E> 转换成的错误节点 */
+template <class E>
+class StatusError : public DomainError {
+ public:
+  StatusError(E code, char const* context)
+      : errorCode_{code}, context_{context} {
+    if (context_ != nullptr) {
+      errorMessage_ = FormatRuntime("{}: {}", StatusDomain<E>::Message(code),
+                                    context_);
+    }
+  }
+
+  int Code() const override { return static_cast<int>(errorCode_); }
+  char const* Message() const override {
+    return context_ == nullptr
+               ? StaticMessage(StatusDomain<E>::Message(errorCode_))
+               : errorMessage_.c_str();
+  }
+  char const* Domain() const override { return StatusDomain<E>::Name(); }
+  std::size_t HeapUsage() const override {
+    return StringHeapUsage(errorMessage_);
+  }
+
+  E TypedCode() const { return errorCode_; }
+  char const* Context() const { return context_; }
+
+ private:
+  E errorCode_{};
+  char const* context_{};
+  std::string errorMessage_{};
+};
+
+}  // namespace details
+
+/**
+ * 用于最内层热点循环（解析器、编解码器等）的轻量错误状态，只包含一个强类型的
+ * 错误码和一个可选的静态环境信息字符串，可以平凡拷贝，能够通过寄存器返回。
+ * 只有在需要向上层传递、被 gerr::Wrap 包装时才会转换为 gerr::Error，
+ * 转换出的错误节点携带 StatusDomain<E> 中注册的错误信息和错误域。
+ * Example:
+ *   gerr::Status<ParseCode> ParseDigit(char c, int* out) {
+ *       if (c < '0' || c > '9') {
+ *           return {ParseCode::kBadDigit, "expect 0-9"};
+ *       }
+ *       *out = c - '0';
+ *       return {};
+ *   }
+ *
+ *   gerr::Error ParseAll(std::string const& s) {
+ *       for (auto c : s) {
+ *           auto st = ParseDigit(c, &d);
+ *           if (st.IsFailure()) {
+ *               return gerr::Wrap(st, "parse {}", s); // 此时才转换为 Error
+ *           }
+ *       }
+ *       return nullptr;
+ *   }
+ */
+template <class E>
+class Status {
+  static_assert(std::is_enum<E>::value, "Status requires an enum type");
+
+ public:
+  using CodeType = E;
+
+  constexpr Status() = default;
+  constexpr Status(E code, char const* context = nullptr)
+      : code_{code}, context_{context} {}
+
+  constexpr bool IsOk() const { return code_ == E{}; }
+  constexpr bool IsFailure() const { return code_ != E{}; }
+
+  constexpr E Code() const { return code_; }
+  constexpr char const* Context() const { return context_; }
+
+  /** 转换为 gerr::Error，成功时返回 nullptr */
+  Error ToError() const noexcept {
+    if (IsOk()) {
+      return nullptr;
+    }
+    return details::TryCreate(
+        [this] {
+          return details::MakeShared<details::StatusError<E>>(code_, context_);
+        },
+        static_cast<int>(code_),
+        details::StaticMessage(StatusDomain<E>::Message(code_)));
+  }
+
+  operator Error() const noexcept { return ToError(); }
+
+  friend constexpr bool operator==(Status lhs, Status rhs) {
+    return lhs.code_ == rhs.code_;
+  }
+  friend constexpr bool operator!=(Status lhs, Status rhs) {
+    return lhs.code_ != rhs.code_;
+  }
+
+ private:
+  E code_{};
+  char const* context_{};
+};
+
+}  // namespace gerr
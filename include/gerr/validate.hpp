@@ -0,0 +1,434 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <gerr/gerr.hpp>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace gerr {
+
+namespace details {
+
+/** Validator 记录的一条字段错误，路径和错误信息是 arena 中以 '\0' 结尾的字符串的偏移 */
+struct FieldEntry {
+  std::uint32_t path;
+  std::uint32_t message;
+  int code;
+  int error;  // 附带的完整错误在 errors 中的下标，没有时为 -1
+};
+
+/**
+ * gerr::Validator::Finish 生成的错误节点，一个节点保存所有字段错误，
+ * 字段的路径和错误信息都在同一块 arena 中。字段错误不是父错误，gerr::IsCode /
+ * Is / As 只看节点自身，查找字段错误使用 gerr::IsFieldCode / AsField 或者
+ * 下面的 HasField / HasFieldCode / FindField。错误信息在第一次被读取时才生成。
+ */
+class ValidationError : public IError {
+ public:
+  ValidationError(int code, char const* summary, std::string arena,
+                  std::vector<FieldEntry> entries, std::vector<Error> errors,
+                  std::size_t dropped)
+      : code_{code},
+        summary_{summary},
+        arena_{std::move(arena)},
+        entries_{std::move(entries)},
+        errors_{std::move(errors)},
+        dropped_{dropped} {
+    if (code_ == 0 && !entries_.empty()) {
+      code_ = entries_.front().code;
+    }
+  }
+
+  int Code() const override { return code_; }
+  char const* Message() const override {
+    once_.Call([this] {
+      try {
+        Render();
+      } catch (...) {
+      }
+    });
+    return errorMessage_.c_str();
+  }
+  std::size_t HeapUsage() const override {
+    return StringHeapUsage(arena_) +
+           entries_.capacity() * sizeof(FieldEntry) +
+           errors_.capacity() * sizeof(Error) +
+           (once_.Done() ? StringHeapUsage(errorMessage_) : 0);
+  }
+
+  /** 字段错误的条数，不包括内存不足时丢弃的条目 */
+  std::size_t FieldCount() const { return entries_.size(); }
+  char const* FieldPath(std::size_t i) const {
+    return arena_.data() + entries_[i].path;
+  }
+  int FieldCode(std::size_t i) const { return entries_[i].code; }
+  /** 通过 Validator::Add 附带完整错误的字段返回该错误的错误信息 */
+  char const* FieldMessage(std::size_t i) const {
+    auto const& entry = entries_[i];
+    if (entry.error >= 0) {
+      auto const msg = errors_[entry.error]->Message();
+      return msg == nullptr ? "" : msg;
+    }
+    return arena_.data() + entry.message;
+  }
+  /** 字段附带的完整错误，没有时返回 nullptr */
+  Error const& FieldError(std::size_t i) const {
+    auto const& entry = entries_[i];
+    return entry.error >= 0 ? errors_[entry.error] : NoError();
+  }
+
+  /** 是否有路径为 path 的字段错误 */
+  bool HasField(fmt::string_view path) const {
+    for (auto const& entry : entries_) {
+      if (fmt::string_view{arena_.data() + entry.path} == path) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /** 字段错误或者字段附带的完整错误中是否有错误码 code，嵌套的校验结果也会查找 */
+  bool HasFieldCode(int code) const;
+
+  /** 在字段附带的完整错误中查找 ExpectErr 类型的错误，嵌套的校验结果也会查找 */
+  template <class ExpectErr>
+  ExpectErr const* FindField() const;
+
+ private:
+  void Render() const {
+    errorMessage_ = FormatRuntime("{}: {} field error(s)", summary_,
+                                  entries_.size() + dropped_);
+    for (auto const& entry : entries_) {
+      auto const path = arena_.data() + entry.path;
+      if (entry.error >= 0) {
+        errorMessage_ +=
+            FormatRuntime("; {}: {}", path, String(errors_[entry.error]));
+      } else if (entry.code != 0) {
+        errorMessage_ += FormatRuntime("; {}: {}:{}", path, entry.code,
+                                       arena_.data() + entry.message);
+      } else {
+        errorMessage_ +=
+            FormatRuntime("; {}: {}", path, arena_.data() + entry.message);
+      }
+    }
+    if (dropped_ != 0) {
+      errorMessage_ += FormatRuntime("; {} more dropped", dropped_);
+    }
+  }
+
+  int code_{};
+  char const* summary_{};
+  std::string arena_{};
+  std::vector<FieldEntry> entries_{};
+  std::vector<Error> errors_{};
+  std::size_t dropped_{};
+  RenderOnce once_{};
+  mutable std::string errorMessage_{};
+};
+
+}  // namespace details
+
+/**
+ * 错误链条上的节点或者链条上第一个校验结果中的字段错误是否有错误码 code。
+ * 只有校验结果才需要这个函数，gerr::IsCode 不查找字段错误。
+ */
+inline bool IsFieldCode(int code, ErrorView err) {
+  if (IsCode(code, err)) {
+    return true;
+  }
+  auto const v = As<details::ValidationError>(err);
+  return v != nullptr && v->HasFieldCode(code);
+}
+
+/**
+ * 在错误链条和链条上第一个校验结果附带的错误中查找 ExpectErr 类型的错误，
+ * 例如 Validator::Check<ErrType> 记录的错误类型。找不到时返回 nullptr。
+ */
+template <class ExpectErr>
+ExpectErr const* AsField(ErrorView err) {
+  auto const p = As<ExpectErr>(err);
+  if (p != nullptr) {
+    return p;
+  }
+  auto const v = As<details::ValidationError>(err);
+  return v == nullptr ? nullptr : v->FindField<ExpectErr>();
+}
+
+namespace details {
+
+inline bool ValidationError::HasFieldCode(int code) const {
+  for (auto const& entry : entries_) {
+    if (entry.code == code) {
+      return true;
+    }
+  }
+  for (auto const& err : errors_) {
+    if (IsFieldCode(code, err)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <class ExpectErr>
+ExpectErr const* ValidationError::FindField() const {
+  for (auto const& err : errors_) {
+    auto const p = AsField<ExpectErr>(err);
+    if (p != nullptr) {
+      return p;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace details
+
+/**
+ * 收集一次请求校验中的所有字段错误，最后由 Finish 合成一个错误节点。
+ * 字段路径和错误信息都写入同一块 arena（一个 std::string），相同的路径只保存一次；
+ * 每条字段错误只占 16 字节的索引，不会为每个字段创建一个错误节点。
+ * 没有字段出错时不分配任何内存，Check 只是一次分支，Finish 返回 nullptr。
+ *
+ * 和创建错误的其他接口一样，记录字段错误的函数不抛出异常，内存不足时
+ * 丢弃这条字段错误，只在最终的错误信息中计数。Validator 不是线程安全的。
+ * Example:
+ *   gerr::Validator v;
+ *   v.Check(!req.name.empty(), "name", kEmpty, "must not be empty");
+ *   v.Check(req.age <= 150, "age", kOutOfRange, "must be <= {}, got {}",
+ *           150, req.age);
+ *   v.Check<ErrBadEmail>(IsEmail(req.email), "email");
+ *   v.Add("address", ValidateAddress(req.address));
+ *   if (auto err = v.Finish("invalid request")) {
+ *       if (gerr::IsFieldCode(kEmpty, err)) { ... }
+ *       return err;
+ *   }
+ */
+class Validator {
+ public:
+  /** ok 为 false 时记录一条字段错误，返回 ok */
+  bool Check(bool ok, fmt::string_view path, int code,
+             fmt::string_view message) noexcept {
+    if (ok) {
+      return true;
+    }
+    Fail(path, code, message);
+    return false;
+  }
+
+  /** 同上，错误信息按 fmt 的格式化字符串生成，只在 ok 为 false 时格式化 */
+  template <class... Args>
+  bool Check(bool ok, fmt::string_view path, int code,
+             fmt::string_view format, Args const&... args) noexcept {
+    if (ok) {
+      return true;
+    }
+    Fail(path, code, format, args...);
+    return false;
+  }
+
+  /**
+   * ok 为 false 时记录一条 DEFINE_ERROR / DEFINE_CODE_ERROR 定义的错误类型的
+   * 字段错误，使用该类型的常驻节点，gerr::AsField<ErrType> 能在结果上找到它
+   */
+  template <class ErrType>
+  bool Check(bool ok, fmt::string_view path) noexcept {
+    if (ok) {
+      return true;
+    }
+    Add(path, ErrType::E());
+    return false;
+  }
+
+  /** 无条件记录一条字段错误 */
+  GERR_NOINLINE void Fail(fmt::string_view path, int code,
+                          fmt::string_view message) noexcept {
+    Record(path, code, -1, [&] { Append(message); });
+  }
+
+  template <class... Args>
+  GERR_NOINLINE void Fail(fmt::string_view path, int code,
+                          fmt::string_view format,
+                          Args const&... args) noexcept {
+    Record(path, code, -1, [&] {
+#ifdef GERR_STRIP_MESSAGES
+      (void)format;
+      details::Ignore(args...);
+#else
+      fmt::vformat_to(std::back_inserter(arena_), format,
+                      fmt::make_format_args(args...));
+#endif
+    });
+  }
+
+  /**
+   * 将 err 作为 path 字段的错误记录下来，例如嵌套对象的校验结果。err 为 nullptr
+   * 时不做任何事。返回 err 是否为 nullptr
+   */
+  bool Add(fmt::string_view path, Error err) noexcept {
+    if (err == nullptr) {
+      return true;
+    }
+    auto const code = gerr::Code(err, 0);
+    try {
+      errors_.push_back(std::move(err));
+    } catch (...) {
+      ++dropped_;
+      return false;
+    }
+    if (!Record(path, code, static_cast<int>(errors_.size() - 1), [] {})) {
+      errors_.pop_back();
+    }
+    return false;
+  }
+
+  bool Ok() const noexcept { return entries_.empty() && dropped_ == 0; }
+  std::size_t Count() const noexcept { return entries_.size() + dropped_; }
+
+  /** 目前是否已经记录了路径为 path 的字段错误 */
+  bool HasField(fmt::string_view path) const noexcept {
+    for (auto const& entry : entries_) {
+      if (fmt::string_view{arena_.data() + entry.path} == path) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * 没有字段错误时返回 nullptr，否则返回一个 details::ValidationError 节点，
+   * 错误信息以 summary 开头（summary 必须是字符串常量），错误码为 code，
+   * code 为 0 时取第一条字段错误的错误码。之后 Validator 回到初始状态。
+   */
+  Error Finish(char const* summary = "validation failed",
+               int code = 0) noexcept {
+    if (Ok()) {
+      return nullptr;
+    }
+    auto err = Make<details::ValidationError>(
+        code, summary, std::move(arena_), std::move(entries_),
+        std::move(errors_), dropped_);
+    arena_.clear();
+    entries_.clear();
+    errors_.clear();
+    paths_.clear();
+    internedPaths_ = 0;
+    dropped_ = 0;
+    return err;
+  }
+
+ private:
+  static constexpr std::size_t kInitialEntries = 8;
+  static constexpr std::size_t kInitialArena = 256;
+
+  struct PathSlot {
+    std::uint32_t hash;
+    std::uint32_t offset;  // 路径在 arena 中的偏移 + 1，0 表示空槽
+  };
+
+  /** 记录一条字段错误，append 向 arena 写入错误信息；内存不足时丢弃并返回 false */
+  template <class Fn>
+  bool Record(fmt::string_view path, int code, int error, Fn append) {
+    auto keep = arena_.size();
+    try {
+      if (entries_.capacity() == 0) {
+        // 第一条字段错误时按常见的规模一次性预留，避免逐步扩容
+        entries_.reserve(kInitialEntries);
+        arena_.reserve(kInitialArena);
+      }
+      auto const pathOffset = InternPath(path);
+      keep = arena_.size();
+      append();
+      arena_.push_back('\0');
+      entries_.push_back(details::FieldEntry{
+          pathOffset, static_cast<std::uint32_t>(keep), code, error});
+      return true;
+    } catch (...) {
+      // 回滚写了一半的错误信息，已经登记的路径保留
+      arena_.resize(keep);
+      ++dropped_;
+      return false;
+    }
+  }
+
+  void Append(fmt::string_view s) { arena_.append(s.data(), s.size()); }
+
+  /** 返回 path 在 arena 中的偏移，第一次出现时写入 arena 并登记 */
+  std::uint32_t InternPath(fmt::string_view path) {
+    std::uint32_t hash = 2166136261u;
+    for (auto c : path) {
+      hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    if (paths_.empty() || internedPaths_ * 2 >= paths_.size()) {
+      GrowPaths();
+    }
+    auto const mask = paths_.size() - 1;
+    for (auto i = static_cast<std::size_t>(hash) & mask;; i = (i + 1) & mask) {
+      auto& slot = paths_[i];
+      if (slot.offset == 0) {
+        auto const offset = static_cast<std::uint32_t>(arena_.size());
+        Append(path);
+        arena_.push_back('\0');
+        slot = PathSlot{hash, offset + 1};
+        ++internedPaths_;
+        return offset;
+      }
+      auto const s = arena_.data() + slot.offset - 1;
+      if (slot.hash == hash && std::strncmp(s, path.data(), path.size()) == 0 &&
+          s[path.size()] == '\0') {
+        return slot.offset - 1;
+      }
+    }
+  }
+
+  void GrowPaths() {
+    std::vector<PathSlot> slots(paths_.empty() ? 16 : paths_.size() * 2,
+                                PathSlot{0, 0});
+    auto const mask = slots.size() - 1;
+    for (auto const& slot : paths_) {
+      if (slot.offset == 0) {
+        continue;
+      }
+      auto i = static_cast<std::size_t>(slot.hash) & mask;
+      while (slots[i].offset != 0) {
+        i = (i + 1) & mask;
+      }
+      slots[i] = slot;
+    }
+    paths_.swap(slots);
+  }
+
+  std::string arena_{};
+  std::vector<details::FieldEntry> entries_{};
+  std::vector<Error> errors_{};
+  std::vector<PathSlot> paths_{};
+  std::size_t internedPaths_{};
+  std::size_t dropped_{};
+};
+
+}  // namespace gerr
@@ -0,0 +1,241 @@
+// MIT License
+//
+// Copyright (c) 2020 ZhiruiLi
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//
+// gerr_sidecar：为 GERR_STRIP_MESSAGES 模式生成离线的错误信息对照表。
+//
+// 剥离模式下，DEFINE_* 宏里的错误信息会被替换成 "#xxxxxxxx" 形式的站点 id，
+// 本工具扫描源文件（以及其中用双引号包含的头文件），找出所有 DEFINE_* 宏，
+// 输出每个站点 id 对应的错误类型和原始信息，每行格式为：
+//   #xxxxxxxx<TAB>类型名<TAB>原始信息
+//
+// 用法：gerr_sidecar <output> <source>...
+#include <cstdio>
+#include <fstream>
+#include <gerr/gerr.hpp>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+
+namespace {
+
+std::string ReadFile(std::string const& path) {
+  std::ifstream in(path, std::ios::binary);
+  std::ostringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+std::string DirName(std::string const& path) {
+  auto pos = path.find_last_of("/\\");
+  return pos == std::string::npos ? std::string{} : path.substr(0, pos + 1);
+}
+
+bool IsIdentChar(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_';
+}
+
+void SkipSpaces(std::string const& src, size_t& pos) {
+  while (pos < src.size() && (src[pos] == ' ' || src[pos] == '\t' ||
+                              src[pos] == '\n' || src[pos] == '\r')) {
+    ++pos;
+  }
+}
+
+// 解析一个字符串字面量（不含前缀），返回反转义后的内容
+bool ParseLiteral(std::string const& src, size_t& pos, std::string& out) {
+  if (pos >= src.size() || src[pos] != '"') {
+    return false;
+  }
+  for (++pos; pos < src.size() && src[pos] != '"'; ++pos) {
+    char c = src[pos];
+    if (c == '\\' && pos + 1 < src.size()) {
+      switch (src[++pos]) {
+        case 'n': c = '\n'; break;
+        case 't': c = '\t'; break;
+        case 'r': c = '\r'; break;
+        case '0': c = '\0'; break;
+        default: c = src[pos]; break;
+      }
+    }
+    out.push_back(c);
+  }
+  ++pos;
+  return true;
+}
+
+// 跳过一个宏参数，停在分隔它的逗号或右括号上。和预处理器一样只有圆括号
+// 能保护其中的逗号，尖括号可能是 1 << 4、a > b 这样的运算符，不参与配对
+void SkipArgument(std::string const& src, size_t& pos) {
+  int depth = 0;
+  for (; pos < src.size(); ++pos) {
+    char c = src[pos];
+    if (c == '"') {
+      std::string ignored;
+      ParseLiteral(src, pos, ignored);
+      --pos;
+    } else if (c == '(') {
+      ++depth;
+    } else if (c == ')') {
+      if (depth == 0) {
+        return;
+      }
+      --depth;
+    } else if (c == ',' && depth == 0) {
+      return;
+    }
+  }
+}
+
+class Scanner {
+ public:
+  explicit Scanner(std::ostream& out) : out_(out) {}
+
+  void Scan(std::string const& path) {
+    if (!visited_.insert(path).second) {
+      return;
+    }
+    std::ifstream probe(path);
+    if (!probe) {
+      return;
+    }
+    auto src = ReadFile(path);
+    ScanIncludes(path, src);
+    ScanDefines(src);
+  }
+
+ private:
+  void ScanIncludes(std::string const& path, std::string const& src) {
+    std::istringstream lines(src);
+    std::string line;
+    while (std::getline(lines, line)) {
+      auto pos = line.find_first_not_of(" \t");
+      if (pos == std::string::npos || line.compare(pos, 1, "#") != 0) {
+        continue;
+      }
+      pos = line.find("include", pos);
+      auto begin = line.find('"', pos);
+      auto end = line.find('"', begin + 1);
+      if (pos != std::string::npos && begin != std::string::npos &&
+          end != std::string::npos) {
+        Scan(DirName(path) + line.substr(begin + 1, end - begin - 1));
+      }
+    }
+  }
+
+  void ScanDefines(std::string const& src) {
+    static std::string const kPrefix = "DEFINE_";
+    for (size_t pos = src.find(kPrefix); pos != std::string::npos;
+         pos = src.find(kPrefix, pos + 1)) {
+      if (pos > 0 && IsIdentChar(src[pos - 1])) {
+        continue;
+      }
+      auto lineBegin = src.rfind('\n', pos);
+      lineBegin = lineBegin == std::string::npos ? 0 : lineBegin + 1;
+      auto first = src.find_first_not_of(" \t", lineBegin);
+      if (src[first] == '#') {
+        continue;  // 宏定义本身
+      }
+      size_t cur = pos;
+      while (cur < src.size() && IsIdentChar(src[cur])) {
+        ++cur;
+      }
+      auto macro = src.substr(pos, cur - pos);
+      if (macro != "DEFINE_ERROR" && macro != "DEFINE_CODE_ERROR" &&
+          macro != "DEFINE_CONTEXT_ERROR" &&
+          macro != "DEFINE_CODE_CONTEXT_ERROR" &&
+          macro != "DEFINE_MEMO_CONTEXT_ERROR" &&
+          macro != "DEFINE_CODE_MEMO_CONTEXT_ERROR") {
+        continue;
+      }
+      SkipSpaces(src, cur);
+      if (cur >= src.size() || src[cur] != '(') {
+        continue;
+      }
+      ++cur;
+      SkipSpaces(src, cur);
+      auto nameBegin = cur;
+      SkipArgument(src, cur);
+      auto name = src.substr(nameBegin, cur - nameBegin);
+      name.erase(name.find_last_not_of(" \t\r\n") + 1);
+      // 跳过错误码和环境信息类型等参数，直到第一个字符串字面量
+      while (cur < src.size() && src[cur] == ',') {
+        ++cur;
+        SkipSpaces(src, cur);
+        if (src[cur] == '"') {
+          break;
+        }
+        SkipArgument(src, cur);
+      }
+      std::string message;
+      while (ParseLiteral(src, cur, message)) {
+        SkipSpaces(src, cur);  // 相邻的字面量会被拼接
+      }
+      if (message.empty()) {
+        continue;
+      }
+      char id[16];
+      std::snprintf(id, sizeof(id), "#%08x",
+                    static_cast<unsigned>(
+                        gerr::details::Fnv1a(message.c_str())));
+      out_ << id << '\t' << name << '\t' << Escape(message) << '\n';
+    }
+  }
+
+  static std::string Escape(std::string const& s) {
+    std::string out;
+    for (char c : s) {
+      switch (c) {
+        case '\n': out += "\\n"; break;
+        case '\t': out += "\\t"; break;
+        case '\r': out += "\\r"; break;
+        case '\\': out += "\\\\"; break;
+        default: out.push_back(c); break;
+      }
+    }
+    return out;
+  }
+
+  std::ostream& out_;
+  std::set<std::string> visited_;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::cerr << "usage: " << argv[0] << " <output> <source>...\n";
+    return 1;
+  }
+  std::ofstream out(argv[1]);
+  if (!out) {
+    std::cerr << "cannot open " << argv[1] << "\n";
+    return 1;
+  }
+  Scanner scanner(out);
+  for (int i = 2; i < argc; ++i) {
+    scanner.Scan(argv[i]);
+  }
+  return 0;
+}